@@ -0,0 +1,152 @@
+#include "batch_query.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <thread>
+
+namespace {
+
+std::string trim(const std::string& line) {
+    const char* space = " \t\r\n";
+    size_t first = line.find_first_not_of(space);
+    if (first == std::string::npos) return "";
+    return line.substr(first, line.find_last_not_of(space) - first + 1);
+}
+
+// Length of the well-formed UTF-8 sequence starting at value[i], or 0 if there is none
+// (stray continuation byte, truncated sequence, overlong form, surrogate, above U+10FFFF).
+size_t utf8SequenceLength(const std::string& value, size_t i) {
+    const unsigned char lead = static_cast<unsigned char>(value[i]);
+    if (lead < 0x80) return 1;
+    size_t length;
+    unsigned char low = 0x80, high = 0xBF; // Allowed range of the second byte
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) low = 0xA0;
+        if (lead == 0xED) high = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) low = 0x90;
+        if (lead == 0xF4) high = 0x8F;
+    } else {
+        return 0;
+    }
+    if (value.size() - i < length) return 0;
+    for (size_t k = 1; k < length; ++k) {
+        const unsigned char c = static_cast<unsigned char>(value[i + k]);
+        if (c < (k == 1 ? low : 0x80) || c > (k == 1 ? high : 0xBF)) return 0;
+    }
+    return length;
+}
+
+} // namespace
+
+void writeJsonString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (size_t i = 0; i < value.size(); ++i) {
+        const char c = value[i];
+        switch (c) {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                out << escaped;
+            } else if (size_t length = utf8SequenceLength(value, i)) {
+                out.write(value.data() + i, static_cast<std::streamsize>(length));
+                i += length - 1;
+            } else {
+                // Paths need not be UTF-8; JSON must be. Each bad byte becomes U+FFFD.
+                out << "\\ufffd";
+            }
+        }
+    }
+    out << '"';
+}
+
+BatchQueryRunner::BatchQueryRunner(const RelevanceScorer& scorer, unsigned threadCount)
+    : scorer_(scorer), threadCount_(threadCount) {
+    if (threadCount_ == 0) {
+        threadCount_ = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+std::vector<BatchQueryResult> BatchQueryRunner::run(const IndexReader& index, const std::vector<std::string>& queries,
+                                                    size_t topK) const {
+    std::vector<BatchQueryResult> results(queries.size());
+    std::atomic<size_t> nextQuery{0};
+
+    // Queries are claimed one at a time, so a few slow ones do not stall a whole thread's share
+    auto worker = [&]() {
+        for (size_t i = nextQuery++; i < queries.size(); i = nextQuery++) {
+            auto start = std::chrono::steady_clock::now();
+            results[i].query = queries[i];
+            results[i].results = scorer_.topDocuments(index, queries[i], topK);
+            results[i].milliseconds =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    unsigned threadCount = static_cast<unsigned>(std::min<size_t>(threadCount_, queries.size()));
+    if (threadCount <= 1) {
+        worker();
+        return results;
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) threads.emplace_back(worker);
+    for (auto& thread : threads) thread.join();
+    return results;
+}
+
+bool readQueryFile(const std::string& path, std::vector<std::string>& queries) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string query = trim(line);
+        if (query.empty() || query[0] == '#') continue;
+        queries.push_back(query);
+    }
+    return true;
+}
+
+void writeJsonLines(std::ostream& out, const std::vector<BatchQueryResult>& results) {
+    char number[32];
+    for (const auto& result : results) {
+        out << "{\"query\":";
+        writeJsonString(out, result.query);
+        std::snprintf(number, sizeof(number), "%.3f", result.milliseconds);
+        out << ",\"took_ms\":" << number << ",\"results\":[";
+        for (size_t rank = 0; rank < result.results.size(); ++rank) {
+            const DocumentScore& ds = result.results[rank];
+            if (rank > 0) out << ',';
+            out << "{\"rank\":" << rank + 1 << ",\"path\":";
+            writeJsonString(out, ds.filePath);
+            // %.17g round-trips the double exactly
+            std::snprintf(number, sizeof(number), "%.17g", ds.score);
+            out << ",\"score\":" << number;
+            if (!ds.duplicates.empty()) {
+                out << ",\"duplicates\":[";
+                for (size_t i = 0; i < ds.duplicates.size(); ++i) {
+                    if (i > 0) out << ',';
+                    writeJsonString(out, ds.duplicates[i]);
+                }
+                out << ']';
+            }
+            out << '}';
+        }
+        out << "]}\n";
+    }
+    out.flush();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstddef>
+
+#include "index_reader.h"
+#include "relevance_scorer.h"
+
+struct BatchQueryResult {
+    std::string query;
+    std::vector<DocumentScore> results; // Best first
+    double milliseconds = 0.0;          // Wall time spent scoring this query
+};
+
+/**
+ * @brief Scores many topics against one already loaded index.
+ *
+ * Queries are spread over a pool of threads that all read the same index
+ * (InvertedIndex and MappedIndex are safe to query concurrently); results
+ * come back in input order regardless of which thread scored them.
+ */
+class BatchQueryRunner {
+public:
+    // @param threadCount Number of scoring threads (0 = one per hardware thread).
+    explicit BatchQueryRunner(const RelevanceScorer& scorer, unsigned threadCount = 0);
+
+    std::vector<BatchQueryResult> run(const IndexReader& index, const std::vector<std::string>& queries,
+                                      size_t topK) const;
+
+    unsigned threadCount() const { return threadCount_; }
+
+private:
+    const RelevanceScorer& scorer_;
+    unsigned threadCount_;
+};
+
+// Reads one query per line, skipping blank lines and '#' comments. False if unreadable.
+bool readQueryFile(const std::string& path, std::vector<std::string>& queries);
+
+// Writes `value` as a JSON string literal, quotes included. Bytes that are not
+// well-formed UTF-8 are written as U+FFFD.
+void writeJsonString(std::ostream& out, const std::string& value);
+
+// Writes one JSON object per query: {"query", "took_ms", "results": [{"rank", "path", "score"}]}.
+// A result that collapsed near-duplicates also lists their paths under "duplicates".
+void writeJsonLines(std::ostream& out, const std::vector<BatchQueryResult>& results);
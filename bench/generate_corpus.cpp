@@ -0,0 +1,127 @@
+// Writes a synthetic corpus to disk: PDFs (or plain text) for the organizer
+// and the benchmarks, plus optional topic lists and Scholar result pages.
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "synthetic_corpus.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " --out DIR [options]\n"
+              << "  --out DIR          Folder to write the corpus to (created if needed)\n"
+              << "  --documents N      Number of documents (default 1000)\n"
+              << "  --words N          Words per document (default 2000)\n"
+              << "  --words-per-page N Words per page (default 500)\n"
+              << "  --vocabulary N     Distinct content words (default 20000)\n"
+              << "  --zipf S           Word ranks drawn with weight 1/r^S (default 1.0; 0 = uniform)\n"
+              << "  --stop-words R     Share of stop words (default 0.3)\n"
+              << "  --seed N           Random seed (default 42)\n"
+              << "  --per-folder N     Documents per subfolder (default 0 = all in DIR)\n"
+              << "  --text             Write .txt files instead of PDFs\n"
+              << "  --topics N         Also write N topics, one per line, to DIR/topics.txt\n"
+              << "  --scholar N        Also write a Scholar result page with N results to DIR/scholar.html\n";
+}
+
+bool writeFile(const fs::path& path, const std::string& contents) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << contents;
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    SyntheticCorpusOptions options;
+    std::string outDirectory;
+    size_t perFolder = 0;
+    bool textOnly = false;
+    size_t topicCount = 0;
+    size_t scholarResults = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out" && hasValue) {
+            outDirectory = argv[++i];
+        } else if (arg == "--documents" && hasValue) {
+            options.documents = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--words" && hasValue) {
+            options.wordsPerDocument = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--words-per-page" && hasValue) {
+            options.wordsPerPage = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--vocabulary" && hasValue) {
+            options.vocabularySize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--zipf" && hasValue) {
+            options.zipfExponent = std::atof(argv[++i]);
+        } else if (arg == "--stop-words" && hasValue) {
+            options.stopWordRate = std::atof(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--per-folder" && hasValue) {
+            perFolder = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--text") {
+            textOnly = true;
+        } else if (arg == "--topics" && hasValue) {
+            topicCount = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--scholar" && hasValue) {
+            scholarResults = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            std::cerr << "[Error] Unknown argument: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (outDirectory.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    SyntheticCorpus corpus(options);
+    std::error_code ec;
+    fs::create_directories(outDirectory, ec);
+
+    size_t written = 0;
+    if (textOnly) {
+        char name[32];
+        for (size_t i = 0; i < options.documents; ++i) {
+            fs::path folder = outDirectory;
+            if (perFolder > 0) {
+                std::snprintf(name, sizeof(name), "part%04zu", i / perFolder);
+                folder /= name;
+                fs::create_directories(folder, ec);
+            }
+            std::snprintf(name, sizeof(name), "doc%06zu.txt", i);
+            written += writeFile(folder / name, corpus.text(i));
+        }
+    } else {
+        written = writePdfCorpus(corpus, outDirectory, perFolder).size();
+    }
+    std::cout << "[Corpus] Wrote " << written << " of " << options.documents << (textOnly ? " text files" : " PDFs")
+              << " to " << outDirectory << std::endl;
+
+    if (topicCount > 0) {
+        std::string topics;
+        for (const std::string& topic : corpus.topics(topicCount)) topics += topic + "\n";
+        fs::path path = fs::path(outDirectory) / "topics.txt";
+        if (writeFile(path, topics)) std::cout << "[Corpus] Wrote " << topicCount << " topics to " << path.string() << std::endl;
+    }
+    if (scholarResults > 0) {
+        fs::path path = fs::path(outDirectory) / "scholar.html";
+        if (writeFile(path, syntheticScholarPage(scholarResults, options.seed))) {
+            std::cout << "[Corpus] Wrote a Scholar page with " << scholarResults << " results to " << path.string()
+                      << std::endl;
+        }
+    }
+    return written == options.documents ? 0 : 1;
+}
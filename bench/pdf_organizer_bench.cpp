@@ -0,0 +1,339 @@
+// Stage-level and end-to-end benchmarks over synthetic corpora.
+//
+//   pdf_organizer_bench --benchmark_out=results.json --benchmark_out_format=json
+//
+// writes machine-readable results (compare two runs with Google Benchmark's
+// tools/compare.py). Everything is generated from fixed seeds, so runs on the
+// same machine measure the same work.
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "synthetic_corpus.h"
+#include "file_manager.h"
+#include "pdf_extractor.h"
+#include "extraction_pipeline.h"
+#include "incremental_indexer.h"
+#include "relevance_scorer.h"
+#include "scoring_model.h"
+#include "index_file.h"
+#include "near_duplicates.h"
+#include "scholar_result_parser.h"
+#include "scholar_search.h"
+#include "tokenizer.h"
+
+#ifndef PDF_ORGANIZER_BENCH_FIXTURES
+#define PDF_ORGANIZER_BENCH_FIXTURES "bench/fixtures"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const MODEL_NAMES[] = {"tfidf", "bm25", "bm25f"};
+const size_t TOPIC_COUNT = 64;
+
+// Generated files live here for the length of the run
+fs::path scratchDirectory() {
+    static const fs::path directory = [] {
+        const char* configured = std::getenv("PDF_ORGANIZER_BENCH_DIR");
+        fs::path path = configured ? fs::path(configured)
+                                   : fs::temp_directory_path() / ("pdf_organizer_bench_" + std::to_string(getpid()));
+        fs::create_directories(path);
+        return path;
+    }();
+    return directory;
+}
+
+SyntheticCorpusOptions corpusOptions(size_t documents, size_t words = 2000) {
+    SyntheticCorpusOptions options;
+    options.documents = documents;
+    options.wordsPerDocument = words;
+    return options;
+}
+
+const CorpusMap& corpusOf(size_t documents) {
+    static std::map<size_t, CorpusMap> corpora;
+    auto it = corpora.find(documents);
+    if (it == corpora.end()) it = corpora.emplace(documents, SyntheticCorpus(corpusOptions(documents)).corpusMap()).first;
+    return it->second;
+}
+
+const InvertedIndex& indexOf(size_t documents) {
+    static std::map<size_t, std::unique_ptr<InvertedIndex>> indexes;
+    std::unique_ptr<InvertedIndex>& index = indexes[documents];
+    if (!index) index.reset(new InvertedIndex(RelevanceScorer().buildIndex(corpusOf(documents))));
+    return *index;
+}
+
+// The corpus written as PDFs once per (documents, words) and reused by later benchmarks
+const std::vector<std::string>& pdfCorpusOf(size_t documents, size_t words, size_t perFolder) {
+    static std::map<std::string, std::vector<std::string>> written;
+    std::string key = std::to_string(documents) + "x" + std::to_string(words) + "x" + std::to_string(perFolder);
+    auto it = written.find(key);
+    if (it == written.end()) {
+        SyntheticCorpus corpus(corpusOptions(documents, words));
+        it = written.emplace(key, writePdfCorpus(corpus, (scratchDirectory() / ("pdfs_" + key)).string(), perFolder))
+                 .first;
+    }
+    return it->second;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+RelevanceScorer scorerFor(const benchmark::State& state, int modelArg) {
+    return RelevanceScorer(makeScoringModel(MODEL_NAMES[state.range(modelArg)]));
+}
+
+} // namespace
+
+// --- Crawl ---
+
+static void BM_FindPdfs(benchmark::State& state) {
+    const size_t files = static_cast<size_t>(state.range(0));
+    std::string root = fs::path(pdfCorpusOf(files, 20, 100).front()).parent_path().parent_path().string();
+    FileSystemManager fileSystem;
+    for (auto _ : state) {
+        std::vector<std::string> found = fileSystem.findPdfs(root);
+        benchmark::DoNotOptimize(found.data());
+    }
+    state.SetItemsProcessed(state.iterations() * files);
+}
+BENCHMARK(BM_FindPdfs)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// --- Extraction ---
+
+static void BM_ExtractText(benchmark::State& state) {
+    const size_t pages = static_cast<size_t>(state.range(0));
+    SyntheticCorpusOptions options = corpusOptions(1, pages * 500);
+    std::string path = (scratchDirectory() / ("extract_" + std::to_string(pages) + ".pdf")).string();
+    SyntheticCorpus corpus(options);
+    writeSyntheticPdf(path, corpus.title(0), corpus.pages(0));
+
+    PdfTextExtractor extractor;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        std::string text = extractor.extractText(path);
+        bytes += text.size();
+        benchmark::DoNotOptimize(text.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_ExtractText)->Arg(1)->Arg(10)->Arg(50)->Unit(benchmark::kMicrosecond);
+
+// range(0): worker threads
+static void BM_ExtractionPipeline(benchmark::State& state) {
+    const std::vector<std::string>& paths = pdfCorpusOf(200, 2000, 0);
+    ExtractionPipeline pipeline(static_cast<unsigned>(state.range(0)));
+    size_t bytes = 0;
+    for (auto _ : state) {
+        pipeline.run(paths, [&](const std::string&, std::string&& text) { bytes += text.size(); });
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_ExtractionPipeline)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// --- Tokenization ---
+
+static void BM_TokenizeAndPreprocess(benchmark::State& state) {
+    SyntheticCorpus corpus(corpusOptions(1, static_cast<size_t>(state.range(0))));
+    const std::string text = corpus.text(0);
+    RelevanceScorer scorer;
+    for (auto _ : state) {
+        std::vector<std::string> tokens = scorer.tokenizeAndPreprocess(text);
+        benchmark::DoNotOptimize(tokens.data());
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+    state.SetLabel(Tokenizer::kernelName());
+}
+BENCHMARK(BM_TokenizeAndPreprocess)->Arg(2000)->Arg(50000);
+
+// The allocation-free path indexing uses
+static void BM_TokenizerForEachToken(benchmark::State& state) {
+    SyntheticCorpus corpus(corpusOptions(1, static_cast<size_t>(state.range(0))));
+    const std::string text = corpus.text(0);
+    for (auto _ : state) {
+        size_t tokens = 0;
+        Tokenizer::forEachPositionedToken(text, [&](std::string_view, uint32_t) { ++tokens; });
+        benchmark::DoNotOptimize(tokens);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+    state.SetLabel(Tokenizer::kernelName());
+}
+BENCHMARK(BM_TokenizerForEachToken)->Arg(2000)->Arg(50000);
+
+// --- Indexing ---
+
+static void BM_BuildIndex(benchmark::State& state) {
+    const CorpusMap& corpus = corpusOf(static_cast<size_t>(state.range(0)));
+    size_t bytes = 0;
+    for (const auto& document : corpus) bytes += document.second.size();
+    RelevanceScorer scorer;
+    for (auto _ : state) {
+        InvertedIndex index = scorer.buildIndex(corpus);
+        benchmark::DoNotOptimize(index.termCount());
+    }
+    state.SetItemsProcessed(state.iterations() * corpus.size());
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_BuildIndex)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+static void BM_WriteIndexFile(benchmark::State& state) {
+    const InvertedIndex& index = indexOf(1000);
+    std::string path = (scratchDirectory() / "write.idx").string();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(writeIndexFile(index, path));
+    }
+    state.counters["file_bytes"] = static_cast<double>(fs::file_size(path));
+}
+BENCHMARK(BM_WriteIndexFile)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_OpenMappedIndex(benchmark::State& state) {
+    std::string path = (scratchDirectory() / "open.idx").string();
+    writeIndexFile(indexOf(1000), path);
+    for (auto _ : state) {
+        MappedIndex mapped;
+        benchmark::DoNotOptimize(mapped.open(path));
+    }
+}
+BENCHMARK(BM_OpenMappedIndex)->Unit(benchmark::kMicrosecond);
+
+static void BM_NearDuplicates(benchmark::State& state) {
+    const InvertedIndex& index = indexOf(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        NearDuplicates duplicates;
+        duplicates.build(index);
+        benchmark::DoNotOptimize(duplicates.duplicateCount());
+    }
+    state.SetItemsProcessed(state.iterations() * index.documentCount());
+}
+BENCHMARK(BM_NearDuplicates)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// --- Scoring; range(0): documents, range(1): model ---
+
+static void BM_ScoreDocuments(benchmark::State& state) {
+    const InvertedIndex& index = indexOf(static_cast<size_t>(state.range(0)));
+    RelevanceScorer scorer = scorerFor(state, 1);
+    std::vector<std::string> topics = SyntheticCorpus(corpusOptions(0)).topics(TOPIC_COUNT);
+    size_t next = 0;
+    for (auto _ : state) {
+        std::vector<DocumentScore> scores = scorer.scoreDocuments(index, topics[next++ % topics.size()]);
+        benchmark::DoNotOptimize(scores.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(scorer.model().name());
+}
+BENCHMARK(BM_ScoreDocuments)->ArgsProduct({{1000}, {0, 1, 2}})->Unit(benchmark::kMicrosecond);
+
+static void BM_TopDocuments(benchmark::State& state) {
+    const InvertedIndex& index = indexOf(static_cast<size_t>(state.range(0)));
+    RelevanceScorer scorer = scorerFor(state, 1);
+    std::vector<std::string> topics = SyntheticCorpus(corpusOptions(0)).topics(TOPIC_COUNT);
+    size_t next = 0;
+    for (auto _ : state) {
+        std::vector<DocumentScore> top = scorer.topDocuments(index, topics[next++ % topics.size()], 10);
+        benchmark::DoNotOptimize(top.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(scorer.model().name());
+}
+BENCHMARK(BM_TopDocuments)->ArgsProduct({{1000}, {0, 1, 2}})->Unit(benchmark::kMicrosecond);
+
+// --- Scholar result parsing ---
+
+static void BM_ParseResultsFixture(benchmark::State& state) {
+    const std::string html = readFile(std::string(PDF_ORGANIZER_BENCH_FIXTURES) + "/scholar_results.html");
+    if (html.empty()) {
+        state.SkipWithError("missing fixture scholar_results.html");
+        return;
+    }
+    for (auto _ : state) {
+        std::vector<ScholarResult> results = ScholarResultParser::parse(html);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetBytesProcessed(state.iterations() * html.size());
+}
+BENCHMARK(BM_ParseResultsFixture)->Unit(benchmark::kMicrosecond);
+
+// range(0): results on the page
+static void BM_ParseResultsSynthetic(benchmark::State& state) {
+    const std::string html = syntheticScholarPage(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::vector<ScholarResult> results = ScholarResultParser::parse(html);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetBytesProcessed(state.iterations() * html.size());
+}
+BENCHMARK(BM_ParseResultsSynthetic)->Arg(10)->Arg(100)->Unit(benchmark::kMicrosecond);
+
+// --- End to end ---
+
+// Crawl, extract and index a PDF folder from scratch, as the first run over a corpus does
+static void BM_EndToEndIndexCorpus(benchmark::State& state) {
+    const size_t documents = static_cast<size_t>(state.range(0));
+    const std::vector<std::string>& written = pdfCorpusOf(documents, 2000, 50);
+    std::string root = fs::path(written.front()).parent_path().parent_path().string();
+    RelevanceScorer scorer(makeScoringModel("bm25f"));
+    ExtractionPipeline pipeline;
+    for (auto _ : state) {
+        IncrementalIndexer indexer(scorer, pipeline);
+        ReconcileStats stats = indexer.rescan(root);
+        benchmark::DoNotOptimize(stats.added);
+    }
+    state.SetItemsProcessed(state.iterations() * documents);
+}
+BENCHMARK(BM_EndToEndIndexCorpus)->Arg(200)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Open the saved index and answer one topic, as a repeated run of the CLI does
+static void BM_EndToEndQuerySavedIndex(benchmark::State& state) {
+    std::string path = (scratchDirectory() / "query.idx").string();
+    writeIndexFile(indexOf(1000), path);
+    RelevanceScorer scorer(makeScoringModel("bm25f"));
+    std::vector<std::string> topics = SyntheticCorpus(corpusOptions(0)).topics(TOPIC_COUNT);
+    size_t next = 0;
+    for (auto _ : state) {
+        MappedIndex index;
+        index.open(path);
+        NearDuplicates duplicates;
+        duplicates.build(index);
+        scorer.setNearDuplicates(&duplicates);
+        std::vector<DocumentScore> top = scorer.topDocuments(index, topics[next++ % topics.size()], 5);
+        benchmark::DoNotOptimize(top.data());
+    }
+}
+BENCHMARK(BM_EndToEndQuerySavedIndex)->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    SyntheticCorpusOptions defaults;
+    benchmark::AddCustomContext("tokenizer_kernel", Tokenizer::kernelName());
+    benchmark::AddCustomContext("corpus_words_per_document", std::to_string(defaults.wordsPerDocument));
+    benchmark::AddCustomContext("corpus_vocabulary", std::to_string(defaults.vocabularySize));
+    benchmark::AddCustomContext("corpus_zipf_exponent", std::to_string(defaults.zipfExponent));
+    benchmark::AddCustomContext("corpus_seed", std::to_string(defaults.seed));
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    if (!std::getenv("PDF_ORGANIZER_BENCH_DIR")) {
+        std::error_code ec;
+        fs::remove_all(scratchDirectory(), ec);
+    }
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include "synthetic_corpus.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const CONSONANTS = "bcdfghjklmnprstvz";
+const char* const VOWELS = "aeiou";
+const size_t SYLLABLES = 17 * 5;
+
+const char* const STOP_WORDS[] = {"the", "of", "and", "a", "in", "to", "is",
+                                  "for", "with", "on", "are", "was", "an", "were"};
+const size_t STOP_WORD_COUNT = sizeof(STOP_WORDS) / sizeof(STOP_WORDS[0]);
+
+// Uniform in [0, 1) from the top 53 bits, the same on every standard library
+double uniform(std::mt19937_64& rng) {
+    return static_cast<double>(rng() >> 11) * 0x1.0p-53;
+}
+
+size_t below(std::mt19937_64& rng, size_t n) {
+    return static_cast<size_t>(uniform(rng) * n);
+}
+
+// Bijective base-85 numbering over consonant-vowel syllables, so frequent
+// (low) ranks get short words: "ba", "be", ..., "zu", "baba", ...
+std::string syllableWord(size_t n) {
+    std::string word;
+    for (++n; n > 0; n = (n - 1) / SYLLABLES) {
+        size_t syllable = (n - 1) % SYLLABLES;
+        word.insert(word.begin(), VOWELS[syllable % 5]);
+        word.insert(word.begin(), CONSONANTS[syllable / 5]);
+    }
+    return word;
+}
+
+std::mt19937_64 documentRng(uint64_t seed, size_t index) {
+    return std::mt19937_64(seed * 0x9E3779B97F4A7C15ull + index);
+}
+
+// Escapes a string for a PDF literal (parentheses and backslashes)
+std::string pdfLiteral(const std::string& text) {
+    std::string out;
+    out.reserve(text.size() + 2);
+    for (char c : text) {
+        if (c == '(' || c == ')' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+// Splits page text into lines of at most `width` characters on word boundaries
+std::vector<std::string> wrapLines(const std::string& text, size_t width) {
+    std::vector<std::string> lines;
+    std::istringstream paragraphs(text);
+    std::string paragraph;
+    while (std::getline(paragraphs, paragraph)) {
+        std::istringstream words(paragraph);
+        std::string word;
+        std::string line;
+        while (words >> word) {
+            if (!line.empty() && line.size() + 1 + word.size() > width) {
+                lines.push_back(std::move(line));
+                line.clear();
+            }
+            if (!line.empty()) line += ' ';
+            line += word;
+        }
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+} // namespace
+
+SyntheticCorpus::SyntheticCorpus(const SyntheticCorpusOptions& options) : options_(options) {
+    options_.vocabularySize = std::max<size_t>(1, options_.vocabularySize);
+    options_.wordsPerPage = std::max<size_t>(1, options_.wordsPerPage);
+    vocabulary_.reserve(options_.vocabularySize);
+    for (size_t n = 0; vocabulary_.size() < options_.vocabularySize; ++n) {
+        std::string word = syllableWord(n);
+        if (!Tokenizer::isStopWord(word)) vocabulary_.push_back(std::move(word));
+    }
+    cumulative_.reserve(vocabulary_.size());
+    double total = 0.0;
+    for (size_t rank = 1; rank <= vocabulary_.size(); ++rank) {
+        total += 1.0 / std::pow(static_cast<double>(rank), options_.zipfExponent);
+        cumulative_.push_back(total);
+    }
+}
+
+const std::string& SyntheticCorpus::drawWord(std::mt19937_64& rng) const {
+    double target = uniform(rng) * cumulative_.back();
+    size_t rank = std::upper_bound(cumulative_.begin(), cumulative_.end(), target) - cumulative_.begin();
+    return vocabulary_[std::min(rank, vocabulary_.size() - 1)];
+}
+
+std::string SyntheticCorpus::title(size_t index) const {
+    std::mt19937_64 rng = documentRng(options_.seed ^ 0x7469746c65ull, index);
+    std::string title;
+    size_t words = 4 + below(rng, 6);
+    for (size_t i = 0; i < words; ++i) {
+        std::string word = drawWord(rng);
+        word[0] = static_cast<char>(word[0] - 'a' + 'A');
+        if (i > 0) title += ' ';
+        title += word;
+    }
+    return title;
+}
+
+std::vector<std::string> SyntheticCorpus::pages(size_t index) const {
+    std::mt19937_64 rng = documentRng(options_.seed, index);
+    std::vector<std::string> pages;
+    std::string page = title(index) + "\n";
+    size_t pageWords = 0;
+    size_t sentenceLeft = 0;
+
+    for (size_t i = 0; i < options_.wordsPerDocument; ++i) {
+        bool sentenceStart = sentenceLeft == 0;
+        if (sentenceStart) sentenceLeft = 8 + below(rng, 13);
+
+        std::string word;
+        double kind = uniform(rng);
+        if (kind < options_.stopWordRate) {
+            word = STOP_WORDS[below(rng, STOP_WORD_COUNT)];
+        } else if (kind < options_.stopWordRate + 0.02) {
+            word = std::to_string(below(rng, 2030));
+            if (below(rng, 4) == 0) word += "." + std::to_string(below(rng, 10));
+        } else {
+            word = drawWord(rng);
+        }
+        if (sentenceStart && word[0] >= 'a' && word[0] <= 'z') word[0] = static_cast<char>(word[0] - 'a' + 'A');
+
+        page += word;
+        if (--sentenceLeft == 0) {
+            page += below(rng, 5) == 0 ? ".\n" : ". ";
+        } else {
+            page += below(rng, 12) == 0 ? ", " : " ";
+        }
+        if (++pageWords == options_.wordsPerPage && i + 1 < options_.wordsPerDocument) {
+            if (page.back() != '\n') page += '\n';
+            pages.push_back(std::move(page));
+            page.clear();
+            pageWords = 0;
+        }
+    }
+    if (page.back() != '\n') page += '\n';
+    pages.push_back(std::move(page));
+    return pages;
+}
+
+std::string SyntheticCorpus::text(size_t index) const {
+    std::string text;
+    for (const std::string& page : pages(index)) text += page;
+    return text;
+}
+
+CorpusMap SyntheticCorpus::corpusMap(const std::string& prefix) const {
+    CorpusMap corpus;
+    char name[32];
+    for (size_t i = 0; i < options_.documents; ++i) {
+        std::snprintf(name, sizeof(name), "doc%06zu.pdf", i);
+        corpus.emplace(prefix + name, text(i));
+    }
+    return corpus;
+}
+
+std::vector<std::string> SyntheticCorpus::topics(size_t count, size_t terms) const {
+    std::mt19937_64 rng = documentRng(options_.seed ^ 0x746f706963ull, 0);
+    // Ranks 10..1000: common enough to match many documents, rare enough to discriminate
+    size_t lowest = std::min<size_t>(10, vocabulary_.size() - 1);
+    size_t span = std::max<size_t>(1, std::min<size_t>(1000, vocabulary_.size()) - lowest);
+    std::vector<std::string> topics;
+    topics.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string topic;
+        for (size_t t = 0; t < terms; ++t) {
+            if (t > 0) topic += ' ';
+            topic += vocabulary_[lowest + below(rng, span)];
+        }
+        topics.push_back(std::move(topic));
+    }
+    return topics;
+}
+
+bool writeSyntheticPdf(const std::string& path, const std::string& title, const std::vector<std::string>& pages) {
+    const double FONT_SIZE = 10.0;
+    const double LEADING = 12.0;
+    const double MARGIN = 72.0;
+    const size_t LINE_WIDTH = 95;
+
+    // Objects: 1 catalog, 2 page tree, 3 font, 4 info, then a page and its content stream per page
+    std::vector<std::string> objects(4 + 2 * pages.size());
+    std::string kids;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        size_t pageObject = 5 + 2 * i;
+        std::vector<std::string> lines = wrapLines(pages[i], LINE_WIDTH);
+        // Tall enough that no line falls outside the page, where poppler would not see it
+        double height = std::max(792.0, 2 * MARGIN + LEADING * lines.size());
+
+        std::ostringstream content;
+        content << "BT\n/F1 " << FONT_SIZE << " Tf\n" << LEADING << " TL\n"
+                << MARGIN << " " << height - MARGIN << " Td\n";
+        for (const std::string& line : lines) content << "(" << pdfLiteral(line) << ") Tj T*\n";
+        content << "ET\n";
+        std::string stream = content.str();
+
+        std::ostringstream page;
+        page << "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 " << height << "] "
+             << "/Resources << /Font << /F1 3 0 R >> >> /Contents " << pageObject + 1 << " 0 R >>";
+        objects[pageObject - 1] = page.str();
+        objects[pageObject] = "<< /Length " + std::to_string(stream.size()) + " >>\nstream\n" + stream + "endstream";
+        kids += (kids.empty() ? "" : " ") + std::to_string(pageObject) + " 0 R";
+    }
+    objects[0] = "<< /Type /Catalog /Pages 2 0 R >>";
+    objects[1] = "<< /Type /Pages /Kids [" + kids + "] /Count " + std::to_string(pages.size()) + " >>";
+    objects[2] = "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>";
+    objects[3] = "<< /Title (" + pdfLiteral(title) + ") /Producer (pdf_organizer synthetic corpus) >>";
+
+    std::string pdf = "%PDF-1.4\n";
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        offsets.push_back(pdf.size());
+        pdf += std::to_string(i + 1) + " 0 obj\n" + objects[i] + "\nendobj\n";
+    }
+    size_t xref = pdf.size();
+    pdf += "xref\n0 " + std::to_string(objects.size() + 1) + "\n0000000000 65535 f \n";
+    char entry[32];
+    for (size_t offset : offsets) {
+        std::snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+        pdf += entry;
+    }
+    pdf += "trailer\n<< /Size " + std::to_string(objects.size() + 1) + " /Root 1 0 R /Info 4 0 R >>\n"
+           "startxref\n" + std::to_string(xref) + "\n%%EOF\n";
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(pdf.data(), static_cast<std::streamsize>(pdf.size()));
+    return static_cast<bool>(out);
+}
+
+std::vector<std::string> writePdfCorpus(const SyntheticCorpus& corpus, const std::string& directory,
+                                        size_t perFolder) {
+    std::vector<std::string> paths;
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    char name[32];
+    for (size_t i = 0; i < corpus.options().documents; ++i) {
+        fs::path folder = directory;
+        if (perFolder > 0) {
+            std::snprintf(name, sizeof(name), "part%04zu", i / perFolder);
+            folder /= name;
+            if (i % perFolder == 0) fs::create_directories(folder, ec);
+        }
+        std::snprintf(name, sizeof(name), "doc%06zu.pdf", i);
+        std::string path = (folder / name).string();
+        if (writeSyntheticPdf(path, corpus.title(i), corpus.pages(i))) paths.push_back(path);
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+std::string syntheticScholarPage(size_t results, uint64_t seed) {
+    SyntheticCorpusOptions options;
+    options.seed = seed;
+    options.documents = results;
+    options.wordsPerDocument = 40;
+    options.stopWordRate = 0.25;
+    SyntheticCorpus corpus(options);
+
+    std::ostringstream html;
+    html << "<!doctype html><html><head><title>Google Scholar</title>"
+            "<style>.gs_r{margin:1em 0}.gs_rt{font-size:17px}</style></head><body>"
+            "<div id=\"gs_top\"><div id=\"gs_bdy\"><div id=\"gs_res_ccl\"><div id=\"gs_res_ccl_mid\">\n";
+    for (size_t i = 0; i < results; ++i) {
+        std::string title = corpus.title(i);
+        std::string snippet = corpus.text(i).substr(title.size() + 1, 180);
+        html << "<div class=\"gs_r gs_or gs_scl\" data-cid=\"c" << seed << "x" << i << "\" data-rp=\"" << i << "\">";
+        if (i % 2 == 0) {
+            html << "<div class=\"gs_ggs gs_fl\"><div class=\"gs_ggsd\"><div class=\"gs_or_ggsm\">"
+                 << "<a href=\"https://arxiv.org/pdf/2101." << 10000 + i << "\"><span class=\"gs_ctg2\">[PDF]</span> "
+                 << "arxiv.org</a></div></div></div>";
+        }
+        html << "<div class=\"gs_ri\"><h3 class=\"gs_rt\" ontouchstart=\"gs_evt_dsp(event)\">"
+             << "<span class=\"gs_ctc\"><span class=\"gs_ct1\">[PDF]</span></span> "
+             << "<a id=\"r" << i << "\" href=\"https://example.org/papers/" << i << ".pdf\" data-clk=\"hl=en&amp;sa=T\">"
+             << title << "</a></h3>"
+             << "<div class=\"gs_a\">A Author, B Author - Journal of Synthetic Results, " << 2000 + i % 25
+             << " - example.org</div>"
+             << "<div class=\"gs_rs\">" << snippet << " &hellip;</div>"
+             << "<div class=\"gs_fl gs_flb\"><a href=\"javascript:void(0)\" class=\"gs_or_sav\">Save</a> "
+             << "<a href=\"/scholar?cites=" << i << "\">Cited by " << (i * 37) % 500 << "</a></div>"
+             << "</div></div>\n";
+    }
+    html << "</div></div></div></div></body></html>\n";
+    return html.str();
+}
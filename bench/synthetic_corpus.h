@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <cstddef>
+
+#include "relevance_scorer.h"
+
+struct SyntheticCorpusOptions {
+    size_t documents = 1000;
+    size_t wordsPerDocument = 2000;
+    size_t wordsPerPage = 500;
+    size_t vocabularySize = 20000;   // Distinct content words
+    double zipfExponent = 1.0;       // Word rank r is drawn with weight 1 / r^s (0 = uniform)
+    double stopWordRate = 0.3;       // Share of words drawn from the stop-word list instead
+    uint64_t seed = 42;
+};
+
+/**
+ * @brief Deterministic text corpora shaped like papers: a title line, then
+ * sentences of words drawn from a Zipf distribution over a made-up
+ * vocabulary, mixed with stop words, capitals, punctuation and numbers so
+ * every tokenizer path is exercised. The same options always give the same
+ * corpus, so benchmark runs stay comparable.
+ */
+class SyntheticCorpus {
+public:
+    explicit SyntheticCorpus(const SyntheticCorpusOptions& options = SyntheticCorpusOptions());
+
+    const SyntheticCorpusOptions& options() const { return options_; }
+    const std::vector<std::string>& vocabulary() const { return vocabulary_; }
+
+    // Title of document `index` (a few content words).
+    std::string title(size_t index) const;
+    // Page texts of document `index`; the first page starts with the title.
+    std::vector<std::string> pages(size_t index) const;
+    // The pages concatenated, as PdfTextExtractor::extractText returns them (each page ends in a newline).
+    std::string text(size_t index) const;
+
+    // Every document, keyed "<prefix>docNNNNNN.pdf".
+    CorpusMap corpusMap(const std::string& prefix = "") const;
+
+    // `count` topics of `terms` words each, drawn from the frequent and mid-frequency ranks.
+    std::vector<std::string> topics(size_t count, size_t terms = 3) const;
+
+private:
+    const std::string& drawWord(std::mt19937_64& rng) const;
+
+    SyntheticCorpusOptions options_;
+    std::vector<std::string> vocabulary_;
+    std::vector<double> cumulative_; // Zipf CDF over vocabulary ranks
+};
+
+// Writes a minimal but valid PDF with one page per entry of `pages` (Helvetica, uncompressed streams).
+bool writeSyntheticPdf(const std::string& path, const std::string& title, const std::vector<std::string>& pages);
+
+// Writes every document of `corpus` as <directory>/docNNNNNN.pdf, `perFolder`
+// to a subfolder (0 = all flat). Returns the paths written, sorted.
+std::vector<std::string> writePdfCorpus(const SyntheticCorpus& corpus, const std::string& directory,
+                                        size_t perFolder = 0);
+
+// A Google Scholar result page in the markup ScholarResultParser reads, with `results` entries.
+std::string syntheticScholarPage(size_t results, uint64_t seed = 42);
@@ -0,0 +1,428 @@
+#include "directory_crawler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <fnmatch.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Entry types as reported by d_type; the fallback listing maps onto the same values
+enum EntryType : unsigned char { TYPE_UNKNOWN, TYPE_DIRECTORY, TYPE_FILE, TYPE_SYMLINK, TYPE_OTHER };
+
+// A PDF must start with "%PDF-", though readers accept junk before it in the first kilobyte
+const size_t SNIFF_BYTES = 1024;
+
+bool hasPdfExtension(const char* name) {
+    size_t length = std::strlen(name);
+    // Like path::extension(): a leading dot starts a hidden name, not an extension
+    return length > 4 && std::memcmp(name + length - 4, ".pdf", 4) == 0;
+}
+
+bool containsPdfHeader(const char* data, size_t size) {
+    static const char header[] = "%PDF-";
+    return std::search(data, data + size, header, header + 5) != data + size;
+}
+
+// Same joining rule as path::operator/ for a relative name
+std::string joinPath(const std::string& directory, const char* name) {
+    if (directory.empty() || directory.back() == '/') return directory + name;
+    return directory + "/" + name;
+}
+
+#ifdef __linux__
+EntryType typeOfMode(mode_t mode) {
+    if (S_ISDIR(mode)) return TYPE_DIRECTORY;
+    if (S_ISREG(mode)) return TYPE_FILE;
+    if (S_ISLNK(mode)) return TYPE_SYMLINK;
+    return TYPE_OTHER;
+}
+
+EntryType typeOfDirent(unsigned char type) {
+    switch (type) {
+    case DT_DIR: return TYPE_DIRECTORY;
+    case DT_REG: return TYPE_FILE;
+    case DT_LNK: return TYPE_SYMLINK;
+    case DT_UNKNOWN: return TYPE_UNKNOWN;
+    default: return TYPE_OTHER;
+    }
+}
+#else
+EntryType typeOfStatus(fs::file_type type) {
+    switch (type) {
+    case fs::file_type::directory: return TYPE_DIRECTORY;
+    case fs::file_type::regular: return TYPE_FILE;
+    case fs::file_type::symlink: return TYPE_SYMLINK;
+    case fs::file_type::none:
+    case fs::file_type::unknown: return TYPE_UNKNOWN;
+    default: return TYPE_OTHER;
+    }
+}
+#endif
+
+// FOLLOW_ALL only: the chain of directories above a task, to cut symlink loops
+struct Ancestor {
+    std::string id; // Device and inode
+    std::shared_ptr<const Ancestor> parent;
+};
+
+bool isAncestor(const Ancestor* ancestor, const std::string& id) {
+    for (; ancestor; ancestor = ancestor->parent.get()) {
+        if (ancestor->id == id) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+// A directory still to be listed
+struct DirectoryCrawler::Task {
+    std::string path;
+    std::string relative; // Path below the root, for exclusion globs
+    std::shared_ptr<const Ancestor> ancestors;
+};
+
+// --- State shared by the crawler threads during one crawl ---
+
+struct DirectoryCrawler::Shared {
+    // One per thread: the owner pops from the back, thieves take from the front
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<size_t> pending{0}; // Directories queued or being listed
+    std::atomic<size_t> queued{0};  // Directories queued only
+    std::atomic<unsigned> idle{0};
+    std::mutex idleMutex;
+    std::condition_variable wake;
+
+    const PdfConsumer* consumer = nullptr;
+    std::mutex consumerMutex;
+    std::exception_ptr failure; // First exception thrown by the consumer; stops the crawl
+    std::atomic<bool> stopped{false};
+
+    std::atomic<size_t> directories{0};
+    std::atomic<size_t> entries{0};
+    std::atomic<size_t> stats{0};
+    std::atomic<size_t> sniffed{0};
+    std::atomic<size_t> pdfs{0};
+    std::atomic<size_t> errors{0};
+
+    void push(unsigned worker, Task task) {
+        pending++;
+        queued++;
+        {
+            std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+            queues[worker]->tasks.push_back(std::move(task));
+        }
+        if (idle.load() > 0) {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            wake.notify_one();
+        }
+    }
+
+    bool take(unsigned worker, Task& task) {
+        const size_t count = queues.size();
+        for (size_t k = 0; k < count; ++k) {
+            Queue& queue = *queues[(worker + k) % count];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            if (k == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void finishTask() {
+        if (pending.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            wake.notify_all();
+        }
+    }
+
+    void report(const std::string& path) {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        if (stopped) return;
+        try {
+            (*consumer)(path);
+        } catch (...) {
+            failure = std::current_exception();
+            stopped = true;
+        }
+    }
+};
+
+DirectoryCrawler::DirectoryCrawler(const CrawlOptions& options)
+    : options_(options), threads_(options.threads) {
+    if (threads_ == 0) {
+        // Listing is latency-bound (especially over NFS), so use a few threads even on small machines
+        threads_ = std::max(4u, std::thread::hardware_concurrency());
+    }
+}
+
+bool DirectoryCrawler::excludedName(const std::string& name, const std::string& relative) const {
+    for (const auto& glob : options_.excludeGlobs) {
+        bool matched = glob.find('/') == std::string::npos
+                           ? fnmatch(glob.c_str(), name.c_str(), 0) == 0
+                           : fnmatch(glob.c_str(), relative.c_str(), FNM_PATHNAME) == 0;
+        if (matched) return true;
+    }
+    return false;
+}
+
+bool DirectoryCrawler::isExcluded(const std::string& rootPath, const std::string& path) const {
+    if (options_.excludeGlobs.empty()) return false;
+    std::string prefix = rootPath.empty() || rootPath.back() == '/' ? rootPath : rootPath + "/";
+    if (path.compare(0, prefix.size(), prefix) != 0) return false;
+
+    // Check every component, so files below an excluded directory are excluded too
+    std::string relative;
+    size_t start = prefix.size();
+    while (start < path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) end = path.size();
+        std::string name = path.substr(start, end - start);
+        relative += relative.empty() ? name : "/" + name;
+        if (!name.empty() && excludedName(name, relative)) return true;
+        start = end + 1;
+    }
+    return false;
+}
+
+bool DirectoryCrawler::crawl(const std::string& rootPath, const PdfConsumer& consumer) {
+    stats_ = CrawlStats();
+    std::error_code ec;
+    if (!fs::is_directory(rootPath, ec)) return false;
+
+    Shared shared;
+    shared.consumer = &consumer;
+    for (unsigned i = 0; i < threads_; ++i) shared.queues.emplace_back(new Shared::Queue());
+    shared.push(0, Task{rootPath, "", nullptr});
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < threads_; ++i) {
+        threads.emplace_back([this, &shared, i] { worker(shared, i); });
+    }
+    for (auto& thread : threads) thread.join();
+
+    stats_.directories = shared.directories;
+    stats_.entries = shared.entries;
+    stats_.stats = shared.stats;
+    stats_.sniffed = shared.sniffed;
+    stats_.pdfs = shared.pdfs;
+    stats_.errors = shared.errors;
+    if (shared.failure) std::rethrow_exception(shared.failure);
+    return true;
+}
+
+void DirectoryCrawler::worker(Shared& shared, unsigned id) {
+    while (true) {
+        Task task;
+        if (shared.take(id, task)) {
+            if (!shared.stopped) listDirectory(shared, id, std::move(task));
+            shared.finishTask();
+            continue;
+        }
+
+        // Nothing to take: sleep until a directory is queued or the crawl is over.
+        // idle is raised before re-checking, so a concurrent push always sees it.
+        std::unique_lock<std::mutex> lock(shared.idleMutex);
+        shared.idle++;
+        while (shared.pending.load() > 0 && shared.queued.load() == 0) shared.wake.wait(lock);
+        shared.idle--;
+        if (shared.pending.load() == 0) return;
+    }
+}
+
+#ifdef __linux__
+
+void DirectoryCrawler::listDirectory(Shared& shared, unsigned worker, Task task) {
+    const std::string& directory = task.path;
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        // A directory removed since it was listed is not an error
+        if (errno != ENOENT) {
+            std::cerr << "[Crawl Error] Could not open " << directory << ": " << std::strerror(errno) << std::endl;
+            shared.errors++;
+        }
+        return;
+    }
+    if (options_.symlinks == CrawlOptions::FOLLOW_ALL) {
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            std::string id = std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino);
+            if (isAncestor(task.ancestors.get(), id)) {
+                close(fd);
+                return;
+            }
+            task.ancestors = std::make_shared<const Ancestor>(Ancestor{id, task.ancestors});
+        }
+    }
+    shared.directories++;
+
+    alignas(struct dirent64) char buffer[32 * 1024];
+    while (true) {
+        long length = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (length < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[Crawl Error] Could not read " << directory << ": " << std::strerror(errno) << std::endl;
+            shared.errors++;
+            break;
+        }
+        if (length == 0) break;
+        for (long offset = 0; offset < length;) {
+            const struct dirent64* entry = reinterpret_cast<const struct dirent64*>(buffer + offset);
+            offset += entry->d_reclen;
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+            shared.entries++;
+            handleEntry(shared, worker, fd, task, name, typeOfDirent(entry->d_type));
+        }
+    }
+    close(fd);
+}
+
+void DirectoryCrawler::handleEntry(Shared& shared, unsigned worker, int directoryFd, const Task& directory,
+                                   const char* name, unsigned char type) {
+    const std::string childRelative = directory.relative.empty() ? std::string(name) : directory.relative + "/" + name;
+    if (!options_.excludeGlobs.empty() && excludedName(name, childRelative)) return;
+
+    struct stat st;
+    if (type == TYPE_UNKNOWN) {
+        // No d_type from this filesystem: one lstat decides
+        shared.stats++;
+        if (fstatat(directoryFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) return;
+        type = typeOfMode(st.st_mode);
+    }
+    if (type == TYPE_SYMLINK) {
+        if (options_.symlinks == CrawlOptions::SKIP_SYMLINKS) return;
+        shared.stats++;
+        if (fstatat(directoryFd, name, &st, 0) != 0) return; // Dangling
+        type = typeOfMode(st.st_mode);
+        if (type == TYPE_DIRECTORY && options_.symlinks != CrawlOptions::FOLLOW_ALL) return;
+    }
+
+    if (type == TYPE_DIRECTORY) {
+        shared.push(worker, Task{joinPath(directory.path, name), childRelative, directory.ancestors});
+        return;
+    }
+    if (type != TYPE_FILE) return;
+
+    if (options_.sniffPdfMagic) {
+        shared.sniffed++;
+        int fd = openat(directoryFd, name, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+        if (fd < 0) {
+            shared.errors++;
+            return;
+        }
+        char head[SNIFF_BYTES];
+        ssize_t got = pread(fd, head, sizeof(head), 0);
+        close(fd);
+        if (got <= 0 || !containsPdfHeader(head, static_cast<size_t>(got))) return;
+    } else if (!hasPdfExtension(name)) {
+        return;
+    }
+    shared.pdfs++;
+    shared.report(joinPath(directory.path, name));
+}
+
+#else // !__linux__
+
+void DirectoryCrawler::listDirectory(Shared& shared, unsigned worker, Task task) {
+    const std::string& directory = task.path;
+    std::error_code ec;
+    fs::directory_iterator it(directory, ec);
+    if (ec) {
+        std::cerr << "[Crawl Error] Could not open " << directory << ": " << ec.message() << std::endl;
+        shared.errors++;
+        return;
+    }
+    if (options_.symlinks == CrawlOptions::FOLLOW_ALL) {
+        // No inode numbers here: the canonical path identifies the directory
+        std::string id = fs::canonical(directory, ec).string();
+        if (!ec) {
+            if (isAncestor(task.ancestors.get(), id)) return;
+            task.ancestors = std::make_shared<const Ancestor>(Ancestor{id, task.ancestors});
+        }
+    }
+    shared.directories++;
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        if (ec) {
+            shared.errors++;
+            break;
+        }
+        shared.entries++;
+        const std::string name = it->path().filename().string();
+        handleEntry(shared, worker, -1, task, name.c_str(),
+                    typeOfStatus(it->symlink_status(ec).type()));
+    }
+}
+
+void DirectoryCrawler::handleEntry(Shared& shared, unsigned worker, int, const Task& directory, const char* name,
+                                   unsigned char type) {
+    const std::string childRelative = directory.relative.empty() ? std::string(name) : directory.relative + "/" + name;
+    if (!options_.excludeGlobs.empty() && excludedName(name, childRelative)) return;
+
+    const std::string path = joinPath(directory.path, name);
+    std::error_code ec;
+    if (type == TYPE_UNKNOWN) {
+        shared.stats++;
+        type = typeOfStatus(fs::symlink_status(path, ec).type());
+    }
+    if (type == TYPE_SYMLINK) {
+        if (options_.symlinks == CrawlOptions::SKIP_SYMLINKS) return;
+        shared.stats++;
+        type = typeOfStatus(fs::status(path, ec).type());
+        if (type == TYPE_DIRECTORY && options_.symlinks != CrawlOptions::FOLLOW_ALL) return;
+    }
+
+    if (type == TYPE_DIRECTORY) {
+        shared.push(worker, Task{path, childRelative, directory.ancestors});
+        return;
+    }
+    if (type != TYPE_FILE) return;
+
+    if (options_.sniffPdfMagic) {
+        shared.sniffed++;
+        std::ifstream in(path, std::ios::binary);
+        char head[SNIFF_BYTES];
+        in.read(head, sizeof(head));
+        if (!containsPdfHeader(head, static_cast<size_t>(in.gcount()))) return;
+    } else if (!hasPdfExtension(name)) {
+        return;
+    }
+    shared.pdfs++;
+    shared.report(path);
+}
+
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+struct CrawlOptions {
+    enum SymlinkPolicy {
+        SKIP_SYMLINKS,  // Ignore every symlink
+        FOLLOW_FILES,   // Report symlinked files, never enter symlinked directories
+        FOLLOW_ALL,     // Also enter symlinked directories; a link back to an ancestor is not followed
+    };
+
+    unsigned threads = 0;                    // Crawler threads (0 = one per hardware thread, at least 4)
+    SymlinkPolicy symlinks = FOLLOW_FILES;
+    std::vector<std::string> excludeGlobs;   // fnmatch patterns; see DirectoryCrawler::isExcluded
+    bool sniffPdfMagic = false;              // Match on a "%PDF-" header instead of the .pdf extension
+};
+
+struct CrawlStats {
+    size_t directories = 0; // Directories listed
+    size_t entries = 0;     // Directory entries seen
+    size_t stats = 0;       // Entries whose type needed an extra stat
+    size_t sniffed = 0;     // Files opened to check their header
+    size_t pdfs = 0;        // Files reported
+    size_t errors = 0;      // Directories or files that could not be read
+};
+
+/**
+ * @brief Walks a directory tree on several threads and reports the PDFs in it.
+ *
+ * Every thread owns a deque of directories still to be listed: it works
+ * depth-first from the back of its own deque and, when that runs dry, steals
+ * from the front of another thread's, so one huge subtree keeps every
+ * thread busy. On Linux directories are read with getdents64 and entry types
+ * come from d_type, so most entries cost no stat at all (only DT_UNKNOWN
+ * entries and followed symlinks are stat'ed). Elsewhere the listing falls
+ * back to std::filesystem::directory_iterator.
+ *
+ * Paths are built like std::filesystem::path's operator/ does, so a file is
+ * reported under exactly the string recursive_directory_iterator gave it.
+ * Unreadable directories are reported and skipped; the walk goes on.
+ */
+class DirectoryCrawler {
+public:
+    // Called for every PDF as soon as it is found, from crawler threads but one call at a time.
+    using PdfConsumer = std::function<void(const std::string& path)>;
+
+    explicit DirectoryCrawler(const CrawlOptions& options = CrawlOptions());
+
+    // Returns false if `rootPath` is not a readable directory.
+    bool crawl(const std::string& rootPath, const PdfConsumer& consumer);
+
+    /**
+     * @brief Whether the exclusion globs drop `path`, which lies at or below `rootPath`.
+     * Patterns without a '/' are matched against each path component (an
+     * excluded directory hides everything below it); patterns with a '/'
+     * against the path relative to the root.
+     */
+    bool isExcluded(const std::string& rootPath, const std::string& path) const;
+
+    const CrawlStats& stats() const { return stats_; }
+    unsigned threadCount() const { return threads_; }
+
+private:
+    struct Task;
+    struct Shared;
+    // Lists one directory, queueing subdirectories and reporting PDFs.
+    void listDirectory(Shared& shared, unsigned worker, Task directory);
+    void worker(Shared& shared, unsigned id);
+    // Decides on one entry, given the type the listing reported for it (possibly unknown).
+    void handleEntry(Shared& shared, unsigned worker, int directoryFd, const Task& directory, const char* name,
+                     unsigned char type);
+    bool excludedName(const std::string& name, const std::string& relative) const;
+
+    CrawlOptions options_;
+    unsigned threads_;
+    CrawlStats stats_;
+};
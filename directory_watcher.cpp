@@ -0,0 +1,197 @@
+#include "directory_watcher.h"
+
+#include <iostream>
+#include <filesystem>
+#include <set>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool isPdfPath(const std::string& path) {
+    return fs::path(path).extension() == ".pdf";
+}
+
+// Keeps only the last event per path, in the order those last events happened.
+std::vector<WatchEvent> coalesce(const std::vector<WatchEvent>& events) {
+    std::vector<WatchEvent> result;
+    std::set<std::string> seen;
+    bool overflow = false;
+    for (auto it = events.rbegin(); it != events.rend(); ++it) {
+        if (it->kind == WatchEvent::Overflow) {
+            overflow = true;
+            continue;
+        }
+        if (seen.insert(it->path).second) result.push_back(*it);
+    }
+    std::reverse(result.begin(), result.end());
+    // An overflow makes every individual event moot
+    if (overflow) return {WatchEvent{WatchEvent::Overflow, ""}};
+    return result;
+}
+
+} // namespace
+
+DirectoryWatcher::~DirectoryWatcher() {
+    stop();
+}
+
+#ifdef __linux__
+
+const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                            IN_DELETE_SELF | IN_ONLYDIR;
+
+bool DirectoryWatcher::start(const std::string& rootPath) {
+    stop();
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "[Watch Error] inotify_init1 failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    addWatchTree(rootPath);
+    if (watchPaths_.empty()) {
+        std::cerr << "[Watch Error] Could not watch " << rootPath << std::endl;
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void DirectoryWatcher::stop() {
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+    watchPaths_.clear();
+}
+
+void DirectoryWatcher::addWatch(const std::string& directory) {
+    int wd = inotify_add_watch(fd_, directory.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        std::cerr << "[Watch Error] Could not watch " << directory << ": " << std::strerror(errno)
+                  << (errno == ENOSPC ? " (raise fs.inotify.max_user_watches)" : "") << std::endl;
+        return;
+    }
+    watchPaths_[wd] = directory;
+}
+
+void DirectoryWatcher::addWatchTree(const std::string& directory) {
+    addWatch(directory);
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(directory, fs::directory_options::skip_permission_denied, ec);
+         it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (ec) break;
+        if (it->is_directory(ec) && !it->is_symlink(ec)) addWatch(it->path().string());
+    }
+}
+
+void DirectoryWatcher::removeWatchTree(const std::string& directory) {
+    const std::string prefix = directory + "/";
+    for (auto it = watchPaths_.begin(); it != watchPaths_.end();) {
+        if (it->second == directory || it->second.compare(0, prefix.size(), prefix) == 0) {
+            inotify_rm_watch(fd_, it->first);
+            it = watchPaths_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool DirectoryWatcher::drain(std::vector<WatchEvent>& events) {
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    while (true) {
+        ssize_t length = read(fd_, buffer, sizeof(buffer));
+        if (length < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            if (errno == EINTR) continue;
+            std::cerr << "[Watch Error] read failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (length == 0) return true;
+
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                events.push_back(WatchEvent{WatchEvent::Overflow, ""});
+                continue;
+            }
+            auto dir = watchPaths_.find(event->wd);
+            if (dir == watchPaths_.end()) continue;
+            if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+                // The parent's IN_DELETE/IN_MOVED_FROM already reported the directory
+                if (event->mask & IN_IGNORED) watchPaths_.erase(dir);
+                continue;
+            }
+            if (event->len == 0) continue;
+
+            const std::string path = dir->second + "/" + event->name;
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    addWatchTree(path);
+                    events.push_back(WatchEvent{WatchEvent::DirectoryAdded, path});
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    removeWatchTree(path);
+                    events.push_back(WatchEvent{WatchEvent::DirectoryRemoved, path});
+                }
+            } else if (isPdfPath(path)) {
+                // IN_CREATE alone is ignored: the file is reported once it is closed
+                if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                    events.push_back(WatchEvent{WatchEvent::FileChanged, path});
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    events.push_back(WatchEvent{WatchEvent::FileRemoved, path});
+                }
+            }
+        }
+    }
+}
+
+std::vector<WatchEvent> DirectoryWatcher::waitForChanges(int timeoutMs, int settleMs) {
+    std::vector<WatchEvent> events;
+    if (fd_ < 0) return events;
+
+    struct pollfd pfd;
+    pfd.fd = fd_;
+    pfd.events = POLLIN;
+    int ready = poll(&pfd, 1, timeoutMs);
+    if (ready <= 0) return events;
+
+    // Keep reading until the tree has been quiet for settleMs
+    do {
+        if (!drain(events)) break;
+    } while (poll(&pfd, 1, settleMs) > 0);
+
+    return coalesce(events);
+}
+
+#else // !__linux__
+
+bool DirectoryWatcher::start(const std::string& rootPath) {
+    std::cerr << "[Watch Error] Watch mode needs inotify, which is only available on Linux (cannot watch "
+              << rootPath << ")." << std::endl;
+    return false;
+}
+
+void DirectoryWatcher::stop() {
+    fd_ = -1;
+    watchPaths_.clear();
+}
+
+void DirectoryWatcher::addWatch(const std::string&) {}
+void DirectoryWatcher::addWatchTree(const std::string&) {}
+void DirectoryWatcher::removeWatchTree(const std::string&) {}
+bool DirectoryWatcher::drain(std::vector<WatchEvent>&) { return false; }
+
+std::vector<WatchEvent> DirectoryWatcher::waitForChanges(int, int) {
+    return {};
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+
+// A coalesced filesystem change under the watched tree.
+struct WatchEvent {
+    enum Kind {
+        FileChanged,      // PDF created, rewritten or moved in
+        FileRemoved,      // PDF deleted or moved out
+        DirectoryAdded,   // Directory created or moved in; its contents must be scanned
+        DirectoryRemoved, // Directory deleted or moved out; everything below it is gone
+        Overflow          // Kernel queue overflowed; a full reconcile is required
+    };
+    Kind kind;
+    std::string path;
+};
+
+/**
+ * @brief Recursive watcher for a directory tree, backed by inotify.
+ *
+ * Every directory below the root gets its own watch; watches for new
+ * directories are added as they appear. Only events for `.pdf` files and
+ * directories are reported. Watching is only available on Linux; elsewhere
+ * start() fails with a message.
+ */
+class DirectoryWatcher {
+public:
+    DirectoryWatcher() = default;
+    ~DirectoryWatcher();
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    // Starts watching `rootPath` and all directories below it.
+    bool start(const std::string& rootPath);
+    void stop();
+
+    /**
+     * @brief Waits up to `timeoutMs` for changes (-1 = forever).
+     * Once something arrives, keeps collecting until the tree has been quiet for
+     * `settleMs`, so a file being copied in produces one event, not dozens.
+     * Multiple events for the same path collapse into the last one.
+     */
+    std::vector<WatchEvent> waitForChanges(int timeoutMs, int settleMs = 250);
+
+private:
+    void addWatchTree(const std::string& directory);
+    void addWatch(const std::string& directory);
+    void removeWatchTree(const std::string& directory);
+    // Reads whatever is queued, appending to `events`. Returns false on error.
+    bool drain(std::vector<WatchEvent>& events);
+
+    int fd_ = -1;
+    std::map<int, std::string> watchPaths_; // Watch descriptor -> directory
+};
@@ -0,0 +1,281 @@
+#include "extraction_pipeline.h"
+#include "extraction_sandbox.h"
+
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <exception>
+#include <deque>
+
+namespace {
+
+// Largest consumed page buffer kept for reuse
+const size_t MAX_SPARE_TEXT = 1 << 20;
+
+} // namespace
+
+ExtractionPipeline::ExtractionPipeline(unsigned workerCount, size_t maxInFlight)
+    : workerCount_(workerCount), maxInFlight_(maxInFlight) {
+    if (workerCount_ == 0) {
+        workerCount_ = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (maxInFlight_ == 0) {
+        maxInFlight_ = 2 * static_cast<size_t>(workerCount_);
+    }
+    // A window smaller than the pool would just leave workers idle
+    maxInFlight_ = std::max(maxInFlight_, static_cast<size_t>(workerCount_));
+}
+
+void ExtractionPipeline::setSandbox(ExtractionSandbox* sandbox) {
+    // Each thread holds a sandbox worker for a whole document. With fewer workers
+    // than threads, the head document's thread could wait for one forever while
+    // the others keep theirs and wait for it in the memory budget.
+    if (sandbox && sandbox->workerCount() < workerCount_) {
+        std::cerr << "[Extraction] The sandbox has " << sandbox->workerCount() << " worker(s); using as many "
+                  << "extraction threads instead of " << workerCount_ << "." << std::endl;
+        workerCount_ = std::max(1u, sandbox->workerCount());
+    }
+    extractor_.setSandbox(sandbox);
+}
+
+bool ExtractionPipeline::extractOne(const std::string& pdfPath, const PdfTextExtractor::ChunkConsumer& consumer) const {
+    try {
+        return extractor_.extractChunks(pdfPath, consumer);
+    } catch (const std::exception& e) {
+        std::cerr << "[Extraction Error] " << pdfPath << ": " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "[Extraction Error] " << pdfPath << ": unknown exception" << std::endl;
+    }
+    return false;
+}
+
+void ExtractionPipeline::PathQueue::push(std::string path) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (closed_) return;
+        paths_.push_back(std::move(path));
+    }
+    pushed_.notify_all();
+}
+
+void ExtractionPipeline::PathQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        closed_ = true;
+    }
+    pushed_.notify_all();
+}
+
+const std::string* ExtractionPipeline::PathQueue::waitFor(size_t index) const {
+    std::unique_lock<std::mutex> lock(mtx_);
+    pushed_.wait(lock, [&] { return closed_ || index < paths_.size(); });
+    return index < paths_.size() ? &paths_[index] : nullptr;
+}
+
+bool ExtractionPipeline::PathQueue::closedAt(size_t& size) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    size = paths_.size();
+    return closed_;
+}
+
+void ExtractionPipeline::run(const std::vector<std::string>& pdfPaths, const DocumentConsumer& consumer) const {
+    // Reassembles each document's pages
+    class Collector : public PageConsumer {
+    public:
+        explicit Collector(const DocumentConsumer& consumer) : consumer_(consumer) {}
+        void beginDocument(const std::string&) override { text_.clear(); }
+        void page(const std::string&, std::string_view text, TextField field) override {
+            if (field != FIELD_TITLE) text_.append(text);
+        }
+        void endDocument(const std::string& path, bool extracted) override {
+            if (!extracted) text_.clear();
+            consumer_(path, std::move(text_));
+            text_ = std::string();
+        }
+
+    private:
+        const DocumentConsumer& consumer_;
+        std::string text_;
+    } collector(consumer);
+    runPages(pdfPaths, collector);
+}
+
+void ExtractionPipeline::runPages(const std::vector<std::string>& pdfPaths, PageConsumer& consumer) const {
+    PathQueue paths;
+    for (const auto& path : pdfPaths) paths.push(path);
+    paths.close();
+    runPages(paths, consumer);
+}
+
+void ExtractionPipeline::runPages(PathQueue& paths, PageConsumer& consumer) const {
+    // A closed queue's length is known up front; an open one may still grow to any length
+    size_t total = 0;
+    const bool closed = paths.closedAt(total);
+    peakBuffered_ = 0;
+    if (closed && total == 0) return;
+
+    // --- Sequential path: no point in spinning up threads ---
+    if (workerCount_ <= 1 || (closed && total == 1)) {
+        for (size_t i = 0; const std::string* next = paths.waitFor(i); ++i) {
+            const std::string& path = *next;
+            consumer.beginDocument(path);
+            size_t bytes = 0;
+            bool opened = extractOne(path, [&](std::string&& text, TextField field) {
+                bytes += text.size();
+                consumer.page(path, text, field);
+                return true;
+            });
+            consumer.endDocument(path, opened && bytes > 0);
+        }
+        return;
+    }
+
+    // --- Shared state ---
+    // Document i lives in slots[i % window] between extraction and consumption.
+    // A worker may only claim document i while i < nextToConsume + window, so a
+    // slot is never reused before the main thread has finished with it.
+    struct Page {
+        std::string text;
+        TextField field;
+    };
+    struct Slot {
+        std::deque<Page> pages;
+        size_t bytes = 0; // All bytes extracted so far, consumed or not
+        bool done = false;
+        bool extracted = false;
+    };
+    const size_t window = closed ? std::min(maxInFlight_, total) : maxInFlight_;
+    std::vector<Slot> slots(window);
+    // Consumed page buffers, kept with their capacity: a worker swaps one in for
+    // each page it hands over, so the extractor refills it instead of allocating
+    // a string per page for the calling thread to free.
+    std::vector<std::string> spareTexts;
+    spareTexts.reserve(window);
+    size_t nextToClaim = 0;
+    size_t nextToConsume = 0;
+    bool exhausted = false; // A worker found the queue closed before its document
+    size_t buffered = 0;
+    bool aborted = false;
+
+    std::mutex mtx;
+    std::condition_variable claimCv;   // workers wait for room in the window
+    std::condition_variable budgetCv;  // workers wait for room in the memory budget
+    std::condition_variable readyCv;   // main thread waits for the next page
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            claimCv.wait(lock, [&] {
+                return aborted || exhausted || nextToClaim < nextToConsume + window;
+            });
+            if (aborted || exhausted) return;
+
+            size_t index = nextToClaim++;
+            Slot& slot = slots[index % window];
+            lock.unlock();
+            const std::string* path = paths.waitFor(index);
+            if (!path) {
+                lock.lock();
+                exhausted = true;
+                claimCv.notify_all();
+                return;
+            }
+            bool opened = extractOne(*path, [&](std::string&& text, TextField field) {
+                std::unique_lock<std::mutex> pageLock(mtx);
+                budgetCv.wait(pageLock, [&] {
+                    // The head document may always add a page when the consumer has
+                    // none of its pages left, so the pipeline can never stall
+                    return aborted || memoryBudget_ == 0 || buffered + text.size() <= memoryBudget_ ||
+                           buffered == 0 || (index == nextToConsume && slot.pages.empty());
+                });
+                if (aborted) return false;
+                buffered += text.size();
+                if (buffered > peakBuffered_.load()) peakBuffered_ = buffered;
+                slot.bytes += text.size();
+                std::string buffer;
+                if (!spareTexts.empty()) {
+                    buffer = std::move(spareTexts.back());
+                    spareTexts.pop_back();
+                }
+                buffer.swap(text);
+                slot.pages.push_back(Page{std::move(buffer), field});
+                if (index == nextToConsume) readyCv.notify_one();
+                return true;
+            });
+            lock.lock();
+
+            slot.done = true;
+            slot.extracted = opened && slot.bytes > 0;
+            if (index == nextToConsume) readyCv.notify_one();
+        }
+    };
+
+    unsigned threadCount = closed ? static_cast<unsigned>(std::min<size_t>(workerCount_, total)) : workerCount_;
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for (unsigned t = 0; t < threadCount; ++t) {
+        threads.emplace_back(worker);
+    }
+
+    // --- Consume in input order on the calling thread ---
+    try {
+        for (size_t i = 0; const std::string* next = paths.waitFor(i); ++i) {
+            const std::string& path = *next;
+            Slot& slot = slots[i % window];
+            consumer.beginDocument(path);
+            while (true) {
+                Page page;
+                bool finished = false;
+                bool extracted = false;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    readyCv.wait(lock, [&] { return !slot.pages.empty() || slot.done; });
+                    if (slot.pages.empty()) {
+                        finished = true;
+                        extracted = slot.extracted;
+                        // Reset in place so the deque keeps its storage
+                        slot.bytes = 0;
+                        slot.done = false;
+                        slot.extracted = false;
+                        ++nextToConsume;
+                    } else {
+                        page = std::move(slot.pages.front());
+                        slot.pages.pop_front();
+                    }
+                }
+                if (finished) {
+                    // Document finished: its slot is free and the next one is now the head
+                    claimCv.notify_all();
+                    budgetCv.notify_all();
+                    consumer.endDocument(path, extracted);
+                    break;
+                }
+                consumer.page(path, page.text, page.field);
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    buffered -= page.text.size();
+                    // Capacity is not counted against the budget, so keep only ordinary pages
+                    if (spareTexts.size() < window && page.text.capacity() <= MAX_SPARE_TEXT) {
+                        spareTexts.push_back(std::move(page.text));
+                    }
+                }
+                budgetCv.notify_all();
+            }
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            aborted = true;
+        }
+        // Also wakes workers waiting for a path that will now never come
+        paths.close();
+        claimCv.notify_all();
+        budgetCv.notify_all();
+        for (auto& t : threads) t.join();
+        throw;
+    }
+
+    for (auto& t : threads) t.join();
+}
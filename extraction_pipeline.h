@@ -0,0 +1,110 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <string_view>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include "pdf_extractor.h"
+
+/**
+ * @brief Extracts a list of PDFs on a pool of worker threads.
+ *
+ * Workers pull paths from a shared queue and each extracts one document at a
+ * time, handing it over page by page. Pages reach the consumer on the calling
+ * thread strictly in input order, so the resulting corpus is identical to a
+ * sequential run, and the document at the head of the order is consumed while
+ * it is still being extracted. At most `maxInFlight` documents are being
+ * extracted or waiting to be consumed at any moment.
+ *
+ * Pages extracted ahead of the consumer are buffered against a memory budget:
+ * a worker that would exceed it waits until the consumer catches up. The
+ * document being consumed may always hand over its next page once the consumer
+ * has run out of them, so one oversized page never stalls the pipeline; the
+ * buffer can then exceed the budget by at most that page.
+ */
+class ExtractionPipeline {
+public:
+    // Called once per input path, in input order, with the page text (no metadata).
+    // Empty text means extraction failed.
+    using DocumentConsumer = std::function<void(const std::string& path, std::string&& text)>;
+
+    // Receives documents as a sequence of pages, in input order.
+    class PageConsumer {
+    public:
+        virtual ~PageConsumer() = default;
+        virtual void beginDocument(const std::string& path) = 0;
+        // One piece of text ending on whitespace (see PdfTextExtractor::ChunkConsumer)
+        virtual void page(const std::string& path, std::string_view text, TextField field) = 0;
+        // `extracted` is false if the document could not be read or had no text; pages seen so far are then void.
+        virtual void endDocument(const std::string& path, bool extracted) = 0;
+    };
+
+    // Paths handed to runPages while it runs, e.g. by a crawl on another thread.
+    // Extraction starts on the first path; runPages returns once the queue is
+    // closed and everything pushed before that has been consumed.
+    class PathQueue {
+    public:
+        void push(std::string path);
+        // No more paths; later pushes are ignored
+        void close();
+
+    private:
+        friend class ExtractionPipeline;
+        // Blocks until path `index` was pushed (returned) or the queue closed before it (null)
+        const std::string* waitFor(size_t index) const;
+        // True once closed, with the final number of paths in `size`
+        bool closedAt(size_t& size) const;
+
+        mutable std::mutex mtx_;
+        mutable std::condition_variable pushed_;
+        std::deque<std::string> paths_; // A deque keeps earlier paths in place while it grows
+        bool closed_ = false;
+    };
+
+    /**
+     * @param workerCount Number of extraction threads (0 = one per hardware thread).
+     * @param maxInFlight Maximum number of unconsumed documents (0 = twice the worker count).
+     */
+    explicit ExtractionPipeline(unsigned workerCount = 0, size_t maxInFlight = 0);
+
+    // Whole-document convenience wrapper around runPages.
+    void run(const std::vector<std::string>& pdfPaths, const DocumentConsumer& consumer) const;
+
+    void runPages(const std::vector<std::string>& pdfPaths, PageConsumer& consumer) const;
+
+    // Consumes paths in the order they are pushed. Closes `paths` if the consumer throws.
+    void runPages(PathQueue& paths, PageConsumer& consumer) const;
+
+    // Persistent text cache shared by all workers (not owned, may be null)
+    void setTextCache(const TextCache* cache) { extractor_.setCache(cache); }
+
+    // Run poppler in these worker processes instead of in-process (not owned, may be null).
+    // Lowers the worker count to the sandbox's if it has fewer processes than that.
+    void setSandbox(ExtractionSandbox* sandbox);
+
+    void setExtractionLimits(const ExtractionLimits& limits) { extractor_.setLimits(limits); }
+
+    // Bytes of extracted pages allowed to wait for the consumer (0 = unlimited)
+    void setMemoryBudget(size_t bytes) { memoryBudget_ = bytes; }
+
+    unsigned workerCount() const { return workerCount_; }
+    size_t maxInFlight() const { return maxInFlight_; }
+    size_t memoryBudget() const { return memoryBudget_; }
+    // Most page bytes buffered at once during the last run
+    size_t peakBufferedBytes() const { return peakBuffered_.load(); }
+
+private:
+    // Extracts a single document into `consumer`, never throwing. Returns false on failure.
+    bool extractOne(const std::string& pdfPath, const PdfTextExtractor::ChunkConsumer& consumer) const;
+
+    PdfTextExtractor extractor_;
+    unsigned workerCount_;
+    size_t maxInFlight_;
+    size_t memoryBudget_ = 0;
+    mutable std::atomic<size_t> peakBuffered_{0};
+};
@@ -0,0 +1,446 @@
+#include "extraction_sandbox.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <new>
+#include <limits>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+namespace {
+
+// --- Wire format ---
+// Request:  uint64 maxPages, uint64 maxBytes, uint32 path length, path bytes
+// Response: one frame per page, then one final frame; a frame is a type byte,
+//           a field byte (TextField, pages only), a uint32 payload length and the payload.
+constexpr char FRAME_PAGE = 'P';
+constexpr char FRAME_DONE = 'D';      // Payload: one byte, 1 if a limit truncated the text
+constexpr char FRAME_FAILED = 'F';    // Could not open the document
+constexpr char FRAME_ERROR = 'X';     // Exception; payload is the message
+constexpr char FRAME_OOM = 'M';       // Memory limit hit; the worker exits after sending it
+
+// Frames never carry more than the text limit, except for error messages
+const size_t FRAME_SLACK = 64 * 1024;
+
+#pragma pack(push, 1)
+struct RequestHeader {
+    uint64_t maxPages;
+    uint64_t maxBytes;
+    uint32_t pathLength;
+};
+
+struct FrameHeader {
+    char type;
+    uint8_t field;
+    uint32_t length;
+};
+#pragma pack(pop)
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Blocking read of exactly `size` bytes; false on EOF or error.
+bool readAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+enum class ReadStatus { OK, TIMEOUT, CLOSED };
+
+// Reads exactly `size` bytes, charging the time spent waiting against `remainingMs`.
+ReadStatus readTimed(int fd, void* data, size_t size, int64_t& remainingMs) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        if (remainingMs <= 0) return ReadStatus::TIMEOUT;
+        pollfd pfd{fd, POLLIN, 0};
+        auto start = std::chrono::steady_clock::now();
+        int ready = ::poll(&pfd, 1, static_cast<int>(std::min<int64_t>(remainingMs, std::numeric_limits<int>::max())));
+        remainingMs -= std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) return ReadStatus::CLOSED;
+        if (ready == 0) continue;
+
+        ssize_t n = ::read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return ReadStatus::CLOSED;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return ReadStatus::OK;
+}
+
+bool writeFrame(int fd, char type, const char* data, size_t size, TextField field = FIELD_BODY) {
+    FrameHeader header{type, field, static_cast<uint32_t>(size)};
+    return writeAll(fd, &header, sizeof(header)) && (size == 0 || writeAll(fd, data, size));
+}
+
+bool makePipe(int fds[2]) {
+#ifdef __linux__
+    return ::pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (::pipe(fds) != 0) return false;
+    ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+} // namespace
+
+struct ExtractionSandbox::Worker {
+    pid_t pid = -1;
+    int requestFd = -1;   // Our end of the worker's stdin
+    int responseFd = -1;  // Our end of the worker's protocol output
+};
+
+ExtractionSandbox::ExtractionSandbox(const SandboxOptions& options) : options_(options) {
+    if (options_.workers == 0) {
+        options_.workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (options_.executable.empty()) {
+#ifdef __linux__
+        options_.executable = "/proc/self/exe";
+#else
+        // No portable way to find our own binary; callers pass argv[0] (see main.cpp)
+        std::cerr << "[Sandbox Error] No worker executable configured (SandboxOptions::executable); "
+                  << "sandboxed extraction will fail." << std::endl;
+#endif
+    }
+    // A worker dying mid-request must not take us down with it
+    std::signal(SIGPIPE, SIG_IGN);
+    loadQuarantine();
+
+    for (unsigned i = 0; i < options_.workers; ++i) {
+        workers_.emplace_back(new Worker());
+        spawn(*workers_.back());
+        idle_.push_back(workers_.back().get());
+    }
+}
+
+ExtractionSandbox::~ExtractionSandbox() {
+    // Closing stdin tells an idle worker to exit
+    for (auto& worker : workers_) {
+        if (worker->pid > 0) reap(*worker, false);
+    }
+}
+
+bool ExtractionSandbox::spawn(Worker& worker) {
+    if (options_.executable.empty()) return false;
+    int request[2];
+    int response[2];
+    if (!makePipe(request)) return false;
+    if (!makePipe(response)) {
+        ::close(request[0]);
+        ::close(request[1]);
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, request[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, response[1], STDOUT_FILENO);
+
+    std::string memoryLimit = std::to_string(options_.memoryLimitBytes);
+    char* argv[] = {const_cast<char*>(options_.executable.c_str()), const_cast<char*>(WORKER_FLAG),
+                    const_cast<char*>(memoryLimit.c_str()), nullptr};
+    pid_t pid = -1;
+    int rc = posix_spawnp(&pid, options_.executable.c_str(), &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(request[0]);
+    ::close(response[1]);
+
+    if (rc != 0) {
+        std::cerr << "[Sandbox Error] Could not start worker " << options_.executable << ": " << std::strerror(rc)
+                  << std::endl;
+        ::close(request[1]);
+        ::close(response[0]);
+        return false;
+    }
+    worker.pid = pid;
+    worker.requestFd = request[1];
+    worker.responseFd = response[0];
+    return true;
+}
+
+std::string ExtractionSandbox::reap(Worker& worker, bool kill) {
+    if (kill) ::kill(worker.pid, SIGKILL);
+    ::close(worker.requestFd);
+    ::close(worker.responseFd);
+    int status = 0;
+    while (::waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    worker = Worker();
+
+    std::ostringstream how;
+    if (WIFSIGNALED(status)) {
+        how << "killed by signal " << WTERMSIG(status);
+    } else {
+        how << "exited with status " << WEXITSTATUS(status);
+    }
+    return how.str();
+}
+
+ExtractionSandbox::Worker* ExtractionSandbox::acquire() {
+    Worker* worker = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        idleCv_.wait(lock, [&] { return !idle_.empty(); });
+        worker = idle_.back();
+        idle_.pop_back();
+    }
+    if (worker->pid <= 0 && !spawn(*worker)) {
+        release(worker);
+        return nullptr;
+    }
+    return worker;
+}
+
+void ExtractionSandbox::release(Worker* worker) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        idle_.push_back(worker);
+    }
+    idleCv_.notify_one();
+}
+
+bool ExtractionSandbox::extract(const std::string& pdfPath, const ExtractionLimits& limits,
+                                const PdfTextExtractor::ChunkConsumer& consumer, bool& truncated) {
+    truncated = false;
+    if (isQuarantined(pdfPath)) {
+        skipped_++;
+        std::cerr << "[Sandbox] Skipping quarantined " << pdfPath << std::endl;
+        return false;
+    }
+    Worker* worker = acquire();
+    if (!worker) return false;
+
+    // A reply larger than this comes from a corrupted worker, not from the document
+    const size_t maxFrame = limits.maxBytes > 0 ? limits.maxBytes + FRAME_SLACK
+                          : options_.memoryLimitBytes > 0 ? options_.memoryLimitBytes
+                                                          : std::numeric_limits<uint32_t>::max();
+    RequestHeader request{limits.maxPages, limits.maxBytes, static_cast<uint32_t>(pdfPath.size())};
+    auto sendRequest = [&] {
+        return writeAll(worker->requestFd, &request, sizeof(request)) &&
+               writeAll(worker->requestFd, pdfPath.data(), pdfPath.size());
+    };
+    bool sent = sendRequest();
+
+    // Only time spent waiting on the worker counts, not time spent in `consumer`
+    int64_t remainingMs = options_.timeoutMs;
+    bool opened = false;
+    bool answered = false; // Whether any frame about this document arrived
+    bool retried = false;
+    std::string failure;
+    std::string payload; // Reused across frames unless the consumer keeps it
+    while (true) {
+        if (!sent) {
+            std::string how = reap(*worker, false);
+            // A worker can die while idle (OOM killer, a stray signal); then this
+            // document never ran, so it gets one more try in a fresh worker
+            if (!answered && !retried) {
+                retried = true;
+                std::cerr << "[Sandbox] Worker " << how << " before answering for " << pdfPath << "; retrying."
+                          << std::endl;
+                if (!spawn(*worker)) {
+                    release(worker); // Not this document's fault
+                    return false;
+                }
+                sent = sendRequest();
+                if (sent) continue;
+                how = reap(*worker, false);
+            }
+            crashes_++;
+            failure = "worker " + how;
+            break;
+        }
+
+        FrameHeader header;
+        ReadStatus status = readTimed(worker->responseFd, &header, sizeof(header), remainingMs);
+        if (status == ReadStatus::OK && header.length > maxFrame) {
+            crashes_++;
+            reap(*worker, true);
+            failure = "sent a malformed reply";
+            break;
+        }
+        if (status == ReadStatus::OK) {
+            answered = true;
+            payload.resize(header.length);
+            status = readTimed(worker->responseFd, &payload[0], payload.size(), remainingMs);
+        }
+        if (status == ReadStatus::TIMEOUT) {
+            timeouts_++;
+            reap(*worker, true);
+            failure = "timed out after " + std::to_string(options_.timeoutMs) + " ms";
+            break;
+        }
+        if (status == ReadStatus::CLOSED) {
+            sent = false;
+            continue;
+        }
+
+        if (header.type == FRAME_PAGE && header.field <= FIELD_BODY) {
+            if (!consumer(std::move(payload), static_cast<TextField>(header.field))) {
+                // The rest of this document is unwanted; a fresh worker is cheaper than draining it
+                reap(*worker, true);
+                opened = true;
+                break;
+            }
+        } else if (header.type == FRAME_DONE) {
+            truncated = !payload.empty() && payload[0] != 0;
+            opened = true;
+            break;
+        } else if (header.type == FRAME_FAILED) {
+            break;
+        } else if (header.type == FRAME_ERROR) {
+            std::cerr << "[Extraction Error] " << pdfPath << ": " << payload << std::endl;
+            break;
+        } else {
+            // FRAME_OOM, or garbage: either way this worker is done
+            crashes_++;
+            reap(*worker, true);
+            failure = header.type == FRAME_OOM ? "exceeded the memory limit" : "sent a malformed reply";
+            break;
+        }
+    }
+
+    release(worker);
+    if (!failure.empty()) quarantine(pdfPath, failure);
+    return opened;
+}
+
+// --- Quarantine ---
+// One line per failure: size, mtime, reason and path, tab-separated (path last,
+// so it may itself contain tabs). The latest line for a path wins.
+
+void ExtractionSandbox::loadQuarantine() {
+    if (options_.quarantinePath.empty()) return;
+    std::ifstream in(options_.quarantinePath);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        DocumentStamp stamp;
+        std::string reason;
+        std::string path;
+        if (!(fields >> stamp.size >> stamp.mtime)) continue;
+        fields.get();
+        if (!std::getline(fields, reason, '\t') || !std::getline(fields, path) || path.empty()) continue;
+        quarantined_[path] = stamp;
+    }
+}
+
+bool ExtractionSandbox::isQuarantined(const std::string& pdfPath) const {
+    std::lock_guard<std::mutex> lock(quarantineMtx_);
+    auto it = quarantined_.find(pdfPath);
+    if (it == quarantined_.end()) return false;
+    // A file that changed since it failed gets another chance
+    DocumentStamp current;
+    return readDocumentStamp(pdfPath, current) && current == it->second;
+}
+
+size_t ExtractionSandbox::quarantineSize() const {
+    std::lock_guard<std::mutex> lock(quarantineMtx_);
+    return quarantined_.size();
+}
+
+void ExtractionSandbox::quarantine(const std::string& pdfPath, const std::string& reason) {
+    std::cerr << "[Sandbox] Quarantined " << pdfPath << ": " << reason << std::endl;
+    DocumentStamp stamp;
+    if (!readDocumentStamp(pdfPath, stamp)) return;
+
+    std::lock_guard<std::mutex> lock(quarantineMtx_);
+    quarantined_[pdfPath] = stamp;
+    if (options_.quarantinePath.empty()) return;
+
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(options_.quarantinePath).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+    std::ofstream out(options_.quarantinePath, std::ios::app);
+    out << stamp.size << '\t' << stamp.mtime << '\t' << reason << '\t' << pdfPath << '\n';
+    if (!out) {
+        std::cerr << "[Sandbox Error] Could not write " << options_.quarantinePath << std::endl;
+    }
+}
+
+// --- Worker process ---
+
+int ExtractionSandbox::runWorker(int argc, char* argv[]) {
+    size_t memoryLimit = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+    if (memoryLimit > 0) {
+        rlimit limit{static_cast<rlim_t>(memoryLimit), static_cast<rlim_t>(memoryLimit)};
+        ::setrlimit(RLIMIT_AS, &limit);
+    }
+    // Replies get a private descriptor; anything poppler prints goes to stderr
+    int replies = ::dup(STDOUT_FILENO);
+    ::dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    PdfTextExtractor extractor;
+    RequestHeader request;
+    while (readAll(STDIN_FILENO, &request, sizeof(request))) {
+        std::string path(request.pathLength, '\0');
+        if (!readAll(STDIN_FILENO, &path[0], path.size())) break;
+
+        ExtractionLimits limits;
+        limits.maxPages = static_cast<size_t>(request.maxPages);
+        limits.maxBytes = static_cast<size_t>(request.maxBytes);
+        extractor.setLimits(limits);
+
+        bool truncated = false;
+        bool delivered = true;
+        bool opened = false;
+        try {
+            opened = extractor.extractWithPoppler(path, [&](std::string&& chunk, TextField field) {
+                delivered = writeFrame(replies, FRAME_PAGE, chunk.data(), chunk.size(), field);
+                return delivered;
+            }, truncated);
+        } catch (const std::bad_alloc&) {
+            writeFrame(replies, FRAME_OOM, nullptr, 0);
+            return 1;
+        } catch (const std::exception& e) {
+            std::string message = e.what();
+            if (!writeFrame(replies, FRAME_ERROR, message.data(), message.size())) return 1;
+            continue;
+        } catch (...) {
+            if (!writeFrame(replies, FRAME_ERROR, "unknown exception", 17)) return 1;
+            continue;
+        }
+        if (!delivered) return 1;
+
+        char flag = truncated ? 1 : 0;
+        bool replied = opened ? writeFrame(replies, FRAME_DONE, &flag, 1) : writeFrame(replies, FRAME_FAILED, nullptr, 0);
+        if (!replied) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+#include "pdf_extractor.h"
+#include "index_reader.h"
+
+struct SandboxOptions {
+    unsigned workers = 0;                      // Worker processes (0 = one per hardware thread)
+    int timeoutMs = 60 * 1000;                 // Time one document may keep its worker busy
+    size_t memoryLimitBytes = 2048ull << 20;   // Address-space limit per worker (0 = none)
+    std::string quarantinePath;                // Failures are appended here; empty = not persisted
+    std::string executable;                    // Binary run as a worker (empty = this one; Linux only)
+};
+
+/**
+ * @brief Runs poppler in separate worker processes, so a PDF that hangs or
+ * crashes it costs one worker instead of the whole run.
+ *
+ * Workers are this same executable started with WORKER_FLAG (main() hands
+ * them to runWorker). They are spawned up front and reused; each takes one
+ * path at a time over a pipe and streams the pages back as they are
+ * extracted. A worker that exceeds the timeout is killed; one that dies or
+ * hits its memory limit is replaced. Either way the document is quarantined:
+ * recorded with its size and mtime, and skipped without being opened until
+ * the file changes. A worker found dead before it answered anything about a
+ * document may have died while idle, so the document is retried once in a
+ * fresh worker before it is blamed. All methods are safe to call from several extraction
+ * threads at once, but a thread blocks until a worker is free, so there must
+ * be at least as many workers as threads (ExtractionPipeline::setSandbox
+ * enforces this).
+ */
+class ExtractionSandbox {
+public:
+    static constexpr const char* WORKER_FLAG = "--extraction-worker";
+
+    explicit ExtractionSandbox(const SandboxOptions& options = SandboxOptions());
+    ~ExtractionSandbox();
+
+    ExtractionSandbox(const ExtractionSandbox&) = delete;
+    ExtractionSandbox& operator=(const ExtractionSandbox&) = delete;
+
+    /**
+     * @brief Extracts `pdfPath` in a worker, with the same contract as
+     * PdfTextExtractor's in-process extraction. Returns false if the file could
+     * not be opened, is quarantined, or made its worker fail.
+     */
+    bool extract(const std::string& pdfPath, const ExtractionLimits& limits,
+                 const PdfTextExtractor::ChunkConsumer& consumer, bool& truncated);
+
+    bool isQuarantined(const std::string& pdfPath) const;
+
+    // Worker process entry point: serves requests on stdin until it is closed.
+    static int runWorker(int argc, char* argv[]);
+
+    unsigned workerCount() const { return static_cast<unsigned>(workers_.size()); }
+    size_t timeouts() const { return timeouts_.load(); }
+    size_t crashes() const { return crashes_.load(); }
+    size_t skipped() const { return skipped_.load(); }   // Quarantined files not opened
+    size_t quarantineSize() const;
+
+private:
+    struct Worker;
+
+    // Takes an idle worker, starting a replacement if it is dead.
+    Worker* acquire();
+    void release(Worker* worker);
+    bool spawn(Worker& worker);
+    // Kills (if needed) and reaps the worker; returns a description of how it ended.
+    std::string reap(Worker& worker, bool kill);
+    void quarantine(const std::string& pdfPath, const std::string& reason);
+    void loadQuarantine();
+
+    SandboxOptions options_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<Worker*> idle_;
+    std::mutex mtx_;
+    std::condition_variable idleCv_;
+
+    mutable std::mutex quarantineMtx_;
+    std::unordered_map<std::string, DocumentStamp> quarantined_;
+
+    std::atomic<size_t> timeouts_{0};
+    std::atomic<size_t> crashes_{0};
+    std::atomic<size_t> skipped_{0};
+};
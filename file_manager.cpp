@@ -1,22 +1,35 @@
 #include "file_manager.h"
+#include "profiler.h"
 
-std::vector<std::string> FileSystemManager::findPdfs(const std::string& rootPath) const {
-    std::vector<std::string> pdfPaths;
+#include <algorithm>
 
+FileSystemManager::FileSystemManager(const CrawlOptions& options) : options_(options) {}
+
+bool FileSystemManager::forEachPdf(const std::string& rootPath,
+                                   const std::function<void(const std::string&)>& onPdf) const {
     if (!fs::exists(rootPath)) {
         std::cerr << "[Error] Directory not found: " << rootPath << std::endl;
-        return pdfPaths;
+        return false;
     }
 
-    try {
-        for (const auto& entry : fs::recursive_directory_iterator(rootPath)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".pdf") {
-                pdfPaths.push_back(entry.path().string());
-            }
-        }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "[Filesystem Error] Accessing " << rootPath << ": " << e.what() << std::endl;
+    ProfileScope scope("crawl");
+    DirectoryCrawler crawler(options_);
+    bool crawled = crawler.crawl(rootPath, onPdf);
+    scope.addItems(crawler.stats().pdfs);
+    if (!crawled) {
+        std::cerr << "[Filesystem Error] Accessing " << rootPath << ": not a readable directory" << std::endl;
+        return false;
     }
+    return true;
+}
 
+std::vector<std::string> FileSystemManager::findPdfs(const std::string& rootPath) const {
+    std::vector<std::string> pdfPaths;
+    forEachPdf(rootPath, [&](const std::string& path) { pdfPaths.push_back(path); });
+    std::sort(pdfPaths.begin(), pdfPaths.end());
     return pdfPaths;
 }
+
+bool FileSystemManager::isExcluded(const std::string& rootPath, const std::string& path) const {
+    return DirectoryCrawler(options_).isExcluded(rootPath, path);
+}
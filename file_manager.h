@@ -1,13 +1,30 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <functional>
 #include <filesystem>
 #include <iostream>
 
+#include "directory_crawler.h"
+
 namespace fs = std::filesystem;
 
 class FileSystemManager {
 public:
-    // Mark const if implementation is const
+    explicit FileSystemManager(const CrawlOptions& options = CrawlOptions());
+
+    // All PDFs at or below `directory`, sorted (the crawl itself finds them in no fixed order).
     std::vector<std::string> findPdfs(const std::string& directory) const;
+
+    // Streams each PDF to `onPdf` as soon as it is found (one call at a time, from crawler threads).
+    // Returns false if `directory` does not exist.
+    bool forEachPdf(const std::string& directory, const std::function<void(const std::string&)>& onPdf) const;
+
+    // Whether the exclusion globs drop `path` (at or below `rootPath`).
+    bool isExcluded(const std::string& rootPath, const std::string& path) const;
+
+    const CrawlOptions& options() const { return options_; }
+
+private:
+    CrawlOptions options_;
 };
@@ -0,0 +1,226 @@
+#include "http_fetcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <curl/curl.h>
+
+namespace {
+
+// curl_global_init is not thread-safe and must run once per process, before
+// any other curl call; it is never undone while fetchers may still exist.
+void ensureCurlInitialized() {
+    static std::once_flag once;
+    std::call_once(once, [] { curl_global_init(CURL_GLOBAL_ALL); });
+}
+
+size_t appendBody(void* contents, size_t size, size_t nmemb, void* userp) {
+    static_cast<HttpResponse*>(userp)->body.append(static_cast<char*>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+size_t streamBody(void* contents, size_t size, size_t nmemb, void* userp) {
+    static_cast<const HttpRequest*>(userp)->onBody(static_cast<const char*>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+// Records the validators; a redirect starts a new header block, so those reset on each status line
+size_t readHeader(char* buffer, size_t size, size_t nitems, void* userp) {
+    HttpResponse* response = static_cast<HttpResponse*>(userp);
+    const size_t length = size * nitems;
+    std::string line(buffer, length);
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) line.pop_back();
+
+    if (line.compare(0, 5, "HTTP/") == 0) {
+        response->etag.clear();
+        response->lastModified.clear();
+        return length;
+    }
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) return length;
+    std::string name = line.substr(0, colon);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+    std::string value = valueStart == std::string::npos ? "" : line.substr(valueStart);
+    if (name == "etag") {
+        response->etag = value;
+    } else if (name == "last-modified") {
+        response->lastModified = value;
+    }
+    return length;
+}
+
+struct Transfer {
+    size_t index = 0;
+    CURL* handle = nullptr;       // Set while the transfer is in the multi handle
+    curl_slist* headers = nullptr;
+    std::chrono::steady_clock::time_point start;
+};
+
+} // namespace
+
+HttpFetcher::HttpFetcher(size_t maxConcurrent)
+    : maxConcurrent_(std::max<size_t>(1, maxConcurrent)) {
+    ensureCurlInitialized();
+    multi_ = curl_multi_init();
+    curl_multi_setopt(static_cast<CURLM*>(multi_), CURLMOPT_MAXCONNECTS, static_cast<long>(maxConcurrent_ * 2));
+
+    CURLSH* share = curl_share_init();
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    share_ = share;
+}
+
+HttpFetcher::~HttpFetcher() {
+    for (void* handle : idle_) curl_easy_cleanup(static_cast<CURL*>(handle));
+    if (multi_) curl_multi_cleanup(static_cast<CURLM*>(multi_));
+    if (share_) curl_share_cleanup(static_cast<CURLSH*>(share_));
+    if (headers_) curl_slist_free_all(static_cast<curl_slist*>(headers_));
+}
+
+void HttpFetcher::addHeader(const std::string& header) {
+    headers_ = curl_slist_append(static_cast<curl_slist*>(headers_), header.c_str());
+}
+
+std::string HttpFetcher::escape(const std::string& value) {
+    ensureCurlInitialized();
+    std::string encoded;
+    char* escaped = curl_easy_escape(nullptr, value.c_str(), static_cast<int>(value.length()));
+    if (escaped) {
+        encoded = escaped;
+        curl_free(escaped);
+    }
+    return encoded;
+}
+
+void* HttpFetcher::takeHandle() {
+    if (idle_.empty()) {
+        CURL* handle = curl_easy_init();
+        if (handle) curl_easy_setopt(handle, CURLOPT_SHARE, static_cast<CURLSH*>(share_));
+        return handle;
+    }
+    void* handle = idle_.back();
+    idle_.pop_back();
+    return handle;
+}
+
+void* HttpFetcher::configure(void* handle, const HttpRequest& request, HttpResponse* response) {
+    CURL* curl = static_cast<CURL*>(handle);
+    curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+    if (!userAgent_.empty()) curl_easy_setopt(curl, CURLOPT_USERAGENT, userAgent_.c_str());
+
+    // Shared headers plus this request's own
+    curl_slist* headers = nullptr;
+    for (curl_slist* item = static_cast<curl_slist*>(headers_); item; item = item->next) {
+        headers = curl_slist_append(headers, item->data);
+    }
+    for (const auto& header : request.headers) headers = curl_slist_append(headers, header.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+
+    if (request.onBody) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, streamBody);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, const_cast<HttpRequest*>(&request));
+    } else {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, appendBody);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+    }
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, readHeader);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, response);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, ""); // Any encoding curl can decode
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeoutMs_);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    return headers;
+}
+
+std::vector<HttpResponse> HttpFetcher::fetchAll(const std::vector<std::string>& urls) {
+    std::vector<HttpRequest> requests;
+    requests.reserve(urls.size());
+    for (const auto& url : urls) requests.push_back(HttpRequest{url, {}, nullptr});
+    return fetchAll(requests);
+}
+
+std::vector<HttpResponse> HttpFetcher::fetchAll(const std::vector<HttpRequest>& requests) {
+    const size_t count = requests.size();
+    std::vector<HttpResponse> responses(count);
+    std::vector<Transfer> transfers(count);
+    CURLM* multi = static_cast<CURLM*>(multi_);
+    size_t next = 0;
+    size_t active = 0;
+
+    while (next < count || active > 0) {
+        // Top up to the concurrency limit
+        while (active < maxConcurrent_ && next < count) {
+            void* handle = takeHandle();
+            if (!handle) {
+                responses[next].error = "could not create a curl handle";
+                next++;
+                continue;
+            }
+            curl_slist* headers = static_cast<curl_slist*>(configure(handle, requests[next], &responses[next]));
+            transfers[next] = Transfer{next, static_cast<CURL*>(handle), headers, std::chrono::steady_clock::now()};
+            curl_easy_setopt(static_cast<CURL*>(handle), CURLOPT_PRIVATE, &transfers[next]);
+            curl_multi_add_handle(multi, static_cast<CURL*>(handle));
+            next++;
+            active++;
+        }
+
+        int running = 0;
+        CURLMcode code = curl_multi_perform(multi, &running);
+        if (code != CURLM_OK) {
+            std::cerr << "[HTTP Error] " << curl_multi_strerror(code) << std::endl;
+            break;
+        }
+
+        // Collect finished transfers; their handles go back to the idle pool
+        int queued = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi, &queued)) {
+            if (message->msg != CURLMSG_DONE) continue;
+            CURL* handle = message->easy_handle;
+            Transfer* transfer = nullptr;
+            curl_easy_getinfo(handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&transfer));
+            HttpResponse& response = responses[transfer->index];
+            if (message->data.result == CURLE_OK) {
+                curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &response.status);
+            } else {
+                response.error = curl_easy_strerror(message->data.result);
+                response.body.clear();
+            }
+            response.milliseconds =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - transfer->start).count();
+            curl_multi_remove_handle(multi, handle);
+            idle_.push_back(handle);
+            transfer->handle = nullptr;
+            curl_slist_free_all(transfer->headers);
+            transfer->headers = nullptr;
+            active--;
+        }
+
+        if (running > 0) {
+#if LIBCURL_VERSION_NUM >= 0x074200
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+#else
+            curl_multi_wait(multi, nullptr, 0, 1000, nullptr);
+#endif
+        }
+    }
+
+    // Only left early on a multi error: detach whatever is still in flight
+    for (size_t i = 0; i < count; ++i) {
+        if (transfers[i].handle) {
+            curl_multi_remove_handle(multi, transfers[i].handle);
+            idle_.push_back(transfers[i].handle);
+            curl_slist_free_all(transfers[i].headers);
+        }
+        if (i >= next || transfers[i].handle) {
+            responses[i].body.clear();
+            responses[i].error = "transfer aborted";
+        }
+    }
+    return responses;
+}
+
+HttpResponse HttpFetcher::fetch(const std::string& url) {
+    return fetchAll(std::vector<std::string>{url})[0];
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+struct HttpRequest {
+    std::string url;
+    std::vector<std::string> headers; // Extra "Name: value" lines for this request only
+    // If set, receives the body as it arrives instead of HttpResponse::body
+    std::function<void(const char* data, size_t size)> onBody;
+};
+
+struct HttpResponse {
+    long status = 0;           // HTTP status, 0 if the transfer failed
+    std::string body;
+    std::string error;         // curl's message when the transfer failed
+    double milliseconds = 0.0; // Wall time of this transfer
+    std::string etag;          // Validators of the final response, empty if absent
+    std::string lastModified;
+
+    bool ok() const { return error.empty() && status >= 200 && status < 300; }
+};
+
+/**
+ * @brief Fetches URLs concurrently over one long-lived curl multi handle.
+ *
+ * Connections, resolved addresses and TLS sessions are kept between calls
+ * (the multi handle owns the connection pool, a share handle holds the DNS
+ * and TLS session caches), so repeated requests to the same host skip the
+ * TCP and TLS handshakes. Finished easy handles are recycled as well.
+ *
+ * One fetcher must only be used by one thread at a time.
+ */
+class HttpFetcher {
+public:
+    // @param maxConcurrent Transfers in flight at once (at least 1).
+    explicit HttpFetcher(size_t maxConcurrent = 4);
+    ~HttpFetcher();
+    HttpFetcher(const HttpFetcher&) = delete;
+    HttpFetcher& operator=(const HttpFetcher&) = delete;
+
+    // Fetches every URL, at most maxConcurrent at a time. Responses are in input order.
+    std::vector<HttpResponse> fetchAll(const std::vector<std::string>& urls);
+    std::vector<HttpResponse> fetchAll(const std::vector<HttpRequest>& requests);
+    HttpResponse fetch(const std::string& url);
+
+    void setUserAgent(const std::string& userAgent) { userAgent_ = userAgent; }
+    void addHeader(const std::string& header);
+    void setTimeoutMs(long timeoutMs) { timeoutMs_ = timeoutMs; }
+
+    size_t maxConcurrent() const { return maxConcurrent_; }
+
+    // Percent-encodes `value` for use in a query string.
+    static std::string escape(const std::string& value);
+
+private:
+    void* takeHandle();
+    // Sets up `handle` for `request`; returns the header list to free once it is done.
+    void* configure(void* handle, const HttpRequest& request, HttpResponse* response);
+
+    size_t maxConcurrent_;
+    std::string userAgent_;
+    long timeoutMs_ = 30000;
+    void* multi_ = nullptr;     // CURLM*
+    void* share_ = nullptr;     // CURLSH*
+    void* headers_ = nullptr;   // curl_slist*
+    std::vector<void*> idle_;   // Finished CURL* handles, ready for reuse
+};
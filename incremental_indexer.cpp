@@ -0,0 +1,267 @@
+#include "incremental_indexer.h"
+#include "relevance_scorer.h"
+#include "index_file.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <unordered_map>
+
+namespace {
+
+void accumulate(ReconcileStats& total, const ReconcileStats& part) {
+    total.added += part.added;
+    total.updated += part.updated;
+    total.removed += part.removed;
+    total.unchanged += part.unchanged;
+}
+
+} // namespace
+
+IncrementalIndexer::IncrementalIndexer(const RelevanceScorer& scorer, const ExtractionPipeline& pipeline)
+    : scorer_(scorer), pipeline_(pipeline) {}
+
+bool IncrementalIndexer::load(const std::string& indexPath) {
+    if (readIndexFile(indexPath, index_)) return true;
+    index_ = InvertedIndex();
+    return false;
+}
+
+bool IncrementalIndexer::save(const std::string& indexPath) const {
+    return writeIndexFile(index_, indexPath);
+}
+
+ReconcileStats IncrementalIndexer::reconcile(const std::vector<std::string>& pdfPaths) {
+    return reconcileScope("", pdfPaths);
+}
+
+ReconcileStats IncrementalIndexer::rescan(const std::string& rootPath) {
+    return rescanScope(rootPath, rootPath);
+}
+
+ReconcileStats IncrementalIndexer::reconcileScope(const std::string& directory, const std::vector<std::string>& pdfPaths) {
+    ReconcileStats stats;
+    std::unordered_set<std::string> present(pdfPaths.begin(), pdfPaths.end());
+    const std::string prefix = directory.empty() ? "" : directory + "/";
+
+    // 1. Forget files that are gone
+    for (const auto& path : index_.filePaths()) {
+        bool inScope = prefix.empty() || path.compare(0, prefix.size(), prefix) == 0;
+        if (inScope && !present.count(path)) {
+            index_.removeFile(path);
+            stats.removed++;
+        }
+    }
+
+    // 2. Re-extract only new and modified files
+    std::vector<std::string> toExtract;
+    std::vector<DocumentStamp> stamps;
+    for (const auto& path : pdfPaths) {
+        DocumentStamp current;
+        if (!readDocumentStamp(path, current)) continue;
+        DocumentStamp known;
+        if (index_.findFile(path, known)) {
+            if (known == current) {
+                stats.unchanged++;
+                continue;
+            }
+            stats.updated++;
+        } else {
+            stats.added++;
+        }
+        toExtract.push_back(path);
+        stamps.push_back(current);
+    }
+    reindex(toExtract, stamps);
+    return stats;
+}
+
+ReconcileStats IncrementalIndexer::rescanScope(const std::string& directory, const std::string& rootPath) {
+    ReconcileStats stats;
+    const std::string prefix = directory == rootPath ? "" : directory + "/";
+    auto inScope = [&](const std::string& path) {
+        return prefix.empty() || path.compare(0, prefix.size(), prefix) == 0;
+    };
+
+    // Extraction changes index_ while the crawl runs, so the crawl compares against a snapshot
+    std::unordered_map<std::string, DocumentStamp> known;
+    for (const auto& path : index_.filePaths()) {
+        DocumentStamp stamp;
+        if (inScope(path) && index_.findFile(path, stamp)) known.emplace(path, stamp);
+    }
+
+    // 1. Crawl on another thread, queueing new and modified files as they turn up
+    std::mutex mtx;
+    std::unordered_set<std::string> present;
+    std::unordered_map<std::string, DocumentStamp> stampOf;
+    ExtractionPipeline::PathQueue toExtract;
+    std::thread crawl([&]() {
+        fileSystem_.forEachPdf(directory, [&](const std::string& path) {
+            // Path globs are relative to the watched root, not to this subdirectory
+            if (!prefix.empty() && fileSystem_.isExcluded(rootPath, path)) return;
+            DocumentStamp current;
+            bool stamped = readDocumentStamp(path, current);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                present.insert(path);
+                if (!stamped) return;
+                auto it = known.find(path);
+                if (it != known.end() && it->second == current) {
+                    stats.unchanged++;
+                    return;
+                }
+                if (it != known.end()) {
+                    stats.updated++;
+                } else {
+                    stats.added++;
+                }
+                stampOf[path] = current;
+            }
+            toExtract.push(path);
+        });
+        toExtract.close();
+    });
+
+    // 2. Extract them here meanwhile
+    try {
+        reindex(toExtract, [&](const std::string& path) {
+            std::lock_guard<std::mutex> lock(mtx);
+            return stampOf[path];
+        });
+    } catch (...) {
+        crawl.join();
+        throw;
+    }
+    crawl.join();
+
+    // 3. Forget files the crawl did not find
+    for (const auto& path : index_.filePaths()) {
+        if (inScope(path) && !present.count(path)) {
+            index_.removeFile(path);
+            stats.removed++;
+        }
+    }
+    return stats;
+}
+
+ReconcileStats IncrementalIndexer::apply(const std::vector<WatchEvent>& events, const std::string& rootPath) {
+    ReconcileStats stats;
+
+    // Changed files are extracted together (in parallel) at the end, or earlier
+    // if a directory event could affect them
+    std::vector<std::string> pending;
+    std::vector<DocumentStamp> pendingStamps;
+    auto flushPending = [&]() {
+        reindex(pending, pendingStamps);
+        pending.clear();
+        pendingStamps.clear();
+    };
+
+    for (const auto& event : events) {
+        if (event.kind != WatchEvent::Overflow && fileSystem_.isExcluded(rootPath, event.path)) continue;
+        switch (event.kind) {
+        case WatchEvent::Overflow:
+            // Individual events were lost: fall back to a full reconcile
+            flushPending();
+            accumulate(stats, rescan(rootPath));
+            break;
+
+        case WatchEvent::FileChanged: {
+            DocumentStamp current;
+            DocumentStamp known;
+            if (!readDocumentStamp(event.path, current)) {
+                // Already gone again
+                if (index_.removeFile(event.path)) stats.removed++;
+                break;
+            }
+            bool isKnown = index_.findFile(event.path, known);
+            if (isKnown && known == current) {
+                stats.unchanged++;
+                break;
+            }
+            if (isKnown) {
+                stats.updated++;
+            } else {
+                stats.added++;
+            }
+            pending.push_back(event.path);
+            pendingStamps.push_back(current);
+            break;
+        }
+
+        case WatchEvent::FileRemoved:
+            if (index_.removeFile(event.path)) stats.removed++;
+            break;
+
+        case WatchEvent::DirectoryAdded:
+        case WatchEvent::DirectoryRemoved: {
+            flushPending();
+            std::error_code ec;
+            if (std::filesystem::is_directory(event.path, ec)) {
+                accumulate(stats, rescanScope(event.path, rootPath));
+            } else {
+                accumulate(stats, reconcileScope(event.path, {}));
+            }
+            break;
+        }
+        }
+    }
+    flushPending();
+    return stats;
+}
+
+void IncrementalIndexer::reindex(const std::vector<std::string>& paths, const std::vector<DocumentStamp>& stamps) {
+    if (paths.empty()) return;
+    std::unordered_map<std::string, DocumentStamp> stampOf;
+    ExtractionPipeline::PathQueue queue;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        stampOf[paths[i]] = stamps[i];
+        queue.push(paths[i]);
+    }
+    queue.close();
+    reindex(queue, [&](const std::string& path) { return stampOf[path]; });
+}
+
+void IncrementalIndexer::reindex(ExtractionPipeline::PathQueue& paths,
+                                 const std::function<DocumentStamp(const std::string& path)>& stampOf) {
+    ProfileScope scope("reindex");
+
+    // Pages are tokenized as they arrive, so no document is ever held whole
+    class Indexer : public ExtractionPipeline::PageConsumer {
+    public:
+        Indexer(const RelevanceScorer& scorer, InvertedIndex& index,
+                const std::function<DocumentStamp(const std::string& path)>& stampOf)
+            : scorer_(scorer), index_(index), stampOf_(stampOf) {}
+
+        void beginDocument(const std::string&) override {
+            index_.beginDocument();
+            position_ = 0;
+        }
+        void page(const std::string&, std::string_view text, TextField field) override {
+            position_ = scorer_.indexText(index_, text, position_, field);
+        }
+        void endDocument(const std::string& path, bool extracted) override {
+            const DocumentStamp stamp = stampOf_(path);
+            if (extracted) {
+                index_.endDocument(path, stamp);
+            } else {
+                index_.beginDocument(); // Drops any partial tokens
+                index_.addSkippedFile(path, stamp);
+            }
+            documents_++;
+        }
+        size_t documents() const { return documents_; }
+
+    private:
+        const RelevanceScorer& scorer_;
+        InvertedIndex& index_;
+        const std::function<DocumentStamp(const std::string& path)>& stampOf_;
+        uint32_t position_ = 0;
+        size_t documents_ = 0;
+    } indexer(scorer_, index_, stampOf);
+    pipeline_.runPages(paths, indexer);
+    scope.addItems(indexer.documents());
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+#include "inverted_index.h"
+#include "directory_watcher.h"
+#include "file_manager.h"
+#include "extraction_pipeline.h"
+
+class RelevanceScorer;
+
+struct ReconcileStats {
+    size_t added = 0;
+    size_t updated = 0;
+    size_t removed = 0;
+    size_t unchanged = 0;
+
+    bool changed() const { return added + updated + removed > 0; }
+};
+
+/**
+ * @brief Keeps an InvertedIndex in sync with the PDFs on disk.
+ *
+ * Only new or modified files are extracted and tokenized; removed files just
+ * drop their postings. Document frequencies, the document count and lengths
+ * all follow from the postings, so scores stay exactly what a full rebuild
+ * would produce.
+ */
+class IncrementalIndexer {
+public:
+    IncrementalIndexer(const RelevanceScorer& scorer, const ExtractionPipeline& pipeline);
+
+    // Loads the last saved state. Returns false (leaving an empty index) if there is none.
+    bool load(const std::string& indexPath);
+    bool save(const std::string& indexPath) const;
+
+    // Brings the index in line with exactly `pdfPaths` (e.g. a fresh findPdfs walk).
+    ReconcileStats reconcile(const std::vector<std::string>& pdfPaths);
+
+    // Like reconcile(fileSystem.findPdfs(rootPath)), but extracts each file as the crawl finds it.
+    ReconcileStats rescan(const std::string& rootPath);
+
+    // Applies watcher events. `rootPath` is rescanned in full after a queue overflow.
+    ReconcileStats apply(const std::vector<WatchEvent>& events, const std::string& rootPath);
+
+    // Crawl settings for the rescans apply() does; excluded paths are ignored in events too.
+    void setCrawlOptions(const CrawlOptions& options) { fileSystem_ = FileSystemManager(options); }
+
+    const InvertedIndex& index() const { return index_; }
+
+private:
+    // Reconciles the files at or below `directory` against `pdfPaths` found there.
+    ReconcileStats reconcileScope(const std::string& directory, const std::vector<std::string>& pdfPaths);
+    // Reconciles the files at or below `directory` (inside `rootPath`) while crawling it.
+    ReconcileStats rescanScope(const std::string& directory, const std::string& rootPath);
+    // Re-extracts `paths` (stamped just before extraction) and replaces their entries.
+    void reindex(const std::vector<std::string>& paths, const std::vector<DocumentStamp>& stamps);
+    // Same, for paths still being pushed; `stampOf` is asked once per path, on this thread.
+    void reindex(ExtractionPipeline::PathQueue& paths,
+                 const std::function<DocumentStamp(const std::string& path)>& stampOf);
+
+    const RelevanceScorer& scorer_;
+    const ExtractionPipeline& pipeline_;
+    FileSystemManager fileSystem_;
+    InvertedIndex index_;
+};
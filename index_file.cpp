@@ -0,0 +1,418 @@
+#include "index_file.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char INDEX_MAGIC[8] = {'P', 'D', 'F', 'O', 'R', 'G', 'I', 'X'};
+
+uint64_t alignUp(uint64_t value) {
+    return (value + 7) & ~uint64_t(7);
+}
+
+void writePadding(std::ofstream& out, uint64_t written) {
+    static const char zeros[8] = {0};
+    out.write(zeros, static_cast<std::streamsize>(alignUp(written) - written));
+}
+
+// Unique per process and per call, so concurrent saves never share a temp file
+std::string tempPathFor(const std::string& path) {
+    static std::atomic<uint64_t> counter{0};
+    return path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter.fetch_add(1));
+}
+
+} // namespace
+
+// --- Writer ---
+
+bool writeIndexFile(const InvertedIndex& index, const std::string& path) {
+    ProfileScope scope("index save");
+    // Gather and sort the dictionary so readers can binary-search it
+    std::vector<std::pair<std::string_view, PostingList>> terms;
+    terms.reserve(index.termCount());
+    index.forEachTerm([&](std::string_view term, PostingList postings) {
+        terms.emplace_back(term, postings);
+    });
+    std::sort(terms.begin(), terms.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // Lay out the string pool and the fixed-size tables
+    std::string strings;
+    std::vector<IndexDocEntry> docEntries;
+    docEntries.reserve(index.documentCount() + index.skippedFiles().size());
+    auto addDoc = [&](std::string_view docPath, uint32_t length, const DocumentStamp& stamp) {
+        IndexDocEntry entry;
+        entry.pathOffset = strings.size();
+        entry.pathLength = static_cast<uint32_t>(docPath.size());
+        entry.length = length;
+        entry.size = stamp.size;
+        entry.mtime = stamp.mtime;
+        strings.append(docPath.data(), docPath.size());
+        docEntries.push_back(entry);
+    };
+    for (uint32_t docId = 0; docId < index.documentCount(); ++docId) {
+        addDoc(index.documentPath(docId), index.documentLength(docId), index.documentStamp(docId));
+    }
+    for (const auto& skipped : index.skippedFiles()) {
+        addDoc(skipped.first, 0, skipped.second);
+    }
+
+    const DocumentStats* docStats = index.documentStats();
+    const CorpusStats totals = index.corpusStats();
+
+    std::vector<IndexTermEntry> termEntries;
+    termEntries.reserve(terms.size());
+    uint64_t postingCount = 0;
+    uint64_t positionCount = 0;
+    for (const auto& term : terms) {
+        IndexTermEntry entry;
+        entry.termOffset = strings.size();
+        entry.termLength = static_cast<uint32_t>(term.first.size());
+        entry.postingCount = static_cast<uint32_t>(term.second.size());
+        entry.firstPosting = postingCount;
+        // Recomputed here, so bounds loosened by removals are tight again on disk
+        entry.maxTfWeight = 0.0;
+        entry.maxNorm = 0.0;
+        entry.maxTf = 0;
+        entry.maxTitleTf = 0;
+        for (size_t i = 0; i < term.second.size(); ++i) {
+            const Posting& posting = term.second.data[i];
+            const uint32_t length = docStats[posting.docId].length;
+            entry.maxTfWeight = std::max(entry.maxTfWeight, postingTfWeight(posting.tf, length));
+            entry.maxNorm = std::max(entry.maxNorm, documentNorm(length));
+            entry.maxTf = std::max(entry.maxTf, posting.tf);
+            entry.maxTitleTf = std::max(entry.maxTitleTf, term.second.fields[i].title);
+            positionCount += posting.tf;
+        }
+        strings.append(term.first.data(), term.first.size());
+        postingCount += term.second.size();
+        termEntries.push_back(entry);
+    }
+
+    IndexFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_FILE_VERSION;
+    header.headerSize = sizeof(IndexFileHeader);
+    header.docCount = index.documentCount();
+    header.skippedCount = index.skippedFiles().size();
+    header.termCount = termEntries.size();
+    header.postingCount = postingCount;
+    header.positionCount = positionCount;
+    header.stringsSize = strings.size();
+    header.totalLength = totals.length;
+    header.totalTitleLength = totals.titleLength;
+    header.totalFirstPageLength = totals.firstPageLength;
+    header.docTableOffset = alignUp(sizeof(IndexFileHeader));
+    header.docStatsOffset = alignUp(header.docTableOffset + docEntries.size() * sizeof(IndexDocEntry));
+    header.signaturesOffset = alignUp(header.docStatsOffset + header.docCount * sizeof(DocumentStats));
+    header.termTableOffset = alignUp(header.signaturesOffset + header.docCount * sizeof(MinHashSignature));
+    header.postingsOffset = alignUp(header.termTableOffset + termEntries.size() * sizeof(IndexTermEntry));
+    header.fieldTfsOffset = alignUp(header.postingsOffset + postingCount * sizeof(Posting));
+    header.positionStartsOffset = alignUp(header.fieldTfsOffset + postingCount * sizeof(FieldTf));
+    header.positionsOffset = header.positionStartsOffset + postingCount * sizeof(uint64_t);
+    header.stringsOffset = alignUp(header.positionsOffset + positionCount * sizeof(uint32_t));
+    header.fileSize = header.stringsOffset + strings.size();
+
+    std::error_code ec;
+    fs::path target(path);
+    if (target.has_parent_path()) fs::create_directories(target.parent_path(), ec);
+    const std::string tmpPath = tempPathFor(path);
+    // Nothing may leave the temp file behind, not even an exception (e.g. bad_alloc) midway
+    try {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[Index Error] Could not create " << tmpPath << std::endl;
+            fs::remove(tmpPath, ec);
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writePadding(out, sizeof(header));
+        out.write(reinterpret_cast<const char*>(docEntries.data()), docEntries.size() * sizeof(IndexDocEntry));
+        writePadding(out, docEntries.size() * sizeof(IndexDocEntry));
+        out.write(reinterpret_cast<const char*>(docStats), header.docCount * sizeof(DocumentStats));
+        writePadding(out, header.docCount * sizeof(DocumentStats));
+        out.write(reinterpret_cast<const char*>(index.documentSignatures()), header.docCount * sizeof(MinHashSignature));
+        writePadding(out, header.docCount * sizeof(MinHashSignature));
+        out.write(reinterpret_cast<const char*>(termEntries.data()), termEntries.size() * sizeof(IndexTermEntry));
+        writePadding(out, termEntries.size() * sizeof(IndexTermEntry));
+        for (const auto& term : terms) {
+            out.write(reinterpret_cast<const char*>(term.second.data), term.second.size() * sizeof(Posting));
+        }
+        writePadding(out, postingCount * sizeof(Posting));
+        for (const auto& term : terms) {
+            out.write(reinterpret_cast<const char*>(term.second.fields), term.second.size() * sizeof(FieldTf));
+        }
+        writePadding(out, postingCount * sizeof(FieldTf));
+        // A posting has exactly tf positions, so the starts are a running sum
+        uint64_t positionStart = 0;
+        for (const auto& term : terms) {
+            for (const Posting& posting : term.second) {
+                out.write(reinterpret_cast<const char*>(&positionStart), sizeof(positionStart));
+                positionStart += posting.tf;
+            }
+        }
+        for (const auto& term : terms) {
+            for (const Posting& posting : term.second) {
+                PositionList positions = index.positions(term.first, posting.docId);
+                out.write(reinterpret_cast<const char*>(positions.data), positions.size() * sizeof(uint32_t));
+            }
+        }
+        writePadding(out, positionCount * sizeof(uint32_t));
+        out.write(strings.data(), strings.size());
+        // Closing flushes, which can fail too (e.g. on a full disk)
+        out.close();
+        if (!out) {
+            std::cerr << "[Index Error] Could not write " << tmpPath << std::endl;
+            fs::remove(tmpPath, ec);
+            return false;
+        }
+    } catch (...) {
+        fs::remove(tmpPath, ec);
+        throw;
+    }
+    fs::rename(tmpPath, path, ec);
+    if (ec) {
+        std::cerr << "[Index Error] Could not replace " << path << ": " << ec.message() << std::endl;
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool readIndexFile(const std::string& path, InvertedIndex& index) {
+    ProfileScope scope("index load");
+    MappedIndex mapped;
+    if (!mapped.open(path)) return false;
+
+    index = InvertedIndex();
+    for (uint32_t docId = 0; docId < mapped.documentCount(); ++docId) {
+        index.restoreDocument(std::string(mapped.documentPath(docId)), mapped.documentStats()[docId],
+                              mapped.documentSignatures()[docId], mapped.documentStamp(docId));
+    }
+    bool valid = true;
+    std::vector<PositionList> positions;
+    mapped.forEachTerm([&](std::string_view term, PostingList postings) {
+        positions.clear();
+        for (const Posting& posting : postings) {
+            if (posting.docId >= mapped.documentCount()) valid = false;
+            positions.push_back(mapped.positionsOf(&posting));
+            if (positions.back().size() != posting.tf) valid = false;
+        }
+        if (valid) index.restorePostings(term, postings, positions.data());
+    });
+    if (!valid) {
+        std::cerr << "[Index Error] " << path << " has postings for unknown documents, rebuilding." << std::endl;
+        index = InvertedIndex();
+        return false;
+    }
+    for (size_t i = 0; i < mapped.skippedCount(); ++i) {
+        index.addSkippedFile(std::string(mapped.skippedPath(i)), mapped.skippedStamp(i));
+    }
+    return true;
+}
+
+// --- Reader ---
+
+MappedIndex::~MappedIndex() {
+    close();
+}
+
+void MappedIndex::close() {
+    modified();
+    if (base_) {
+        munmap(const_cast<char*>(base_), mappedSize_);
+    }
+    base_ = nullptr;
+    mappedSize_ = 0;
+    docs_ = skipped_ = nullptr;
+    docStats_ = nullptr;
+    signatures_ = nullptr;
+    terms_ = nullptr;
+    postings_ = nullptr;
+    fieldTfs_ = nullptr;
+    positionStarts_ = nullptr;
+    positions_ = nullptr;
+    strings_ = nullptr;
+    docCount_ = skippedCount_ = termCount_ = postingCount_ = positionCount_ = stringsSize_ = 0;
+    totals_ = CorpusStats();
+}
+
+bool MappedIndex::open(const std::string& path) {
+    ProfileScope scope("index map");
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false; // No saved index yet: not an error
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(IndexFileHeader)) {
+        std::cerr << "[Index Error] " << path << " is truncated, ignoring it." << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "[Index Error] Could not map " << path << std::endl;
+        return false;
+    }
+    base_ = static_cast<const char*>(mapping);
+    mappedSize_ = static_cast<size_t>(st.st_size);
+
+    // Validate the header and that every section lies inside the file
+    const IndexFileHeader* header = reinterpret_cast<const IndexFileHeader*>(base_);
+    if (std::memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+        std::cerr << "[Index Error] " << path << " is not an index file, ignoring it." << std::endl;
+        close();
+        return false;
+    }
+    if (header->version != INDEX_FILE_VERSION || header->headerSize != sizeof(IndexFileHeader)) {
+        std::cerr << "[Index Error] " << path << " has format version " << header->version
+                  << " (expected " << INDEX_FILE_VERSION << "), rebuilding." << std::endl;
+        close();
+        return false;
+    }
+    auto sectionFits = [&](uint64_t offset, uint64_t count, uint64_t width) {
+        return offset % 8 == 0 && offset <= mappedSize_ && count <= (mappedSize_ - offset) / width;
+    };
+    if (header->fileSize != mappedSize_ ||
+        !sectionFits(header->docTableOffset, header->docCount + header->skippedCount, sizeof(IndexDocEntry)) ||
+        !sectionFits(header->docStatsOffset, header->docCount, sizeof(DocumentStats)) ||
+        !sectionFits(header->signaturesOffset, header->docCount, sizeof(MinHashSignature)) ||
+        !sectionFits(header->termTableOffset, header->termCount, sizeof(IndexTermEntry)) ||
+        !sectionFits(header->postingsOffset, header->postingCount, sizeof(Posting)) ||
+        !sectionFits(header->fieldTfsOffset, header->postingCount, sizeof(FieldTf)) ||
+        !sectionFits(header->positionStartsOffset, header->postingCount, sizeof(uint64_t)) ||
+        !sectionFits(header->positionsOffset, header->positionCount, sizeof(uint32_t)) ||
+        !sectionFits(header->stringsOffset, header->stringsSize, 1)) {
+        std::cerr << "[Index Error] " << path << " is corrupt, ignoring it." << std::endl;
+        close();
+        return false;
+    }
+
+    docCount_ = header->docCount;
+    skippedCount_ = header->skippedCount;
+    termCount_ = header->termCount;
+    postingCount_ = header->postingCount;
+    positionCount_ = header->positionCount;
+    stringsSize_ = header->stringsSize;
+    docs_ = reinterpret_cast<const IndexDocEntry*>(base_ + header->docTableOffset);
+    skipped_ = docs_ + docCount_;
+    docStats_ = reinterpret_cast<const DocumentStats*>(base_ + header->docStatsOffset);
+    signatures_ = reinterpret_cast<const MinHashSignature*>(base_ + header->signaturesOffset);
+    terms_ = reinterpret_cast<const IndexTermEntry*>(base_ + header->termTableOffset);
+    postings_ = reinterpret_cast<const Posting*>(base_ + header->postingsOffset);
+    fieldTfs_ = reinterpret_cast<const FieldTf*>(base_ + header->fieldTfsOffset);
+    positionStarts_ = reinterpret_cast<const uint64_t*>(base_ + header->positionStartsOffset);
+    positions_ = reinterpret_cast<const uint32_t*>(base_ + header->positionsOffset);
+    strings_ = base_ + header->stringsOffset;
+    totals_.documents = docCount_;
+    totals_.length = header->totalLength;
+    totals_.titleLength = header->totalTitleLength;
+    totals_.firstPageLength = header->totalFirstPageLength;
+    return true;
+}
+
+std::string_view MappedIndex::poolString(uint64_t offset, uint32_t length) const {
+    if (offset > stringsSize_ || length > stringsSize_ - offset) return std::string_view();
+    return std::string_view(strings_ + offset, length);
+}
+
+std::string_view MappedIndex::documentPath(uint32_t docId) const {
+    return poolString(docs_[docId].pathOffset, docs_[docId].pathLength);
+}
+
+DocumentStamp MappedIndex::documentStamp(uint32_t docId) const {
+    DocumentStamp stamp;
+    stamp.size = docs_[docId].size;
+    stamp.mtime = docs_[docId].mtime;
+    return stamp;
+}
+
+PostingList MappedIndex::postings(std::string_view term) const {
+    const IndexTermEntry* first = terms_;
+    const IndexTermEntry* last = terms_ + termCount_;
+    const IndexTermEntry* it = std::lower_bound(first, last, term, [&](const IndexTermEntry& entry, std::string_view key) {
+        return poolString(entry.termOffset, entry.termLength) < key;
+    });
+    if (it == last || poolString(it->termOffset, it->termLength) != term) return PostingList();
+    return postingList(*it);
+}
+
+PostingList MappedIndex::postingList(const IndexTermEntry& entry) const {
+    if (entry.firstPosting > postingCount_ || entry.postingCount > postingCount_ - entry.firstPosting) {
+        return PostingList();
+    }
+    return PostingList{postings_ + entry.firstPosting, entry.postingCount,
+                       TermBounds{entry.maxTfWeight, entry.maxNorm, entry.maxTf, entry.maxTitleTf},
+                       fieldTfs_ + entry.firstPosting};
+}
+
+PositionList MappedIndex::positions(std::string_view term, uint32_t docId) const {
+    PostingList list = postings(term);
+    const Posting* it = std::lower_bound(list.begin(), list.end(), docId, [](const Posting& posting, uint32_t id) {
+        return posting.docId < id;
+    });
+    if (it == list.end() || it->docId != docId) return PositionList();
+    return positionsOf(it);
+}
+
+PositionList MappedIndex::positionsOf(const Posting* posting) const {
+    uint64_t start = positionStarts_[posting - postings_];
+    if (start > positionCount_ || posting->tf > positionCount_ - start) return PositionList();
+    return PositionList{positions_ + start, posting->tf};
+}
+
+void MappedIndex::forEachTerm(const std::function<void(std::string_view, PostingList)>& visit) const {
+    for (size_t i = 0; i < termCount_; ++i) {
+        const IndexTermEntry& entry = terms_[i];
+        PostingList postings = postingList(entry);
+        if (postings.data == nullptr) continue;
+        visit(poolString(entry.termOffset, entry.termLength), postings);
+    }
+}
+
+std::string_view MappedIndex::skippedPath(size_t i) const {
+    return poolString(skipped_[i].pathOffset, skipped_[i].pathLength);
+}
+
+DocumentStamp MappedIndex::skippedStamp(size_t i) const {
+    DocumentStamp stamp;
+    stamp.size = skipped_[i].size;
+    stamp.mtime = skipped_[i].mtime;
+    return stamp;
+}
+
+bool MappedIndex::isUpToDate(const std::vector<std::string>& pdfPaths) const {
+    if (!isOpen() || pdfPaths.size() != docCount_ + skippedCount_) return false;
+
+    std::unordered_set<std::string_view> known;
+    known.reserve(docCount_ + skippedCount_);
+    for (size_t i = 0; i < docCount_ + skippedCount_; ++i) {
+        const IndexDocEntry& entry = docs_[i];
+        std::string_view docPath = poolString(entry.pathOffset, entry.pathLength);
+        DocumentStamp current;
+        if (!readDocumentStamp(std::string(docPath), current)) return false;
+        if (current.size != entry.size || current.mtime != entry.mtime) return false;
+        known.insert(docPath);
+    }
+    for (const auto& pdfPath : pdfPaths) {
+        if (!known.count(pdfPath)) return false;
+    }
+    return true;
+}
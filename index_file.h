@@ -0,0 +1,153 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+#include "index_reader.h"
+#include "inverted_index.h"
+
+/**
+ * On-disk index layout (native little-endian, every section 8-byte aligned):
+ *
+ *   IndexFileHeader
+ *   IndexDocEntry[docCount]   indexed documents, by doc id
+ *   IndexDocEntry[skipped]    source files that produced no text
+ *   DocumentStats[docCount]   token counts per field, by doc id
+ *   MinHashSignature[docCount] shingle signatures, by doc id
+ *   IndexTermEntry[termCount] term dictionary, sorted by term bytes
+ *   Posting[postingCount]     all postings lists back to back
+ *   FieldTf[postingCount]     per-field tf of each posting
+ *   uint64_t[postingCount]    for each posting, where its positions start
+ *   uint32_t[positionCount]   token positions; a posting owns tf of them
+ *   char[stringsSize]         string pool for paths and terms
+ *
+ * Bump INDEX_FILE_VERSION whenever any of these structs change.
+ */
+const uint32_t INDEX_FILE_VERSION = 5;
+
+struct IndexFileHeader {
+    char magic[8];            // "PDFORGIX"
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+    uint64_t docCount;
+    uint64_t skippedCount;
+    uint64_t termCount;
+    uint64_t postingCount;
+    uint64_t positionCount;
+    uint64_t stringsSize;
+    uint64_t totalLength;     // CorpusStats
+    uint64_t totalTitleLength;
+    uint64_t totalFirstPageLength;
+    uint64_t docTableOffset;  // Skipped entries follow the documents directly
+    uint64_t docStatsOffset;
+    uint64_t signaturesOffset;
+    uint64_t termTableOffset;
+    uint64_t postingsOffset;
+    uint64_t fieldTfsOffset;
+    uint64_t positionStartsOffset;
+    uint64_t positionsOffset;
+    uint64_t stringsOffset;
+};
+
+struct IndexDocEntry {
+    uint64_t pathOffset;      // Into the string pool
+    uint32_t pathLength;
+    uint32_t length;          // Token count
+    uint64_t size;            // DocumentStamp of the source file
+    int64_t mtime;
+};
+
+struct IndexTermEntry {
+    uint64_t termOffset;      // Into the string pool
+    uint32_t termLength;
+    uint32_t postingCount;    // Document frequency
+    uint64_t firstPosting;    // Index into the postings section
+    double maxTfWeight;       // TermBounds, exact at write time
+    double maxNorm;
+    uint32_t maxTf;
+    uint32_t maxTitleTf;
+};
+
+// Writes `index` to `path` atomically (temp file + rename). Returns false on failure.
+bool writeIndexFile(const InvertedIndex& index, const std::string& path);
+
+// Loads a saved index into a mutable InvertedIndex (for incremental updates).
+bool readIndexFile(const std::string& path, InvertedIndex& index);
+
+/**
+ * @brief Read-only index served straight from a memory-mapped index file.
+ *
+ * Opening only validates the header and maps the file; lookups binary-search
+ * the sorted dictionary and return postings that point into the mapping, so
+ * nothing is deserialized into heap containers.
+ */
+class MappedIndex : public IndexReader {
+public:
+    MappedIndex() = default;
+    ~MappedIndex() override;
+    MappedIndex(const MappedIndex&) = delete;
+    MappedIndex& operator=(const MappedIndex&) = delete;
+
+    // Maps `path`. Returns false (and logs why) if it is missing, truncated or of another version.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return base_ != nullptr; }
+
+    /**
+     * @brief Checks that the index was built from exactly `pdfPaths`, unchanged.
+     * Every indexed or skipped file must still exist with the same size and mtime,
+     * and no path may be missing from the index.
+     */
+    bool isUpToDate(const std::vector<std::string>& pdfPaths) const;
+
+    size_t documentCount() const override { return docCount_; }
+    size_t termCount() const override { return termCount_; }
+    std::string_view documentPath(uint32_t docId) const override;
+    const DocumentStats* documentStats() const override { return docStats_; }
+    CorpusStats corpusStats() const override { return totals_; }
+    const MinHashSignature* documentSignatures() const override { return signatures_; }
+    DocumentStamp documentStamp(uint32_t docId) const;
+
+    PostingList postings(std::string_view term) const override;
+    PositionList positions(std::string_view term, uint32_t docId) const override;
+
+    // Visits the dictionary in sorted term order.
+    void forEachTerm(const std::function<void(std::string_view, PostingList)>& visit) const;
+
+    // Positions of a posting handed out by postings() or forEachTerm().
+    PositionList positionsOf(const Posting* posting) const;
+
+    size_t skippedCount() const { return skippedCount_; }
+    std::string_view skippedPath(size_t i) const;
+    DocumentStamp skippedStamp(size_t i) const;
+
+private:
+    std::string_view poolString(uint64_t offset, uint32_t length) const;
+    PostingList postingList(const IndexTermEntry& entry) const;
+
+    const char* base_ = nullptr;
+    size_t mappedSize_ = 0;
+
+    const IndexDocEntry* docs_ = nullptr;
+    const IndexDocEntry* skipped_ = nullptr;
+    const DocumentStats* docStats_ = nullptr;
+    const MinHashSignature* signatures_ = nullptr;
+    const IndexTermEntry* terms_ = nullptr;
+    const Posting* postings_ = nullptr;
+    const FieldTf* fieldTfs_ = nullptr;
+    const uint64_t* positionStarts_ = nullptr;
+    const uint32_t* positions_ = nullptr;
+    const char* strings_ = nullptr;
+
+    size_t docCount_ = 0;
+    size_t skippedCount_ = 0;
+    size_t termCount_ = 0;
+    size_t postingCount_ = 0;
+    size_t positionCount_ = 0;
+    size_t stringsSize_ = 0;
+    CorpusStats totals_;
+};
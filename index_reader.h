@@ -0,0 +1,144 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "minhash.h"
+
+// Where a piece of document text comes from. A document's text is its
+// metadata (title, subject, keywords), then its first page, then the rest.
+enum TextField : uint8_t {
+    FIELD_TITLE = 0,
+    FIELD_FIRST_PAGE = 1,
+    FIELD_BODY = 2,
+};
+
+// One entry of a postings list: a document and how often the term occurs in it.
+struct Posting {
+    uint32_t docId;
+    uint32_t tf;              // All fields
+};
+
+// Per-field share of a posting's tf (the body gets the rest), kept parallel to the postings.
+struct FieldTf {
+    uint32_t title;
+    uint32_t firstPage;
+};
+
+// Token counts of one document, overall and per field (the body gets the rest).
+struct DocumentStats {
+    uint32_t length;
+    uint32_t titleLength;
+    uint32_t firstPageLength;
+};
+
+// Token totals over all documents, for average lengths.
+struct CorpusStats {
+    uint64_t documents = 0;
+    uint64_t length = 0;
+    uint64_t titleLength = 0;
+    uint64_t firstPageLength = 0;
+};
+
+// Per-term score bounds, taken over every posting of the term, for top-K pruning.
+// Bounds may be loose (e.g. after removals) but never below the true maximum.
+struct TermBounds {
+    double maxTfWeight = 0.0; // max (1 + log tf) / sqrt(max(length, 1))
+    double maxNorm = 0.0;     // max 1 / sqrt(max(length, 1))
+    uint32_t maxTf = 0;
+    uint32_t maxTitleTf = 0;
+};
+
+// Weight and norm of one posting, as used by TermBounds.
+double postingTfWeight(uint32_t tf, uint32_t documentLength);
+double documentNorm(uint32_t documentLength);
+
+// Non-owning view of a postings list sorted by doc id.
+struct PostingList {
+    const Posting* data = nullptr;
+    size_t count = 0;
+    TermBounds bounds;
+    const FieldTf* fields = nullptr; // fields[i] belongs to data[i]
+
+    const Posting* begin() const { return data; }
+    const Posting* end() const { return data + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+};
+
+// Non-owning view of the ascending token positions of one term in one document.
+struct PositionList {
+    const uint32_t* data = nullptr;
+    size_t count = 0;
+
+    const uint32_t* begin() const { return data; }
+    const uint32_t* end() const { return data + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+};
+
+// Size and mtime of a source file when it was indexed.
+struct DocumentStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0; // Raw file_time_type tick count
+
+    bool operator==(const DocumentStamp& other) const { return size == other.size && mtime == other.mtime; }
+    bool operator!=(const DocumentStamp& other) const { return !(*this == other); }
+};
+
+// Stats `path`. Returns false if the file cannot be stat'ed.
+bool readDocumentStamp(const std::string& path, DocumentStamp& stamp);
+
+/**
+ * @brief Read-only view of a term index, shared by the in-memory InvertedIndex
+ * and the memory-mapped MappedIndex so RelevanceScorer can query either.
+ *
+ * Virtual dispatch happens once per query term (and per term of each phrase
+ * candidate), never per posting.
+ */
+class IndexReader {
+public:
+    virtual ~IndexReader() = default;
+
+    virtual size_t documentCount() const = 0;
+    virtual size_t termCount() const = 0;
+    virtual std::string_view documentPath(uint32_t docId) const = 0;
+    uint32_t documentLength(uint32_t docId) const { return documentStats()[docId].length; }
+
+    // Dense per-document stats, indexed by doc id
+    virtual const DocumentStats* documentStats() const = 0;
+    virtual CorpusStats corpusStats() const = 0;
+    // Dense per-document MinHash signatures of the token stream, indexed by doc id
+    virtual const MinHashSignature* documentSignatures() const = 0;
+
+    // Postings for `term`; empty if no document contains it.
+    virtual PostingList postings(std::string_view term) const = 0;
+
+    // Where `term` occurs in `docId` (see Tokenizer::forEachPositionedToken); empty if absent.
+    virtual PositionList positions(std::string_view term, uint32_t docId) const = 0;
+
+    // Changes whenever the contents may have; unique across all readers in the
+    // process, so results derived from a reader can tell whether they are stale.
+    uint64_t generation() const { return generation_; }
+
+protected:
+    IndexReader() : generation_(nextGeneration()) {}
+    // A copy is a different index as far as derived results are concerned
+    IndexReader(const IndexReader&) : generation_(nextGeneration()) {}
+    IndexReader& operator=(const IndexReader&) {
+        modified();
+        return *this;
+    }
+
+    void modified() { generation_ = nextGeneration(); }
+
+private:
+    static uint64_t nextGeneration() {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+
+    uint64_t generation_;
+};
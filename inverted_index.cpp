@@ -0,0 +1,353 @@
+#include "inverted_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+bool readDocumentStamp(const std::string& path, DocumentStamp& stamp) {
+    std::error_code ec;
+    stamp.size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    stamp.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    return true;
+}
+
+double documentNorm(uint32_t documentLength) {
+    return 1.0 / std::sqrt((double)std::max<uint32_t>(documentLength, 1));
+}
+
+double postingTfWeight(uint32_t tf, uint32_t documentLength) {
+    return (1.0 + std::log((double)tf)) * documentNorm(documentLength);
+}
+
+namespace {
+
+bool byDocId(const Posting& posting, uint32_t docId) {
+    return posting.docId < docId;
+}
+
+// Capacity of a term's first extent; most terms never outgrow it
+const uint32_t FIRST_EXTENT = 2;
+
+uint32_t floorLog2(uint32_t n) {
+    uint32_t log = 0;
+    while (n >>= 1) ++log;
+    return log;
+}
+
+uint32_t ceilLog2(uint32_t n) {
+    return n <= 1 ? 0 : floorLog2(n - 1) + 1;
+}
+
+} // namespace
+
+uint32_t InvertedIndex::termIdFor(std::string_view term) {
+    uint32_t termId = terms_.intern(term);
+    if (termId == extents_.size()) {
+        extents_.emplace_back();
+        termBounds_.emplace_back();
+        pendingCounts_.push_back(0);
+        pendingFieldCounts_.push_back(FieldTf{0, 0});
+    }
+    return termId;
+}
+
+uint32_t InvertedIndex::addDocument(const std::string& path, const std::vector<std::string>& tokens,
+                                    const DocumentStamp& stamp) {
+    beginDocument();
+    for (size_t i = 0; i < tokens.size(); ++i) addToken(tokens[i], static_cast<uint32_t>(i));
+    return endDocument(path, stamp);
+}
+
+void InvertedIndex::beginDocument() {
+    for (uint32_t termId : pendingTerms_) {
+        pendingCounts_[termId] = 0;
+        pendingFieldCounts_[termId] = FieldTf{0, 0};
+    }
+    pendingTerms_.clear();
+    pendingTokens_.clear();
+    pendingStats_ = DocumentStats();
+    pendingHasher_.reset();
+}
+
+void InvertedIndex::addToken(std::string_view token, uint32_t position, TextField field) {
+    // Count occurrences per term id for this document only. Term ids are never
+    // reused, so they stay valid across the removal in endDocument.
+    uint32_t termId = termIdFor(token);
+    if (pendingCounts_[termId]++ == 0) pendingTerms_.push_back(termId);
+    pendingTokens_.emplace_back(termId, position);
+    pendingHasher_.add(token);
+    pendingStats_.length++;
+    if (field == FIELD_TITLE) {
+        pendingFieldCounts_[termId].title++;
+        pendingStats_.titleLength++;
+    } else if (field == FIELD_FIRST_PAGE) {
+        pendingFieldCounts_[termId].firstPage++;
+        pendingStats_.firstPageLength++;
+    }
+}
+
+uint32_t InvertedIndex::endDocument(const std::string& path, const DocumentStamp& stamp) {
+    removeFile(path);
+    modified();
+
+    const uint32_t docId = static_cast<uint32_t>(docPaths_.size());
+    docIds_[path] = docId;
+    docPaths_.push_back(path);
+    docStats_.push_back(pendingStats_);
+    docSignatures_.push_back(pendingHasher_.signature());
+    docStamps_.push_back(stamp);
+    totals_.length += pendingStats_.length;
+    totals_.titleLength += pendingStats_.titleLength;
+    totals_.firstPageLength += pendingStats_.firstPageLength;
+
+    // New doc ids are always the largest so far, so appending keeps postings sorted.
+    // pendingCounts_ then turns into each term's write cursor into the positions.
+    std::sort(pendingTerms_.begin(), pendingTerms_.end());
+    DocumentPositions positions;
+    positions.starts.reserve(pendingTerms_.size() + 1);
+    positions.starts.push_back(0);
+    const double norm = documentNorm(pendingStats_.length);
+    for (uint32_t termId : pendingTerms_) {
+        if (extents_[termId].size == 0) liveTerms_++;
+        const uint32_t tf = pendingCounts_[termId];
+        const FieldTf fields = pendingFieldCounts_[termId];
+        appendPosting(termId, Posting{docId, tf}, fields);
+        pendingFieldCounts_[termId] = FieldTf{0, 0};
+        TermBounds& bounds = termBounds_[termId];
+        bounds.maxTfWeight = std::max(bounds.maxTfWeight, postingTfWeight(tf, pendingStats_.length));
+        bounds.maxNorm = std::max(bounds.maxNorm, norm);
+        bounds.maxTf = std::max(bounds.maxTf, tf);
+        bounds.maxTitleTf = std::max(bounds.maxTitleTf, fields.title);
+        pendingCounts_[termId] = positions.starts.back();
+        positions.starts.push_back(positions.starts.back() + tf);
+    }
+    positions.positions.resize(pendingTokens_.size());
+    for (const auto& token : pendingTokens_) {
+        positions.positions[pendingCounts_[token.first]++] = token.second;
+    }
+    for (uint32_t termId : pendingTerms_) pendingCounts_[termId] = 0;
+
+    docTerms_.emplace_back(pendingTerms_.begin(), pendingTerms_.end());
+    docPositions_.push_back(std::move(positions));
+    pendingTerms_.clear();
+    pendingTokens_.clear();
+    pendingStats_ = DocumentStats();
+    pendingHasher_.reset();
+    return docId;
+}
+
+void InvertedIndex::addSkippedFile(const std::string& path, const DocumentStamp& stamp) {
+    removeFile(path);
+    skippedFiles_[path] = stamp;
+}
+
+bool InvertedIndex::removeFile(const std::string& path) {
+    auto it = docIds_.find(path);
+    if (it != docIds_.end()) {
+        removeDocument(it->second);
+        return true;
+    }
+    return skippedFiles_.erase(path) > 0;
+}
+
+void InvertedIndex::removeDocument(uint32_t docId) {
+    modified();
+    // 1. Drop this document's postings
+    for (uint32_t termId : docTerms_[docId]) {
+        PostingExtent& extent = extents_[termId];
+        Posting* list = postingArena_.data() + extent.offset;
+        FieldTf* fields = fieldTfArena_.data() + extent.offset;
+        Posting* pos = std::lower_bound(list, list + extent.size, docId, byDocId);
+        if (pos != list + extent.size && pos->docId == docId) {
+            const size_t i = static_cast<size_t>(pos - list);
+            std::copy(list + i + 1, list + extent.size, list + i);
+            std::copy(fields + i + 1, fields + extent.size, fields + i);
+            extent.size--;
+        }
+        if (extent.size == 0) {
+            // Bounds only ever grow while a term is live; start over once it is gone
+            liveTerms_--;
+            termBounds_[termId] = TermBounds();
+        }
+    }
+    docIds_.erase(docPaths_[docId]);
+    totals_.length -= docStats_[docId].length;
+    totals_.titleLength -= docStats_[docId].titleLength;
+    totals_.firstPageLength -= docStats_[docId].firstPageLength;
+
+    // 2. Move the last document into the freed id. Its postings are the last
+    //    entry of each of its lists; re-insert them at their new sorted place,
+    //    which never needs more room than the extent already has.
+    const uint32_t lastId = static_cast<uint32_t>(docPaths_.size() - 1);
+    if (docId != lastId) {
+        for (uint32_t termId : docTerms_[lastId]) {
+            const PostingExtent& extent = extents_[termId];
+            Posting* list = postingArena_.data() + extent.offset;
+            FieldTf* fields = fieldTfArena_.data() + extent.offset;
+            const size_t last = extent.size - 1;
+            Posting moved = list[last];
+            FieldTf movedFields = fields[last];
+            moved.docId = docId;
+            const size_t at = static_cast<size_t>(std::lower_bound(list, list + last, docId, byDocId) - list);
+            std::copy_backward(list + at, list + last, list + last + 1);
+            std::copy_backward(fields + at, fields + last, fields + last + 1);
+            list[at] = moved;
+            fields[at] = movedFields;
+        }
+        docPaths_[docId] = std::move(docPaths_[lastId]);
+        docStats_[docId] = docStats_[lastId];
+        docSignatures_[docId] = docSignatures_[lastId];
+        docStamps_[docId] = docStamps_[lastId];
+        docTerms_[docId] = std::move(docTerms_[lastId]);
+        docPositions_[docId] = std::move(docPositions_[lastId]);
+        docIds_[docPaths_[docId]] = docId;
+    }
+    docPaths_.pop_back();
+    docStats_.pop_back();
+    docSignatures_.pop_back();
+    docStamps_.pop_back();
+    docTerms_.pop_back();
+    docPositions_.pop_back();
+}
+
+bool InvertedIndex::findFile(const std::string& path, DocumentStamp& stamp) const {
+    auto it = docIds_.find(path);
+    if (it != docIds_.end()) {
+        stamp = docStamps_[it->second];
+        return true;
+    }
+    auto skipped = skippedFiles_.find(path);
+    if (skipped != skippedFiles_.end()) {
+        stamp = skipped->second;
+        return true;
+    }
+    return false;
+}
+
+std::vector<std::string> InvertedIndex::filePaths() const {
+    std::vector<std::string> paths(docPaths_.begin(), docPaths_.end());
+    for (const auto& skipped : skippedFiles_) paths.push_back(skipped.first);
+    return paths;
+}
+
+CorpusStats InvertedIndex::corpusStats() const {
+    CorpusStats stats = totals_;
+    stats.documents = docPaths_.size();
+    return stats;
+}
+
+PostingList InvertedIndex::postings(std::string_view term) const {
+    uint32_t termId = terms_.find(term);
+    if (termId == TermDictionary::NOT_FOUND) return PostingList();
+    return postingList(termId);
+}
+
+PositionList InvertedIndex::positions(std::string_view term, uint32_t docId) const {
+    uint32_t termId = terms_.find(term);
+    if (termId == TermDictionary::NOT_FOUND) return PositionList();
+    const std::vector<uint32_t>& terms = docTerms_[docId];
+    auto it = std::lower_bound(terms.begin(), terms.end(), termId);
+    if (it == terms.end() || *it != termId) return PositionList();
+    const DocumentPositions& doc = docPositions_[docId];
+    const size_t k = static_cast<size_t>(it - terms.begin());
+    return PositionList{doc.positions.data() + doc.starts[k], doc.starts[k + 1] - doc.starts[k]};
+}
+
+void InvertedIndex::forEachTerm(const std::function<void(std::string_view, PostingList)>& visit) const {
+    for (uint32_t termId = 0; termId < extents_.size(); ++termId) {
+        if (extents_[termId].size > 0) visit(terms_.term(termId), postingList(termId));
+    }
+}
+
+uint32_t InvertedIndex::restoreDocument(const std::string& path, const DocumentStats& stats,
+                                       const MinHashSignature& signature, const DocumentStamp& stamp) {
+    modified();
+    const uint32_t docId = static_cast<uint32_t>(docPaths_.size());
+    docIds_[path] = docId;
+    docPaths_.push_back(path);
+    docStats_.push_back(stats);
+    totals_.length += stats.length;
+    totals_.titleLength += stats.titleLength;
+    totals_.firstPageLength += stats.firstPageLength;
+    docSignatures_.push_back(signature);
+    docStamps_.push_back(stamp);
+    docTerms_.emplace_back();
+    docPositions_.emplace_back();
+    docPositions_.back().starts.push_back(0);
+    return docId;
+}
+
+void InvertedIndex::restorePostings(std::string_view term, PostingList postings, const PositionList* positions) {
+    if (postings.empty()) return;
+    modified();
+    const uint32_t termId = termIdFor(term);
+    PostingExtent& extent = extents_[termId];
+    if (extent.size == 0) liveTerms_++;
+    if (extent.capacity < postings.size()) relocateExtent(termId, static_cast<uint32_t>(postings.size()));
+    std::copy(postings.begin(), postings.end(), postingArena_.begin() + extent.offset);
+    if (postings.fields) {
+        std::copy(postings.fields, postings.fields + postings.size(), fieldTfArena_.begin() + extent.offset);
+    } else {
+        std::fill_n(fieldTfArena_.begin() + extent.offset, postings.size(), FieldTf{0, 0});
+    }
+    extent.size = static_cast<uint32_t>(postings.size());
+    termBounds_[termId] = postings.bounds;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        // Ascending terms get ascending ids, so docTerms_ stays sorted
+        const uint32_t docId = postings.data[i].docId;
+        docTerms_[docId].push_back(termId);
+        DocumentPositions& doc = docPositions_[docId];
+        doc.positions.insert(doc.positions.end(), positions[i].begin(), positions[i].end());
+        doc.starts.push_back(static_cast<uint32_t>(doc.positions.size()));
+    }
+}
+
+// --- Postings arena ---
+
+PostingList InvertedIndex::postingList(uint32_t termId) const {
+    const PostingExtent& extent = extents_[termId];
+    return PostingList{postingArena_.data() + extent.offset, extent.size, termBounds_[termId],
+                       fieldTfArena_.data() + extent.offset};
+}
+
+void InvertedIndex::appendPosting(uint32_t termId, Posting posting, FieldTf fields) {
+    if (extents_[termId].size == extents_[termId].capacity) {
+        relocateExtent(termId, std::max(FIRST_EXTENT, extents_[termId].capacity * 2));
+    }
+    PostingExtent& extent = extents_[termId];
+    postingArena_[extent.offset + extent.size] = posting;
+    fieldTfArena_[extent.offset + extent.size] = fields;
+    extent.size++;
+}
+
+void InvertedIndex::relocateExtent(uint32_t termId, uint32_t capacity) {
+    PostingExtent& extent = extents_[termId];
+    if (extent.offset + extent.capacity == postingArena_.size()) {
+        // Last extent in the arena: grow it where it is
+        postingArena_.resize(extent.offset + capacity);
+        fieldTfArena_.resize(extent.offset + capacity);
+        extent.capacity = capacity;
+        return;
+    }
+
+    // Reuse a block some other list moved out of, else take fresh space at the end
+    PostingExtent target;
+    std::vector<PostingExtent>& reusable = freeExtents_[ceilLog2(capacity)];
+    if (!reusable.empty()) {
+        target = reusable.back();
+        reusable.pop_back();
+    } else {
+        target.offset = postingArena_.size();
+        target.capacity = capacity;
+        postingArena_.resize(target.offset + capacity);
+        fieldTfArena_.resize(target.offset + capacity);
+    }
+    std::copy_n(postingArena_.begin() + extent.offset, extent.size, postingArena_.begin() + target.offset);
+    std::copy_n(fieldTfArena_.begin() + extent.offset, extent.size, fieldTfArena_.begin() + target.offset);
+    if (extent.capacity > 0) freeExtents_[floorLog2(extent.capacity)].push_back(extent);
+    extent.offset = target.offset;
+    extent.capacity = target.capacity;
+}
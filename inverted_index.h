@@ -0,0 +1,133 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <utility>
+#include <array>
+#include <cstdint>
+
+#include "index_reader.h"
+#include "term_dictionary.h"
+
+/**
+ * @brief Term dictionary -> postings lists, plus per-document lengths and
+ * token positions.
+ *
+ * Documents get dense ids in the order they are added, and every postings
+ * list is kept sorted by doc id. The index is tokenizer-agnostic: callers
+ * pass in already preprocessed tokens (see RelevanceScorer::buildIndex).
+ *
+ * Documents can also be replaced or removed in place, which only touches the
+ * postings of that document's terms. Removal moves the last document into the
+ * freed id so ids stay dense and documentCount() is always the live count.
+ */
+class InvertedIndex : public IndexReader {
+public:
+    // Adds a document (replacing any earlier entry for `path`) and returns its id.
+    // Token positions are the vector indices.
+    uint32_t addDocument(const std::string& path, const std::vector<std::string>& tokens,
+                         const DocumentStamp& stamp = DocumentStamp());
+
+    // Streaming alternative to addDocument: beginDocument(), addToken() per token
+    // (the view only needs to live for the call), then endDocument().
+    // Positions must be increasing within a document.
+    void beginDocument();
+    void addToken(std::string_view token, uint32_t position, TextField field = FIELD_BODY);
+    uint32_t endDocument(const std::string& path, const DocumentStamp& stamp = DocumentStamp());
+
+    // Records a source file that produced no text, so a saved index can tell it is not new.
+    void addSkippedFile(const std::string& path, const DocumentStamp& stamp);
+
+    // Forgets the document or skipped file recorded for `path`. Returns false if unknown.
+    bool removeFile(const std::string& path);
+
+    // Stamp recorded for `path`, whether it was indexed or skipped. False if unknown.
+    bool findFile(const std::string& path, DocumentStamp& stamp) const;
+
+    size_t documentCount() const override { return docPaths_.size(); }
+    size_t termCount() const override { return liveTerms_; }
+
+    std::string_view documentPath(uint32_t docId) const override { return docPaths_[docId]; }
+    const DocumentStats* documentStats() const override { return docStats_.data(); }
+    CorpusStats corpusStats() const override;
+    const MinHashSignature* documentSignatures() const override { return docSignatures_.data(); }
+    const DocumentStamp& documentStamp(uint32_t docId) const { return docStamps_[docId]; }
+
+    PostingList postings(std::string_view term) const override;
+    PositionList positions(std::string_view term, uint32_t docId) const override;
+
+    // Visits every term that has postings, in no particular order.
+    void forEachTerm(const std::function<void(std::string_view, PostingList)>& visit) const;
+
+    const std::map<std::string, DocumentStamp>& skippedFiles() const { return skippedFiles_; }
+
+    // Paths of all known files (indexed and skipped), in no particular order.
+    std::vector<std::string> filePaths() const;
+
+    // --- Loading a saved index ---
+    // Adds a document whose postings are supplied separately through restorePostings.
+    uint32_t restoreDocument(const std::string& path, const DocumentStats& stats, const MinHashSignature& signature,
+                             const DocumentStamp& stamp);
+    // Sets the postings (and bounds) of a new term; doc ids must refer to restored documents.
+    // `positions[i]` belongs to `postings[i]`. Terms must come in ascending order.
+    void restorePostings(std::string_view term, PostingList postings, const PositionList* positions);
+
+private:
+    uint32_t termIdFor(std::string_view term);
+    void removeDocument(uint32_t docId);
+
+    PostingList postingList(uint32_t termId) const;
+    void appendPosting(uint32_t termId, Posting posting, FieldTf fields);
+    // Moves the extent of `termId` to a block with room for at least `capacity` postings.
+    void relocateExtent(uint32_t termId, uint32_t capacity);
+
+    TermDictionary terms_;
+
+    // All postings lists live in one arena instead of a vector per term: term t
+    // owns postingArena_[offset, offset + capacity) and uses its first `size`
+    // entries, with the field tfs at the same offsets of fieldTfArena_. A full
+    // extent doubles by moving (in place if it ends the arena). The block it
+    // leaves goes on the free list of its size class, where the next list
+    // growing into that size picks it up. Adding to the index can therefore
+    // invalidate every PostingList handed out before.
+    struct PostingExtent {
+        size_t offset = 0;
+        uint32_t size = 0;
+        uint32_t capacity = 0;
+    };
+    std::vector<Posting> postingArena_;
+    std::vector<FieldTf> fieldTfArena_;           // Parallel to postingArena_
+    std::vector<PostingExtent> extents_;          // Indexed by term id
+    std::array<std::vector<PostingExtent>, 32> freeExtents_; // Blocks of capacity [2^k, 2^(k+1)), by k
+    std::vector<TermBounds> termBounds_;          // Indexed by term id
+    size_t liveTerms_ = 0;                        // Terms with at least one posting
+
+    std::unordered_map<std::string, uint32_t> docIds_;
+    std::vector<std::string> docPaths_;           // Indexed by doc id
+    std::vector<DocumentStats> docStats_;
+    CorpusStats totals_;                          // Sums over docStats_
+    std::vector<MinHashSignature> docSignatures_;
+    std::vector<DocumentStamp> docStamps_;
+    std::vector<std::vector<uint32_t>> docTerms_; // Sorted term ids per doc, for in-place removal
+
+    // Positions of one document, grouped by term in docTerms_ order: those of
+    // docTerms_[d][k] are positions[starts[k] .. starts[k + 1]).
+    struct DocumentPositions {
+        std::vector<uint32_t> starts;
+        std::vector<uint32_t> positions;
+    };
+    std::vector<DocumentPositions> docPositions_;
+
+    std::map<std::string, DocumentStamp> skippedFiles_;
+
+    // Document being streamed in between beginDocument and endDocument
+    std::vector<uint32_t> pendingCounts_;         // Indexed by term id, zero outside pendingTerms_
+    std::vector<FieldTf> pendingFieldCounts_;     // Likewise
+    std::vector<uint32_t> pendingTerms_;          // Term ids seen so far, first-seen order
+    std::vector<std::pair<uint32_t, uint32_t>> pendingTokens_; // (term id, position)
+    DocumentStats pendingStats_ = DocumentStats();
+    MinHasher pendingHasher_;
+};
@@ -1,79 +1,565 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <map>       // For std::map
 #include <iomanip>   // For std::fixed, std::setprecision
 #include <algorithm> // For std::min
 #include <cmath>     // For std::isinf
+#include <chrono>    // For load timing
+#include <fstream>   // For batch output
+#include <cstdlib>   // For std::atol
+#include <memory>    // For std::unique_ptr
+#include <csignal>   // For stopping the server
 
 // NOTE: Assuming these header files and structs (like DocumentScore, ScholarResult) are defined correctly.
 #include "pdf_extractor.h"
+#include "extraction_pipeline.h"
+#include "extraction_sandbox.h"
+#include "text_cache.h"
+#include "inverted_index.h"
+#include "index_file.h"
+#include "incremental_indexer.h"
+#include "directory_watcher.h"
 #include "file_manager.h" 
 #include "relevance_scorer.h"
+#include "near_duplicates.h"
 #include "scholar_search.h" 
+#include "scholar_cache.h"
+#include "batch_query.h"
+#include "query_server.h"
+#include "profiler.h"
 
-// Define the custom types from relevance_scorer.h for main.cpp use
-using CorpusMap = std::map<std::string, std::string>; // Map<FilePath, ExtractedText>
+namespace {
+
+// Only this many local results are ever shown, so only this many are ranked
+const size_t LOCAL_RESULT_COUNT = 5;
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [--dir PATH] [--topic TEXT] [--watch]\n"
+              << "       " << program << " [--dir PATH] --batch QUERIES [--output FILE] [--top K]\n"
+              << "       " << program << " [--dir PATH] --serve SOCKET [--watch] [--top K]\n"
+              << "       " << program << " --load-test SOCKET --load-queries FILE [--clients N] [--requests N]\n"
+              << "  --dir PATH       Root folder to scan for PDFs\n"
+              << "  --topic TEXT     Topic to rank the documents against\n"
+              << "  --watch          Keep running and re-index PDFs as they change (Linux only)\n"
+              << "  --exclude GLOB   Skip files and folders matching GLOB (repeatable; globs with '/'\n"
+              << "                   match the path below --dir)\n"
+              << "  --follow-symlinks  Also descend into symlinked folders\n"
+              << "  --no-symlinks    Ignore symlinks entirely\n"
+              << "  --sniff-pdf      Recognize PDFs by their %PDF- header instead of the .pdf extension\n"
+              << "  --isolate        Run poppler in separate worker processes; PDFs that hang or crash\n"
+              << "                   them are quarantined and skipped until they change\n"
+              << "  --max-pages N    Index at most the first N pages of each PDF\n"
+              << "  --max-bytes N    Index at most N bytes of text per PDF\n"
+              << "  --scoring MODEL  Ranking model: tfidf (default; log-tf * idf / sqrt(length)),\n"
+              << "                   bm25, or bm25f (title, first page and body fields)\n"
+              << "  --list-duplicates  Print every cluster of near-duplicate PDFs found in the corpus\n"
+              << "  --keep-duplicates  Rank near-duplicate copies separately instead of collapsing them\n"
+              << "  --batch QUERIES  Rank the corpus against every line of QUERIES (one topic per line)\n"
+              << "                   and print one JSON object per query\n"
+              << "  --output FILE    Write the batch results to FILE instead of stdout\n"
+              << "  --top K          Results per batch or served query (default " << LOCAL_RESULT_COUNT << ")\n"
+              << "  --serve SOCKET   Keep the index warm and answer topics sent as lines to the Unix socket\n"
+              << "                   SOCKET (one JSON line per topic; \"!stats\" reports p50/p99 latency).\n"
+              << "                   With --watch, changes are indexed and swapped in while serving\n"
+              << "  --load-test SOCKET  Measure a running server: send the topics of --load-queries from\n"
+              << "                   --clients connections (default 8), --requests in total (default 1000)"
+              << "\n"
+              << "  --profile        Print per-stage wall/CPU time, throughput, cache hit rates and the\n"
+              << "                   slowest documents to stderr at exit\n"
+              << "  --trace FILE     Also write every stage as Chrome trace events (chrome://tracing, Perfetto)\n"
+              << "  --slowest N      Slowest documents listed per stage with --profile (default 10)\n"
+              << "  --scholar-url URL    Search endpoint for the online fallback (e.g. a local test server)\n"
+              << "  --scholar-pages N    Result pages to fetch concurrently in the fallback (default 1)\n";
+}
+
+// Prints the top local results, scores normalized against the best one.
+void printLocalResults(const std::vector<DocumentScore>& localResults) {
+    double maxScore = (!localResults.empty() && localResults[0].score > 0.0) ? localResults[0].score : 0.0;
+
+    std::cout << "Top " << LOCAL_RESULT_COUNT << " Most Relevant Local Documents (Score indicates relevance):" << std::endl;
+    int rank = 1;
+
+    for (const auto& res : localResults) {
+        if (rank > (int)LOCAL_RESULT_COUNT || res.score <= 0.0) break;
+        // Normalize score for display using the determined maxScore
+        double displayScore = (res.score / maxScore) * 100.0;
+        
+        // Extract only the filename from the full path for cleaner display
+        std::string full_path = res.filePath;
+        size_t last_slash = full_path.find_last_of("/\\");
+        std::string display_path = (last_slash == std::string::npos) ? 
+                                   full_path : full_path.substr(last_slash + 1);
+
+        std::cout << rank++ << ". [" << std::fixed << std::setprecision(2) 
+                  << displayScore << "%] - " << display_path;
+        if (!res.duplicates.empty()) std::cout << " (+" << res.duplicates.size() << " near-duplicates)";
+        std::cout << std::endl;
+    }
+}
+
+// The server's copy of the index: the saved file mapped again if it is current,
+// otherwise a copy of the in-memory index.
+std::unique_ptr<const IndexReader> servedIndex(const std::string& indexFilePath, bool indexFileCurrent,
+                                               const InvertedIndex& built) {
+    if (indexFileCurrent) {
+        std::unique_ptr<MappedIndex> mapped(new MappedIndex());
+        if (mapped->open(indexFilePath)) return std::unique_ptr<const IndexReader>(std::move(mapped));
+    }
+    return std::unique_ptr<const IndexReader>(new InvertedIndex(built));
+}
+
+QueryServer* activeServer = nullptr;
+
+void stopServer(int) {
+    if (activeServer) activeServer->requestStop();
+}
+
+// Clusters the corpus and reports what was found; the full list only on request.
+void reportNearDuplicates(NearDuplicates& duplicates, const IndexReader& index, bool listClusters) {
+    auto start = std::chrono::steady_clock::now();
+    duplicates.build(index);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[Local Status] Near-duplicates: " << duplicates.duplicateCount() << " copies in "
+              << duplicates.clusters().size() << " clusters (found in " << std::fixed << std::setprecision(1)
+              << ms << " ms)." << std::endl;
+    if (!listClusters) return;
+    for (uint32_t representative : duplicates.clusters()) {
+        std::cout << "  " << index.documentPath(representative) << std::endl;
+        for (uint32_t duplicate : duplicates.duplicatesOf(representative)) {
+            double similarity = estimatedSimilarity(index.documentSignatures()[representative],
+                                                    index.documentSignatures()[duplicate]);
+            std::cout << "    = " << index.documentPath(duplicate) << " (" << std::setprecision(0)
+                      << similarity * 100.0 << "% similar)" << std::endl;
+        }
+    }
+}
+
+// Installs the profiler for the run and reports when main returns.
+struct ProfileSession {
+    std::unique_ptr<Profiler> profiler;
+    std::string tracePath;
+
+    ~ProfileSession() {
+        if (!profiler) return;
+        Profiler::setActive(nullptr);
+        profiler->printSummary(std::cerr);
+        if (tracePath.empty()) return;
+        if (profiler->writeTrace(tracePath)) {
+            std::cerr << "[Profile] Wrote trace events to " << tracePath << std::endl;
+        } else {
+            std::cerr << "[Error] Could not write trace to " << tracePath << std::endl;
+        }
+    }
+};
+
+void printReconcileStats(const ReconcileStats& stats) {
+    std::cout << stats.added << " added, " << stats.updated << " updated, " << stats.removed
+              << " removed, " << stats.unchanged << " unchanged";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // Sandboxed extraction workers are this same binary
+    if (argc > 1 && std::string(argv[1]) == ExtractionSandbox::WORKER_FLAG) {
+        return ExtractionSandbox::runWorker(argc, argv);
+    }
 
-int main() {
     // --- 1. Define Search Parameters ---
     // Target Topic: Highly specific topic to test ranking accuracy
-    const std::string searchTopic = "Title: AI-Powered Social Media Automation App";
+    std::string searchTopic = "Title: AI-Powered Social Media Automation App";
     
     // !!! CRITICAL: Set this path to the root folder you want to scan !!!
-    const std::string searchDirectory = "/Users/amanmalik/Downloads/pdfs"; 
+    std::string searchDirectory = "/Users/amanmalik/Downloads/pdfs"; 
+
+    // Long-running mode: keep the index in sync with the folder via inotify
+    bool watchMode = false;
+
+    // Directory crawl: threads, symlink policy, exclusions, PDF detection
+    CrawlOptions crawlOptions;
+
+    // Extraction worker threads (0 = one per hardware thread)
+    const unsigned extractionWorkers = 0;
+    // Extracted pages waiting to be indexed are capped at this many bytes (0 = unlimited)
+    const size_t extractionMemoryBudget = 256 * 1024 * 1024;
+    // Per-document caps for pathological PDFs (0 = unlimited)
+    ExtractionLimits extractionLimits;
+    // Crash isolation: poppler runs in worker processes with a time and memory cap per document
+    bool isolateExtraction = false;
+    const int extractionTimeoutMs = 60 * 1000;
+    const size_t extractionMemoryLimit = 2048ull << 20;
+    const std::string quarantineFilePath = ".pdf_organizer_cache/quarantine.tsv";
+
+    // Ranking model, see ScoringModel
+    std::string scoringModelName = "tfidf";
+    // Near-duplicate PDFs are ranked once, as one result listing the copies
+    bool collapseDuplicates = true;
+    bool listDuplicates = false;
+
+    // Persistent extracted-text cache (keyed by path, size and mtime)
+    const std::string textCacheDirectory = ".pdf_organizer_cache/text";
+    const bool hashCachedContents = false; // Also key by file content hash (slower, stricter)
+
+    // Saved, memory-mapped index; reused when no PDF changed since it was written
+    const std::string indexFilePath = ".pdf_organizer_cache/corpus.idx";
+
+    // Batch mode: many topics against one loaded corpus, JSON Lines out
+    std::string batchQueryPath;
+    std::string batchOutputPath; // Empty = stdout
+    size_t batchTopK = LOCAL_RESULT_COUNT;
+    const unsigned batchThreads = 0; // 0 = one per hardware thread
+
+    // Online fallback; parsed result pages are cached and revalidated once older than the TTL
+    const std::string scholarCacheDirectory = ".pdf_organizer_cache/scholar";
+    const int64_t scholarCacheTtlSeconds = 24 * 60 * 60;
+    std::string scholarUrl = ScholarSearch::DEFAULT_BASE_URL;
+    int scholarPages = 1;
+
+    // Instrumentation: off unless asked for
+    bool profile = false;
+    std::string tracePath;
+    size_t slowestCount = 10;
+
+    // Server mode: answer topics over a Unix socket from a warm index
+    ServerOptions serverOptions;
+    std::string loadTestSocket;
+    std::string loadTestQueryPath;
+    unsigned loadTestClients = 8;
+    size_t loadTestRequests = 1000;
+
+    // Command-line overrides
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--dir" && i + 1 < argc) {
+            searchDirectory = argv[++i];
+        } else if (arg == "--topic" && i + 1 < argc) {
+            searchTopic = argv[++i];
+        } else if (arg == "--watch") {
+            watchMode = true;
+        } else if (arg == "--exclude" && i + 1 < argc) {
+            crawlOptions.excludeGlobs.push_back(argv[++i]);
+        } else if (arg == "--follow-symlinks") {
+            crawlOptions.symlinks = CrawlOptions::FOLLOW_ALL;
+        } else if (arg == "--no-symlinks") {
+            crawlOptions.symlinks = CrawlOptions::SKIP_SYMLINKS;
+        } else if (arg == "--sniff-pdf") {
+            crawlOptions.sniffPdfMagic = true;
+        } else if (arg == "--isolate") {
+            isolateExtraction = true;
+        } else if (arg == "--max-pages" && i + 1 < argc) {
+            extractionLimits.maxPages = static_cast<size_t>(std::max(0L, std::atol(argv[++i])));
+        } else if (arg == "--max-bytes" && i + 1 < argc) {
+            extractionLimits.maxBytes = static_cast<size_t>(std::max(0L, std::atol(argv[++i])));
+        } else if (arg == "--scoring" && i + 1 < argc) {
+            scoringModelName = argv[++i];
+        } else if (arg == "--list-duplicates") {
+            listDuplicates = true;
+        } else if (arg == "--keep-duplicates") {
+            collapseDuplicates = false;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchQueryPath = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            batchOutputPath = argv[++i];
+        } else if (arg == "--top" && i + 1 < argc) {
+            batchTopK = static_cast<size_t>(std::max(1L, std::atol(argv[++i])));
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serverOptions.socketPath = argv[++i];
+        } else if (arg == "--load-test" && i + 1 < argc) {
+            loadTestSocket = argv[++i];
+        } else if (arg == "--load-queries" && i + 1 < argc) {
+            loadTestQueryPath = argv[++i];
+        } else if (arg == "--clients" && i + 1 < argc) {
+            loadTestClients = static_cast<unsigned>(std::max(1L, std::atol(argv[++i])));
+        } else if (arg == "--requests" && i + 1 < argc) {
+            loadTestRequests = static_cast<size_t>(std::max(1L, std::atol(argv[++i])));
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (arg == "--slowest" && i + 1 < argc) {
+            slowestCount = static_cast<size_t>(std::max(0L, std::atol(argv[++i])));
+        } else if (arg == "--scholar-url" && i + 1 < argc) {
+            scholarUrl = argv[++i];
+        } else if (arg == "--scholar-pages" && i + 1 < argc) {
+            scholarPages = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            std::cerr << "[Error] Unknown argument: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    std::shared_ptr<const ScoringModel> scoringModel = makeScoringModel(scoringModelName);
+    if (!scoringModel) {
+        std::cerr << "[Error] Unknown scoring model: " << scoringModelName << std::endl;
+        return 1;
+    }
+
+    // Load test mode: a client of a running server, no corpus of its own
+    if (!loadTestSocket.empty()) {
+        std::vector<std::string> loadQueries;
+        if (!readQueryFile(loadTestQueryPath, loadQueries) || loadQueries.empty()) {
+            std::cerr << "[Error] --load-test needs topics from --load-queries FILE" << std::endl;
+            return 1;
+        }
+        LoadTestReport report = runLoadTest(loadTestSocket, loadQueries, loadTestClients, loadTestRequests);
+        std::cout << "[Load Test] " << report.latency.count << " requests from " << loadTestClients
+                  << " clients in " << std::fixed << std::setprecision(2) << report.seconds << " s ("
+                  << std::setprecision(0) << report.requestsPerSecond << " req/s), " << report.errors
+                  << " errors" << std::endl;
+        std::cout << "[Load Test] Latency: p50 " << std::setprecision(3) << report.latency.p50Ms << " ms, p99 "
+                  << report.latency.p99Ms << " ms, max " << report.latency.maxMs << " ms" << std::endl;
+        return report.errors == 0 ? 0 : 1;
+    }
+
+    ProfileSession profileSession;
+    if (profile || !tracePath.empty()) {
+        profileSession.profiler.reset(new Profiler(slowestCount, !tracePath.empty()));
+        profileSession.tracePath = tracePath;
+        Profiler::setActive(profileSession.profiler.get());
+    }
+
+    const bool batchMode = !batchQueryPath.empty();
+    const bool serveMode = !serverOptions.socketPath.empty();
+    serverOptions.topK = batchTopK;
+    if (batchMode && watchMode) {
+        std::cerr << "[Error] --batch and --watch cannot be combined." << std::endl;
+        return 1;
+    }
+    if (batchMode && serveMode) {
+        std::cerr << "[Error] --batch and --serve cannot be combined." << std::endl;
+        return 1;
+    }
+    std::vector<std::string> batchQueries;
+    if (batchMode && !readQueryFile(batchQueryPath, batchQueries)) {
+        std::cerr << "[Error] Could not read queries from " << batchQueryPath << std::endl;
+        return 1;
+    }
+    // Batch results going to stdout keep it to themselves: status lines move to stderr
+    std::streambuf* resultsBuffer = std::cout.rdbuf();
+    if (batchMode && batchOutputPath.empty()) std::cout.rdbuf(std::cerr.rdbuf());
     // ------------------------------------------------------------------
 
     std::cout << "\n--- Starting PDF Organizer Application ---\n";
-    std::cout << "Target Topic: '" << searchTopic << "'" << std::endl;
+    if (batchMode) {
+        std::cout << "Batch: " << batchQueries.size() << " topics from '" << batchQueryPath << "'" << std::endl;
+    } else {
+        std::cout << "Target Topic: '" << searchTopic << "'" << std::endl;
+    }
+    std::cout << "Scoring: " << scoringModel->name() << std::endl;
 
     // --- 2. Module A: Local File Search (File System Manager) ---
-    FileSystemManager fsManager;
-    std::vector<std::string> pdfPaths = fsManager.findPdfs(searchDirectory);
-    std::cout << "\n[Local Status] Found " << pdfPaths.size() << " potential PDF files in " << searchDirectory << std::endl;
+    // In watch mode, start watching before the walk so no change slips through in between
+    DirectoryWatcher watcher;
+    if (watchMode && !watcher.start(searchDirectory)) {
+        return 1;
+    }
+    FileSystemManager fsManager(crawlOptions);
 
     // --- 3. Module B & C: Local Processing and Scoring (PdfTextExtractor & RelevanceScorer) ---
     std::vector<DocumentScore> localResults;
-    CorpusMap documentCorpus; 
-    double maxScore = 0.0; // Raw maximum score found
-
-    if (!pdfPaths.empty()) {
-        PdfTextExtractor extractor;
-        std::cout << "[Local Status] Extracting text and building corpus..." << std::endl;
-        for (const auto& path : pdfPaths) {
-            std::string text = extractor.extractText(path);
-            if (!text.empty()) {
-                documentCorpus[path] = text;
-            }
+    size_t indexedDocuments = 0;
+
+    RelevanceScorer scorer(scoringModel);
+    TextCache textCache(textCacheDirectory, hashCachedContents);
+    ExtractionPipeline pipeline(extractionWorkers);
+    pipeline.setTextCache(&textCache);
+    pipeline.setMemoryBudget(extractionMemoryBudget);
+    pipeline.setExtractionLimits(extractionLimits);
+    std::unique_ptr<ExtractionSandbox> sandbox;
+    if (isolateExtraction) {
+        SandboxOptions sandboxOptions;
+        sandboxOptions.workers = pipeline.workerCount();
+        sandboxOptions.timeoutMs = extractionTimeoutMs;
+        sandboxOptions.memoryLimitBytes = extractionMemoryLimit;
+        sandboxOptions.quarantinePath = quarantineFilePath;
+#ifndef __linux__
+        sandboxOptions.executable = argv[0];
+#endif
+        sandbox.reset(new ExtractionSandbox(sandboxOptions));
+        pipeline.setSandbox(sandbox.get());
+    }
+    IncrementalIndexer indexer(scorer, pipeline);
+    indexer.setCrawlOptions(crawlOptions);
+    MappedIndex savedIndex;
+    const IndexReader* corpusIndex = nullptr;
+    bool indexFileCurrent = false; // The saved index file matches corpusIndex
+
+    // Fast path: a saved index built from exactly these (unchanged) files. Checking it takes the
+    // whole walk; without a saved index to check, the walk is streamed into extraction instead.
+    auto crawlStart = std::chrono::steady_clock::now();
+    const bool checkSavedIndex = !watchMode && savedIndex.open(indexFilePath);
+    std::vector<std::string> pdfPaths;
+    if (checkSavedIndex) {
+        pdfPaths = fsManager.findPdfs(searchDirectory);
+        double crawlMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - crawlStart).count();
+        std::cout << "\n[Local Status] Found " << pdfPaths.size() << " potential PDF files in " << searchDirectory
+                  << " (crawled in " << std::fixed << std::setprecision(1) << crawlMs << " ms)" << std::endl;
+    }
+
+    auto loadStart = std::chrono::steady_clock::now();
+    if (checkSavedIndex && !pdfPaths.empty() && savedIndex.isUpToDate(pdfPaths)) {
+        auto loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+        std::cout << "[Local Status] Loaded saved index " << indexFilePath << " ("
+                  << savedIndex.documentCount() << " documents, " << savedIndex.termCount()
+                  << " terms) in " << std::fixed << std::setprecision(1) << loadMs << " ms." << std::endl;
+        corpusIndex = &savedIndex;
+        indexFileCurrent = true;
+    } else if (!checkSavedIndex || !pdfPaths.empty()) {
+        savedIndex.close();
+
+        // Startup reconcile: only files that are new or changed since the saved
+        // state are extracted; the rest keep their postings
+        bool loaded = indexer.load(indexFilePath);
+        std::cout << (checkSavedIndex ? "" : "\n") << "[Local Status] "
+                  << (loaded ? "Reconciling saved index" : "Building index")
+                  << " with " << pipeline.workerCount() << " extraction worker(s)..." << std::endl;
+        ReconcileStats stats;
+        if (checkSavedIndex) {
+            stats = indexer.reconcile(pdfPaths);
+        } else {
+            // Extraction starts on the first PDFs found while the crawl goes on
+            stats = indexer.rescan(searchDirectory);
+            double crawlMs =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - crawlStart).count();
+            std::cout << "[Local Status] Found " << stats.added + stats.updated + stats.unchanged
+                      << " potential PDF files in " << searchDirectory << " (crawled and extracted in " << std::fixed
+                      << std::setprecision(1) << crawlMs << " ms)" << std::endl;
         }
-        std::cout << "[Local Status] Corpus built from " << documentCorpus.size() << " usable documents." << std::endl;
-        
-        if (!documentCorpus.empty()) {
-            RelevanceScorer scorer;
-            localResults = scorer.scoreDocuments(documentCorpus, searchTopic);
-            
-            // Determine raw max score for normalization
-            if (!localResults.empty() && localResults[0].score > 0.0) {
-                maxScore = localResults[0].score;
+        std::cout << "[Local Status] Reconcile: ";
+        printReconcileStats(stats);
+        std::cout << "." << std::endl;
+
+        size_t pruned = textCache.prune();
+        std::cout << "[Local Status] Text cache: " << textCache.hits() << " hits, " << textCache.misses()
+                  << " misses, " << textCache.evictions() << " stale entries evicted"
+                  << (pruned ? " (prune removed " + std::to_string(pruned) + " files)" : "") << "." << std::endl;
+
+        if (sandbox) {
+            std::cout << "[Local Status] Sandbox: " << sandbox->workerCount() << " worker(s), "
+                      << sandbox->timeouts() << " timeouts, " << sandbox->crashes() << " crashes, "
+                      << sandbox->skipped() << " quarantined files skipped." << std::endl;
+        }
+
+        const InvertedIndex& index = indexer.index();
+        std::cout << "[Local Status] Corpus has " << index.documentCount() << " usable documents, "
+                  << index.termCount() << " distinct terms." << std::endl;
+        indexFileCurrent = loaded && !stats.changed();
+        if ((stats.changed() || !loaded) && indexer.save(indexFilePath)) {
+            std::cout << "[Local Status] Saved index to " << indexFilePath << std::endl;
+            indexFileCurrent = true;
+        }
+        // Like an empty walk, an empty tree leaves no corpus to search unless it is watched
+        if (watchMode || !index.filePaths().empty()) corpusIndex = &index;
+    }
+
+    NearDuplicates duplicates;
+    if (corpusIndex && (collapseDuplicates || listDuplicates)) {
+        reportNearDuplicates(duplicates, *corpusIndex, listDuplicates);
+        if (collapseDuplicates) scorer.setNearDuplicates(&duplicates);
+    }
+
+    // --- Server Mode: answer topics from the warm index until stopped ---
+    if (serveMode) {
+        QueryServer server(serverOptions);
+        uint64_t generation = 1;
+        server.publish(makeSnapshot(servedIndex(indexFilePath, indexFileCurrent && corpusIndex, indexer.index()),
+                                    scorer, collapseDuplicates, generation));
+        if (!server.start()) return 1;
+        activeServer = &server;
+        std::signal(SIGINT, stopServer);
+        std::signal(SIGTERM, stopServer);
+        std::cout << "[Server] Listening on " << serverOptions.socketPath << " with " << server.threadCount()
+                  << " handler thread(s); Ctrl+C to stop." << std::endl;
+
+        // Refreshes are indexed here and published as a new snapshot; queries never wait for them
+        while (watchMode && server.running()) {
+            std::vector<WatchEvent> events = watcher.waitForChanges(500);
+            if (events.empty()) continue;
+            ReconcileStats stats = indexer.apply(events, searchDirectory);
+            if (!stats.changed()) continue;
+            indexFileCurrent = indexer.save(indexFilePath);
+            server.publish(makeSnapshot(servedIndex(indexFilePath, indexFileCurrent, indexer.index()), scorer,
+                                        collapseDuplicates, ++generation));
+            std::cout << "[Server] ";
+            printReconcileStats(stats);
+            std::cout << "; serving generation " << generation << " (" << indexer.index().documentCount()
+                      << " documents)." << std::endl;
+        }
+        server.wait();
+        activeServer = nullptr;
+
+        LatencyStats latency = server.latency();
+        std::cout << "\n[Server] Stopped. Last " << latency.count << " requests: p50 " << std::fixed
+                  << std::setprecision(3) << latency.p50Ms << " ms, p99 " << latency.p99Ms << " ms." << std::endl;
+        std::cout.rdbuf(resultsBuffer);
+        return 0;
+    }
+
+    // --- Batch Mode: every topic against the corpus loaded once, then exit ---
+    if (batchMode) {
+        InvertedIndex emptyIndex;
+        BatchQueryRunner runner(scorer, batchThreads);
+        auto batchStart = std::chrono::steady_clock::now();
+        std::vector<BatchQueryResult> batchResults =
+            runner.run(corpusIndex ? *corpusIndex : emptyIndex, batchQueries, batchTopK);
+        auto batchMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batchStart).count();
+
+        std::ofstream outputFile;
+        std::ostream resultsOut(resultsBuffer);
+        if (!batchOutputPath.empty()) {
+            outputFile.open(batchOutputPath, std::ios::trunc);
+            if (!outputFile) {
+                std::cerr << "[Error] Could not write " << batchOutputPath << std::endl;
+                std::cout.rdbuf(resultsBuffer);
+                return 1;
             }
+            resultsOut.rdbuf(outputFile.rdbuf());
         }
+        writeJsonLines(resultsOut, batchResults);
+
+        std::cout << "[Batch] Scored " << batchResults.size() << " topics in " << std::fixed << std::setprecision(1)
+                  << batchMs << " ms on " << runner.threadCount() << " thread(s) ("
+                  << std::setprecision(3) << (batchResults.empty() ? 0.0 : batchMs / batchResults.size())
+                  << " ms per topic)." << std::endl;
+        std::cout.rdbuf(resultsBuffer);
+        return 0;
+    }
+
+    if (corpusIndex) {
+        // Copies do not make the corpus any larger
+        indexedDocuments = corpusIndex->documentCount() - (collapseDuplicates ? duplicates.duplicateCount() : 0);
+        localResults = scorer.topDocuments(*corpusIndex, searchTopic, LOCAL_RESULT_COUNT);
     }
     
     // --- 4. Fallback Condition Check (Quantity OR Absolute Quality) ---
     
     // Absolute Threshold: The raw score of the top document must be above this value to be considered truly relevant.
-    const double MIN_ABSOLUTE_SCORE_THRESHOLD = 0.500000; 
+    // This is the tf-idf scale, whose scores have no upper bound.
+    const double MIN_ABSOLUTE_SCORE_THRESHOLD = 0.500000;
+    // BM25 scores grow with the number and rarity of the query terms, so for those models the threshold is
+    // this share of the query's score ceiling (RelevanceScorer::scoreCeiling), i.e. an idf-weighted average
+    // of each term's tf / (tf + K). At average document length K = k1 = 1.2, and 0.7 is reached at tf ~ 2.8:
+    // every query term about three times in an average-length document, more in longer ones. On the
+    // synthetic corpus, documents written about a topic score 0.93-0.95 of the ceiling and the best
+    // chance co-occurrence of three random vocabulary words 0.55-0.61.
+    const double MIN_CEILING_SHARE = 0.7;
+    double scoreCeiling = corpusIndex ? scorer.scoreCeiling(*corpusIndex, searchTopic) : HUGE_VAL;
+    const double scoreThreshold =
+        std::isfinite(scoreCeiling) ? MIN_CEILING_SHARE * scoreCeiling : MIN_ABSOLUTE_SCORE_THRESHOLD;
     
     double topScoreRaw = localResults.empty() ? 0.0 : localResults[0].score;
 
     // Fallback is required if:
     // 1. Too few documents found (less than 5), OR
     // 2. The most relevant document's raw score is still below the absolute quality threshold.
-    bool fallbackNeeded = localResults.size() < 5 || topScoreRaw < MIN_ABSOLUTE_SCORE_THRESHOLD;
+    bool fallbackNeeded = indexedDocuments < 5 || topScoreRaw < scoreThreshold;
     
     // --- DEBUGGING LOG ---
     std::cout << "[DEBUG] Top document raw score: " << std::fixed << std::setprecision(6) << topScoreRaw << std::endl;
-    std::cout << "[DEBUG] Absolute threshold: " << std::fixed << std::setprecision(6) << MIN_ABSOLUTE_SCORE_THRESHOLD << std::endl;
+    std::cout << "[DEBUG] Score threshold: " << std::fixed << std::setprecision(6) << scoreThreshold << std::endl;
     std::cout << "[DEBUG] Fallback needed: " << (fallbackNeeded ? "YES" : "NO") << std::endl;
     // ---------------------
 
@@ -82,9 +568,12 @@ int main() {
         std::cout << "\n[Next Step] Local search failed the quality check.\n";
         
         std::cout << "\n--- Initiating Google Scholar Search Fallback ---" << std::endl;
-        ScholarSearch scholar;
+        ScholarCache scholarCache(scholarCacheDirectory, scholarCacheTtlSeconds);
+        ScholarSearch scholar(scholarUrl);
+        scholar.setCache(&scholarCache);
         // Search using the clean topic
-        std::vector<ScholarResult> onlineResults = scholar.search(searchTopic);
+        std::vector<ScholarResult> onlineResults =
+            scholarPages > 1 ? scholar.search(searchTopic, scholarPages) : scholar.search(searchTopic);
 
         // --- 6. Report Online Results ---
         std::cout << "\n--- Online Search Results (Google Scholar) ---" << std::endl;
@@ -106,24 +595,30 @@ int main() {
         // --- Display Local Results (Only if Fallback NOT Needed) ---
         std::cout << "\n[Next Step] Local search yielded sufficient, high-relevance results. Skipping online fallback." << std::endl;
         
-        std::cout << "\n--- Local Search Results (TF-IDF Ranked) ---" << std::endl;
+        std::cout << "\n--- Local Search Results (" << scoringModel->name() << " ranked) ---" << std::endl;
         
-        std::cout << "Top 5 Most Relevant Local Documents (Score indicates relevance):" << std::endl;
-        int rank = 1;
-
-        for (const auto& res : localResults) {
-            if (rank > 5 || res.score <= 0.0) break;
-            // Normalize score for display using the determined maxScore
-            double displayScore = (res.score / maxScore) * 100.0;
-            
-            // Extract only the filename from the full path for cleaner display
-            std::string full_path = res.filePath;
-            size_t last_slash = full_path.find_last_of("/\\");
-            std::string display_path = (last_slash == std::string::npos) ? 
-                                       full_path : full_path.substr(last_slash + 1);
-
-            std::cout << rank++ << ". [" << std::fixed << std::setprecision(2) 
-                      << displayScore << "%] - " << display_path << std::endl;
+        printLocalResults(localResults);
+    }
+
+    // --- 7. Watch Mode: apply changes as they happen ---
+    if (watchMode) {
+        std::cout << "\n--- Watching " << searchDirectory << " for changes (Ctrl+C to stop) ---" << std::endl;
+        while (true) {
+            std::vector<WatchEvent> events = watcher.waitForChanges(-1);
+            if (events.empty()) continue;
+
+            ReconcileStats stats = indexer.apply(events, searchDirectory);
+            if (!stats.changed()) continue;
+
+            std::cout << "\n[Watch] ";
+            printReconcileStats(stats);
+            std::cout << "; corpus now has " << indexer.index().documentCount() << " documents." << std::endl;
+            indexer.save(indexFilePath);
+            if (collapseDuplicates && !duplicates.builtFrom(indexer.index())) {
+                reportNearDuplicates(duplicates, indexer.index(), false);
+            }
+
+            printLocalResults(scorer.topDocuments(indexer.index(), searchTopic, LOCAL_RESULT_COUNT));
         }
     }
 
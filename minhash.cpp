@@ -0,0 +1,87 @@
+#include "minhash.h"
+
+#include <algorithm>
+
+namespace {
+
+const uint64_t FNV_OFFSET = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+// Final avalanche, so nearby shingle hashes land far apart
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    return x ^ (x >> 33);
+}
+
+// Bins are picked by the top bits of a shingle hash
+const unsigned BIN_BITS = 7;
+static_assert(MINHASH_SIZE == size_t(1) << BIN_BITS, "one bin per signature slot");
+const uint32_t EMPTY_BIN = UINT32_MAX;
+
+// Fills every empty bin from the first non-empty bin on its own fixed probe
+// sequence ("optimal densification"), so sparse signatures still agree slot
+// by slot with probability equal to the similarity.
+void densify(MinHashSignature& signature) {
+    const MinHashSignature bins = signature;
+    bool anyFilled = false;
+    for (uint32_t value : bins.values) anyFilled = anyFilled || value != EMPTY_BIN;
+    if (!anyFilled) return;
+    for (uint64_t bin = 0; bin < MINHASH_SIZE; ++bin) {
+        if (bins.values[bin] != EMPTY_BIN) continue;
+        for (uint64_t attempt = 1;; ++attempt) {
+            const size_t donor = mix64((bin << 32) | attempt) >> (64 - BIN_BITS);
+            if (bins.values[donor] != EMPTY_BIN) {
+                signature.values[bin] = bins.values[donor];
+                break;
+            }
+        }
+    }
+}
+
+} // namespace
+
+double estimatedSimilarity(const MinHashSignature& a, const MinHashSignature& b) {
+    size_t agree = 0;
+    for (size_t i = 0; i < MINHASH_SIZE; ++i) agree += a.values[i] == b.values[i];
+    return (double)agree / MINHASH_SIZE;
+}
+
+void MinHasher::reset() {
+    std::fill(window_, window_ + SHINGLE_SIZE, 0);
+    tokens_ = 0;
+    std::fill(signature_.values, signature_.values + MINHASH_SIZE, EMPTY_BIN);
+}
+
+void MinHasher::add(std::string_view token) {
+    uint64_t hash = FNV_OFFSET;
+    for (char c : token) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= FNV_PRIME;
+    }
+    std::copy(window_ + 1, window_ + SHINGLE_SIZE, window_);
+    window_[SHINGLE_SIZE - 1] = hash;
+    if (++tokens_ >= SHINGLE_SIZE) addShingle(shingleHash(SHINGLE_SIZE), signature_);
+}
+
+MinHashSignature MinHasher::signature() const {
+    MinHashSignature signature = signature_;
+    if (tokens_ > 0 && tokens_ < SHINGLE_SIZE) addShingle(shingleHash(tokens_), signature);
+    densify(signature);
+    return signature;
+}
+
+uint64_t MinHasher::shingleHash(size_t tokens) const {
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = SHINGLE_SIZE - tokens; i < SHINGLE_SIZE; ++i) {
+        hash = (hash ^ window_[i]) * FNV_PRIME;
+    }
+    return mix64(hash);
+}
+
+void MinHasher::addShingle(uint64_t hash, MinHashSignature& signature) {
+    uint32_t& bin = signature.values[hash >> (64 - BIN_BITS)];
+    bin = std::min(bin, static_cast<uint32_t>(hash));
+}
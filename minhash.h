@@ -0,0 +1,53 @@
+#pragma once
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// Number of hash functions in a signature.
+const size_t MINHASH_SIZE = 128;
+
+// MinHash signature of a document's set of token shingles. Two signatures
+// agree in a given slot with probability equal to the Jaccard similarity of
+// the two shingle sets.
+struct MinHashSignature {
+    uint32_t values[MINHASH_SIZE];
+};
+
+// Fraction of slots in which `a` and `b` agree: an estimate of their Jaccard similarity.
+double estimatedSimilarity(const MinHashSignature& a, const MinHashSignature& b);
+
+/**
+ * @brief Builds a MinHash signature from a stream of tokens.
+ *
+ * Shingles are runs of SHINGLE_SIZE consecutive tokens, so reordered or
+ * reworded passages count as different while the same text under another
+ * file name, header or page break still matches. Rather than MINHASH_SIZE
+ * hash functions per shingle, one-permutation hashing splits a single hash
+ * into a bin (one signature slot) and a value kept if it is the bin's
+ * minimum, so a token costs a few multiplies whatever the signature size.
+ *
+ * The hashing is fixed: signatures are saved with the index, so any change
+ * to it needs an INDEX_FILE_VERSION bump.
+ */
+class MinHasher {
+public:
+    static constexpr size_t SHINGLE_SIZE = 3;
+
+    MinHasher() { reset(); }
+
+    // Starts a new document.
+    void reset();
+    void add(std::string_view token);
+
+    // Signature of the tokens added since reset(). A document shorter than a
+    // shingle is one shingle of all its tokens; one without tokens matches nothing.
+    MinHashSignature signature() const;
+
+private:
+    uint64_t shingleHash(size_t tokens) const;
+    static void addShingle(uint64_t hash, MinHashSignature& signature);
+
+    uint64_t window_[SHINGLE_SIZE]; // Last token hashes, oldest first
+    size_t tokens_ = 0;
+    MinHashSignature signature_;
+};
@@ -0,0 +1,93 @@
+#include "near_duplicates.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+// Hash of one band of a signature; the band number is mixed in so equal rows in different bands differ
+uint64_t bandKey(const MinHashSignature& signature, size_t band) {
+    uint64_t key = 14695981039346656037ull ^ band;
+    const uint32_t* rows = signature.values + band * NearDuplicates::ROWS;
+    for (size_t i = 0; i < NearDuplicates::ROWS; ++i) {
+        key = (key ^ rows[i]) * 1099511628211ull;
+        key ^= key >> 29;
+    }
+    return key;
+}
+
+} // namespace
+
+void NearDuplicates::build(const IndexReader& index, double threshold) {
+    ProfileScope scope("near-duplicates");
+    const uint32_t docCount = static_cast<uint32_t>(index.documentCount());
+    const MinHashSignature* signatures = index.documentSignatures();
+    const DocumentStats* stats = index.documentStats();
+    generation_ = index.generation();
+    representatives_.resize(docCount);
+    duplicates_.assign(docCount, std::vector<uint32_t>());
+    clusters_.clear();
+    duplicateCount_ = 0;
+
+    // 1. Union every pair that shares a band and passes the similarity check
+    std::vector<uint32_t> parent(docCount);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](uint32_t docId) {
+        while (parent[docId] != docId) {
+            parent[docId] = parent[parent[docId]];
+            docId = parent[docId];
+        }
+        return docId;
+    };
+    std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+    buckets.reserve(static_cast<size_t>(docCount) * BANDS);
+    for (uint32_t docId = 0; docId < docCount; ++docId) {
+        if (stats[docId].length == 0) continue; // An empty signature would match every other empty one
+        for (size_t band = 0; band < BANDS; ++band) {
+            std::vector<uint32_t>& bucket = buckets[bandKey(signatures[docId], band)];
+            for (uint32_t other : bucket) {
+                const uint32_t a = find(docId), b = find(other);
+                if (a == b) continue;
+                if (estimatedSimilarity(signatures[docId], signatures[other]) >= threshold) {
+                    parent[std::max(a, b)] = std::min(a, b);
+                }
+            }
+            bucket.push_back(docId);
+        }
+    }
+
+    // 2. The longest member represents its cluster
+    auto represents = [&](uint32_t a, uint32_t b) {
+        if (stats[a].length != stats[b].length) return stats[a].length > stats[b].length;
+        return index.documentPath(a) < index.documentPath(b);
+    };
+    std::vector<uint32_t> best(docCount);
+    std::iota(best.begin(), best.end(), 0);
+    for (uint32_t docId = 0; docId < docCount; ++docId) {
+        const uint32_t root = find(docId);
+        if (represents(docId, best[root])) best[root] = docId;
+    }
+    for (uint32_t docId = 0; docId < docCount; ++docId) {
+        const uint32_t representative = best[find(docId)];
+        representatives_[docId] = representative;
+        if (representative == docId) continue;
+        if (duplicates_[representative].empty()) clusters_.push_back(representative);
+        duplicates_[representative].push_back(docId);
+        duplicateCount_++;
+    }
+
+    auto byPath = [&](uint32_t a, uint32_t b) { return index.documentPath(a) < index.documentPath(b); };
+    for (uint32_t representative : clusters_) {
+        std::sort(duplicates_[representative].begin(), duplicates_[representative].end(), byPath);
+    }
+    std::sort(clusters_.begin(), clusters_.end(), [&](uint32_t a, uint32_t b) {
+        if (duplicates_[a].size() != duplicates_[b].size()) return duplicates_[a].size() > duplicates_[b].size();
+        return byPath(a, b);
+    });
+}
+
+const std::vector<uint32_t>& NearDuplicates::duplicatesOf(uint32_t docId) const {
+    return duplicates_[docId];
+}
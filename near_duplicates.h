@@ -0,0 +1,53 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "index_reader.h"
+
+/**
+ * @brief Clusters of near-duplicate documents (renamed downloads, arXiv and
+ * publisher versions of one paper) found from the index's MinHash signatures.
+ *
+ * Candidates come from LSH banding: a signature is cut into BANDS bands of
+ * ROWS slots and two documents are compared only if some band matches
+ * exactly, so a document meets its likely duplicates through a few hash
+ * lookups instead of a pass over the corpus. A candidate pair joins a
+ * cluster once its estimated similarity reaches the threshold. With 32 bands
+ * of 4 rows, pairs at 0.7 similarity become candidates over 99.9% of the
+ * time and unrelated ones (below 0.1) almost never.
+ *
+ * Each cluster is represented by its longest document (ties by path); the
+ * other members are its duplicates.
+ */
+class NearDuplicates {
+public:
+    static constexpr size_t BANDS = 32;
+    static constexpr size_t ROWS = MINHASH_SIZE / BANDS;
+    static constexpr double DEFAULT_THRESHOLD = 0.7;
+
+    // Clusters the documents of `index`; replaces any earlier result.
+    void build(const IndexReader& index, double threshold = DEFAULT_THRESHOLD);
+
+    // True if these clusters were built from `index` as it is now.
+    bool builtFrom(const IndexReader& index) const { return index.generation() == generation_; }
+
+    uint32_t representative(uint32_t docId) const { return representatives_[docId]; }
+    bool isRepresentative(uint32_t docId) const { return representatives_[docId] == docId; }
+
+    // Other members of the cluster `docId` represents; empty for a document without duplicates.
+    const std::vector<uint32_t>& duplicatesOf(uint32_t docId) const;
+
+    // Every representative with duplicates, longest cluster first (ties by path).
+    const std::vector<uint32_t>& clusters() const { return clusters_; }
+    // Documents collapsed into another one.
+    size_t duplicateCount() const { return duplicateCount_; }
+
+private:
+    uint64_t generation_ = 0;                        // IndexReader::generation() at build time; 0 = never built
+    std::vector<uint32_t> representatives_;          // By doc id
+    std::vector<std::vector<uint32_t>> duplicates_;  // By doc id, filled for representatives only
+    std::vector<uint32_t> clusters_;
+    size_t duplicateCount_ = 0;
+};
@@ -1,32 +1,175 @@
 #include "pdf_extractor.h"
+#include "text_cache.h"
+#include "extraction_sandbox.h"
+#include "profiler.h"
 #include <poppler/cpp/poppler-document.h>
 #include <poppler/cpp/poppler-page.h>
 
 #include <iostream>
 #include <string>
+#include <memory>
+
+namespace {
+
+inline bool isSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Passes `chunk` on, cut so that at most `maxBytes` bytes are emitted in total.
+// A cut backs off to the last whitespace so no token is split. Returns false
+// once the extraction has to stop, either at the limit or at the consumer's request.
+bool emitLimited(std::string&& chunk, TextField field, size_t maxBytes, size_t& emitted, bool& truncated,
+                 const PdfTextExtractor::ChunkConsumer& consumer) {
+    if (maxBytes > 0 && emitted + chunk.size() > maxBytes) {
+        size_t cut = maxBytes - emitted;
+        while (cut > 0 && !isSpace(chunk[cut - 1])) --cut;
+        chunk.resize(cut);
+        truncated = true;
+    }
+    emitted += chunk.size();
+    if (!chunk.empty() && !consumer(std::move(chunk), field)) return false;
+    return !truncated;
+}
+
+} // namespace
 
 std::string PdfTextExtractor::extractText(const std::string& pdfPath) const {
-    std::string fullText;
+    std::string text;
+    extractChunks(pdfPath, [&](std::string&& chunk, TextField field) {
+        if (field == FIELD_TITLE) return true;
+        if (text.empty()) {
+            text = std::move(chunk);
+        } else {
+            text += chunk;
+        }
+        return true;
+    });
+    return text;
+}
+
+bool PdfTextExtractor::extractChunks(const std::string& pdfPath, const ChunkConsumer& consumer) const {
+    ProfileScope scope("extract");
+    bool truncated = false;
+    // A page cap needs the page boundaries, which the cache does not keep
+    if (!cache_ || limits_.maxPages > 0) return extractPages(pdfPath, consumer, truncated);
+
+    // Serve unchanged files straight from the cache without touching poppler
+    FileIdentity identity;
+    bool identified = cache_->identify(pdfPath, identity);
+    std::string text;
+    CachedLayout layout;
+    bool cached = identified && cache_->lookup(identity, text, &layout);
+    profileCacheLookup("text cache", cached);
+    if (cached) {
+        // Hand the fields back as they were stored
+        size_t emitted = 0;
+        const size_t firstPageEnd = layout.titleBytes + layout.firstPageBytes;
+        if (layout.titleBytes > 0 &&
+            !emitLimited(text.substr(0, layout.titleBytes), FIELD_TITLE, limits_.maxBytes, emitted, truncated, consumer)) {
+            return true;
+        }
+        if (layout.firstPageBytes > 0 &&
+            !emitLimited(text.substr(layout.titleBytes, layout.firstPageBytes), FIELD_FIRST_PAGE, limits_.maxBytes,
+                         emitted, truncated, consumer)) {
+            return true;
+        }
+        if (firstPageEnd == 0) {
+            emitLimited(std::move(text), FIELD_BODY, limits_.maxBytes, emitted, truncated, consumer);
+        } else if (firstPageEnd < text.size()) {
+            emitLimited(text.substr(firstPageEnd), FIELD_BODY, limits_.maxBytes, emitted, truncated, consumer);
+        }
+        return true;
+    }
+    if (!identified) return extractPages(pdfPath, consumer, truncated);
+
+    // Compress pages into the cache as they go by. The entry is stored under the
+    // identity taken before extraction, so a file modified mid-extraction is
+    // re-extracted next time instead of served stale.
+    std::unique_ptr<TextCache::EntryWriter> writer = cache_->beginStore(identity);
+    size_t written = 0;
+    bool stopped = false;
+    bool opened = extractPages(pdfPath, [&](std::string&& chunk, TextField field) {
+        if (writer) writer->append(chunk.data(), chunk.size(), field);
+        written += chunk.size();
+        stopped = !consumer(std::move(chunk), field);
+        return !stopped;
+    }, truncated);
+
+    // Only complete texts are worth caching
+    if (writer && opened && !truncated && !stopped && written > 0) writer->commit();
+    return opened;
+}
+
+bool PdfTextExtractor::extractPages(const std::string& pdfPath, const ChunkConsumer& consumer,
+                                    bool& truncated) const {
+    // Counted here rather than in extractWithPoppler so sandboxed extractions count too.
+    // The time includes the consumer's, e.g. compressing pages into the cache.
+    ProfileScope scope("poppler", &pdfPath);
+    if (!scope.active()) {
+        if (sandbox_) return sandbox_->extract(pdfPath, limits_, consumer, truncated);
+        return extractWithPoppler(pdfPath, consumer, truncated);
+    }
+    ChunkConsumer counted = [&](std::string&& chunk, TextField field) {
+        scope.addBytes(chunk.size());
+        if (field != FIELD_TITLE) scope.addPages(1);
+        return consumer(std::move(chunk), field);
+    };
+    if (sandbox_) return sandbox_->extract(pdfPath, limits_, counted, truncated);
+    return extractWithPoppler(pdfPath, counted, truncated);
+}
+
+bool PdfTextExtractor::extractWithPoppler(const std::string& pdfPath, const ChunkConsumer& consumer,
+                                          bool& truncated) const {
+    truncated = false;
 
     // Load document
     std::unique_ptr<poppler::document> doc(poppler::document::load_from_file(pdfPath));
     if (!doc) {
         std::cerr << "Error: Could not open PDF: " << pdfPath << "\n";
-        return "";
+        return false;
+    }
+
+    // Metadata first, as one piece of its own field
+    size_t emitted = 0;
+    std::string metadata;
+    for (const char* key : {"Title", "Subject", "Keywords"}) {
+        auto value = doc->info_key(key).to_utf8();
+        if (value.empty()) continue;
+        metadata.append(value.data(), value.size());
+        metadata += "\n";
+    }
+    if (!metadata.empty()) {
+        metadata += "\n";
+        if (!emitLimited(std::move(metadata), FIELD_TITLE, limits_.maxBytes, emitted, truncated, consumer)) {
+            return true;
+        }
     }
 
     int numPages = doc->pages();
+    bool firstPage = true;
+    std::string chunk;
     for (int i = 0; i < numPages; ++i) {
+        if (limits_.maxPages > 0 && static_cast<size_t>(i) >= limits_.maxPages) {
+            truncated = true;
+            break;
+        }
 
         std::unique_ptr<poppler::page> page(doc->create_page(i));
         if (!page) continue;
 
-        // Extract text (Poppler 25 returns std::vector<char>)
+        // Extract text (Poppler 25 returns std::vector<char>), copied once into the chunk
         auto bytes = page->text().to_utf8();
-
-        std::string text(bytes.begin(), bytes.end());
-        fullText += text + "\n\n";
+        chunk.clear();
+        chunk.reserve(bytes.size() + 2);
+        chunk.append(bytes.data(), bytes.size());
+        chunk += "\n\n";
+        TextField field = firstPage ? FIELD_FIRST_PAGE : FIELD_BODY;
+        firstPage = false;
+        if (!emitLimited(std::move(chunk), field, limits_.maxBytes, emitted, truncated, consumer)) break;
     }
 
-    return fullText;
+    if (truncated) {
+        std::cerr << "[Extraction] " << pdfPath << ": truncated at " << emitted << " bytes" << std::endl;
+    }
+    return true;
 }
@@ -1,7 +1,59 @@
 #pragma once
 #include <string>
+#include <functional>
+#include <cstddef>
+
+#include "index_reader.h"
+
+class TextCache;
+class ExtractionSandbox;
+
+// Per-document caps on extraction (0 = unlimited).
+struct ExtractionLimits {
+    size_t maxPages = 0;
+    size_t maxBytes = 0; // Text bytes; the cut falls on whitespace so no token is split
+};
 
 class PdfTextExtractor {
 public:
+    /**
+     * @brief Receives a document's text in pieces, usually one per page, each
+     * tagged with its field: first the metadata (if the PDF has any), then the
+     * first page, then the body. Every piece ends on whitespace, so they can be
+     * tokenized independently. Return false to stop the extraction early.
+     * The chunk may be moved from or swapped for another buffer; the extractor
+     * reuses whatever it is left holding for its next piece.
+     */
+    using ChunkConsumer = std::function<bool(std::string&& chunk, TextField field)>;
+
+    // The document's page text, without the metadata.
     std::string extractText(const std::string& pdfPath) const;
+
+    /**
+     * @brief Streams the document's text to `consumer` without ever holding all of it.
+     * @return false if the document could not be opened.
+     */
+    bool extractChunks(const std::string& pdfPath, const ChunkConsumer& consumer) const;
+
+    // Optional persistent cache consulted before opening the PDF (not owned)
+    void setCache(const TextCache* cache) { cache_ = cache; }
+
+    // Optional worker processes that run poppler instead of this one (not owned)
+    void setSandbox(ExtractionSandbox* sandbox) { sandbox_ = sandbox; }
+
+    void setLimits(const ExtractionLimits& limits) { limits_ = limits; }
+    const ExtractionLimits& limits() const { return limits_; }
+
+private:
+    // The sandbox's workers call extractWithPoppler directly
+    friend class ExtractionSandbox;
+
+    // Runs poppler in the sandbox if there is one, in this process otherwise.
+    bool extractPages(const std::string& pdfPath, const ChunkConsumer& consumer, bool& truncated) const;
+    // Feeds poppler's pages to `consumer`; `truncated` tells whether a limit cut the text short.
+    bool extractWithPoppler(const std::string& pdfPath, const ChunkConsumer& consumer, bool& truncated) const;
+
+    const TextCache* cache_ = nullptr;
+    ExtractionSandbox* sandbox_ = nullptr;
+    ExtractionLimits limits_;
 };
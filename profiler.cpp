@@ -0,0 +1,220 @@
+#include "profiler.h"
+#include "batch_query.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <ostream>
+
+#include <unistd.h>
+
+std::atomic<Profiler*> Profiler::active_{nullptr};
+
+namespace {
+
+// Spans kept for the trace; later ones are counted and dropped
+const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+double threadCpuMs() {
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0.0;
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Small, stable thread numbers for the trace
+uint32_t threadNumber() {
+    static std::atomic<uint32_t> next{1};
+    thread_local uint32_t number = next.fetch_add(1);
+    return number;
+}
+
+bool slowerFirst(const SlowDocument& a, const SlowDocument& b) {
+    return a.wallMs > b.wallMs;
+}
+
+std::string formatCount(uint64_t value) {
+    return value == 0 ? "-" : std::to_string(value);
+}
+
+} // namespace
+
+// --- ProfileScope ---
+
+void ProfileScope::begin() {
+    start_ = std::chrono::steady_clock::now();
+    cpuStartMs_ = threadCpuMs();
+}
+
+void ProfileScope::end() {
+    double cpuMs = threadCpuMs() - cpuStartMs_;
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    profiler_->record(Profiler::Span{stage_, document_, start_, wallMs, cpuMs, bytes_, pages_, tokens_, items_});
+}
+
+// --- Profiler ---
+
+Profiler::Profiler(size_t slowestCount, bool collectTrace)
+    : slowestCount_(slowestCount), collectTrace_(collectTrace), origin_(std::chrono::steady_clock::now()) {}
+
+void Profiler::record(const Span& span) {
+    uint32_t thread = threadNumber();
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    auto stage = std::find_if(stages_.begin(), stages_.end(),
+                              [&](const std::pair<std::string, StageTotals>& entry) { return entry.first == span.stage; });
+    if (stage == stages_.end()) stage = stages_.emplace(stages_.end(), span.stage, StageTotals());
+    StageTotals& totals = stage->second;
+    totals.calls++;
+    totals.wallMs += span.wallMs;
+    totals.cpuMs += span.cpuMs;
+    totals.bytes += span.bytes;
+    totals.pages += span.pages;
+    totals.tokens += span.tokens;
+    totals.items += span.items;
+
+    if (span.document && slowestCount_ > 0) {
+        std::vector<SlowDocument>& heap = slowest_[span.stage];
+        if (heap.size() < slowestCount_ || span.wallMs > heap.front().wallMs) {
+            if (heap.size() == slowestCount_) {
+                std::pop_heap(heap.begin(), heap.end(), slowerFirst);
+                heap.pop_back();
+            }
+            heap.push_back(SlowDocument{*span.document, span.wallMs, span.bytes, span.pages});
+            std::push_heap(heap.begin(), heap.end(), slowerFirst);
+        }
+    }
+
+    if (collectTrace_) {
+        if (events_.size() == MAX_TRACE_EVENTS) {
+            droppedEvents_++;
+            return;
+        }
+        double startUs = std::chrono::duration<double, std::micro>(span.start - origin_).count();
+        events_.push_back(TraceEvent{span.stage, span.document ? *span.document : std::string(), startUs,
+                                     span.wallMs * 1e3, thread, span.bytes, span.pages, span.tokens, span.items});
+    }
+}
+
+void Profiler::count(const char* counter, uint64_t n) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    counters_[counter] += n;
+}
+
+void Profiler::recordCacheLookup(const char* cache, bool hit) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    CacheTotals& totals = caches_[cache];
+    (hit ? totals.hits : totals.misses)++;
+}
+
+std::vector<std::pair<std::string, StageTotals>> Profiler::stages() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return stages_;
+}
+
+std::vector<SlowDocument> Profiler::slowest(const std::string& stage) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = slowest_.find(stage);
+    if (it == slowest_.end()) return {};
+    std::vector<SlowDocument> documents = it->second;
+    std::sort(documents.begin(), documents.end(), slowerFirst);
+    return documents;
+}
+
+void Profiler::printSummary(std::ostream& out) const {
+    double runMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - origin_).count();
+    std::lock_guard<std::mutex> lock(mtx_);
+    char line[256];
+
+    std::snprintf(line, sizeof(line), "\n[Profile] %.1f ms in total. Stages include the stages they enclose; "
+                  "calls on parallel threads add up.\n", runMs);
+    out << line;
+    std::snprintf(line, sizeof(line), "  %-16s %8s %11s %11s %9s %8s %11s %8s %9s %9s\n", "Stage", "Calls",
+                  "Wall ms", "CPU ms", "MB", "Pages", "Tokens", "Items", "MB/s", "Mtok/s");
+    out << line;
+    for (const auto& entry : stages_) {
+        const StageTotals& t = entry.second;
+        double seconds = t.wallMs / 1e3;
+        char mb[32] = "-";
+        char mbPerSecond[32] = "-";
+        char mtokPerSecond[32] = "-";
+        if (t.bytes) std::snprintf(mb, sizeof(mb), "%.2f", t.bytes / 1e6);
+        if (t.bytes && seconds > 0) std::snprintf(mbPerSecond, sizeof(mbPerSecond), "%.1f", t.bytes / 1e6 / seconds);
+        if (t.tokens && seconds > 0) std::snprintf(mtokPerSecond, sizeof(mtokPerSecond), "%.2f", t.tokens / 1e6 / seconds);
+        std::snprintf(line, sizeof(line), "  %-16s %8llu %11.1f %11.1f %9s %8s %11s %8s %9s %9s\n",
+                      entry.first.c_str(), static_cast<unsigned long long>(t.calls), t.wallMs, t.cpuMs, mb,
+                      formatCount(t.pages).c_str(), formatCount(t.tokens).c_str(), formatCount(t.items).c_str(),
+                      mbPerSecond, mtokPerSecond);
+        out << line;
+    }
+
+    if (!caches_.empty()) {
+        std::snprintf(line, sizeof(line), "\n  %-16s %8s %8s %9s\n", "Cache", "Hits", "Misses", "Hit rate");
+        out << line;
+        for (const auto& entry : caches_) {
+            uint64_t lookups = entry.second.hits + entry.second.misses;
+            std::snprintf(line, sizeof(line), "  %-16s %8llu %8llu %8.1f%%\n", entry.first.c_str(),
+                          static_cast<unsigned long long>(entry.second.hits),
+                          static_cast<unsigned long long>(entry.second.misses),
+                          lookups ? 100.0 * entry.second.hits / lookups : 0.0);
+            out << line;
+        }
+    }
+    if (!counters_.empty()) {
+        out << "\n";
+        for (const auto& entry : counters_) {
+            std::snprintf(line, sizeof(line), "  %-28s %llu\n", entry.first.c_str(),
+                          static_cast<unsigned long long>(entry.second));
+            out << line;
+        }
+    }
+
+    for (const auto& entry : slowest_) {
+        std::vector<SlowDocument> documents = entry.second;
+        std::sort(documents.begin(), documents.end(), slowerFirst);
+        out << "\n  Slowest " << documents.size() << " in " << entry.first << ":\n";
+        for (const SlowDocument& document : documents) {
+            std::snprintf(line, sizeof(line), "  %10.1f ms %9.2f MB %6llu pages  ", document.wallMs,
+                          document.bytes / 1e6, static_cast<unsigned long long>(document.pages));
+            out << line << document.path << "\n";
+        }
+    }
+    if (droppedEvents_ > 0) out << "\n  (" << droppedEvents_ << " spans not kept for the trace)\n";
+    out.flush();
+}
+
+bool Profiler::writeTrace(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    std::lock_guard<std::mutex> lock(mtx_);
+    const long pid = static_cast<long>(getpid());
+    char number[64];
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (size_t i = 0; i < events_.size(); ++i) {
+        const TraceEvent& event = events_[i];
+        out << (i ? ",\n" : "") << "{\"name\":";
+        writeJsonString(out, event.stage);
+        std::snprintf(number, sizeof(number), "%.3f", event.startUs);
+        out << ",\"cat\":\"stage\",\"ph\":\"X\",\"ts\":" << number;
+        std::snprintf(number, sizeof(number), "%.3f", event.durationUs);
+        out << ",\"dur\":" << number << ",\"pid\":" << pid << ",\"tid\":" << event.thread << ",\"args\":{";
+        bool first = true;
+        auto arg = [&](const char* name, uint64_t value) {
+            if (value == 0) return;
+            out << (first ? "" : ",") << '"' << name << "\":" << value;
+            first = false;
+        };
+        arg("bytes", event.bytes);
+        arg("pages", event.pages);
+        arg("tokens", event.tokens);
+        arg("items", event.items);
+        if (!event.document.empty()) {
+            out << (first ? "" : ",") << "\"document\":";
+            writeJsonString(out, event.document);
+        }
+        out << "}}";
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <cstdint>
+#include <cstddef>
+
+// What one stage did over a run, summed over all its calls and threads.
+struct StageTotals {
+    uint64_t calls = 0;
+    double wallMs = 0.0;
+    double cpuMs = 0.0;   // CPU time of the calling threads
+    uint64_t bytes = 0;
+    uint64_t pages = 0;
+    uint64_t tokens = 0;
+    uint64_t items = 0;   // Stage-specific: files found, documents scored, pages fetched
+};
+
+struct SlowDocument {
+    std::string path;
+    double wallMs = 0.0;
+    uint64_t bytes = 0;
+    uint64_t pages = 0;
+};
+
+/**
+ * @brief Collects stage timings and counters from across the pipeline.
+ *
+ * Instrumented code never holds a Profiler: it opens a ProfileScope, which
+ * reports to the active profiler if there is one. With none installed (the
+ * default) a scope costs one atomic load and a few additions, so the
+ * instrumentation stays compiled in. Stages nest; each one's totals include
+ * the stages it encloses.
+ *
+ * Besides the per-stage totals, the profiler keeps the slowest documents of
+ * every stage that names them and, if asked to, every span as a Chrome
+ * trace event (chrome://tracing, Perfetto).
+ */
+class Profiler {
+public:
+    // @param slowestCount Documents kept per stage for the slowest-N lists.
+    // @param collectTrace Keep every span for writeTrace (memory grows with the run).
+    explicit Profiler(size_t slowestCount = 10, bool collectTrace = false);
+
+    // The profiler scopes report to, or null when profiling is off.
+    static Profiler* active() { return active_.load(std::memory_order_acquire); }
+    // Installs `profiler` (or null) for the whole process; it must outlive every scope opened under it.
+    static void setActive(Profiler* profiler) { active_.store(profiler, std::memory_order_release); }
+
+    // A finished span of `stage`, as reported by ProfileScope.
+    struct Span {
+        const char* stage;
+        const std::string* document; // May be null
+        std::chrono::steady_clock::time_point start;
+        double wallMs;
+        double cpuMs;
+        uint64_t bytes;
+        uint64_t pages;
+        uint64_t tokens;
+        uint64_t items;
+    };
+    void record(const Span& span);
+
+    void count(const char* counter, uint64_t n = 1);
+    void recordCacheLookup(const char* cache, bool hit);
+
+    // Stage totals in order of first appearance.
+    std::vector<std::pair<std::string, StageTotals>> stages() const;
+    // Slowest documents of `stage`, slowest first.
+    std::vector<SlowDocument> slowest(const std::string& stage) const;
+
+    // Table of stages, caches, counters and slowest documents.
+    void printSummary(std::ostream& out) const;
+    // Chrome trace-event JSON of every span collected. False if the file cannot be written.
+    bool writeTrace(const std::string& path) const;
+
+private:
+    struct CacheTotals {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+    struct TraceEvent {
+        const char* stage;
+        std::string document;
+        double startUs;
+        double durationUs;
+        uint32_t thread;
+        uint64_t bytes;
+        uint64_t pages;
+        uint64_t tokens;
+        uint64_t items;
+    };
+
+    static std::atomic<Profiler*> active_;
+
+    const size_t slowestCount_;
+    const bool collectTrace_;
+    const std::chrono::steady_clock::time_point origin_;
+
+    mutable std::mutex mtx_;
+    std::vector<std::pair<std::string, StageTotals>> stages_;
+    std::map<std::string, std::vector<SlowDocument>> slowest_; // Min-heaps on wallMs
+    std::map<std::string, CacheTotals> caches_;
+    std::map<std::string, uint64_t> counters_;
+    std::vector<TraceEvent> events_;
+    size_t droppedEvents_ = 0;
+};
+
+/**
+ * @brief Times one stage from construction to destruction (or finish()) and
+ * reports it to the active profiler, along with whatever was added to it.
+ * Does nothing at all when no profiler is active.
+ */
+class ProfileScope {
+public:
+    // `document` must outlive the scope.
+    explicit ProfileScope(const char* stage, const std::string* document = nullptr)
+        : profiler_(Profiler::active()), stage_(stage), document_(document) {
+        if (profiler_) begin();
+    }
+    ~ProfileScope() { finish(); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    bool active() const { return profiler_ != nullptr; }
+
+    void addBytes(uint64_t n) { bytes_ += n; }
+    void addPages(uint64_t n) { pages_ += n; }
+    void addTokens(uint64_t n) { tokens_ += n; }
+    void addItems(uint64_t n) { items_ += n; }
+
+    // Ends the span early; later calls (and the destructor) do nothing.
+    void finish() {
+        if (profiler_) end();
+        profiler_ = nullptr;
+    }
+
+private:
+    void begin();
+    void end();
+
+    Profiler* profiler_;
+    const char* stage_;
+    const std::string* document_;
+    std::chrono::steady_clock::time_point start_;
+    double cpuStartMs_ = 0.0;
+    uint64_t bytes_ = 0;
+    uint64_t pages_ = 0;
+    uint64_t tokens_ = 0;
+    uint64_t items_ = 0;
+};
+
+inline void profileCount(const char* counter, uint64_t n = 1) {
+    if (Profiler* profiler = Profiler::active()) profiler->count(counter, n);
+}
+
+inline void profileCacheLookup(const char* cache, bool hit) {
+    if (Profiler* profiler = Profiler::active()) profiler->recordCacheLookup(cache, hit);
+}
@@ -0,0 +1,469 @@
+#include "query_server.h"
+#include "batch_query.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t LATENCY_WINDOW = 64 * 1024;  // Requests kept for the percentiles
+const size_t MAX_REQUEST_BYTES = 64 * 1024;
+// Lines read ahead of the answers; a connection this far behind is not read until it catches up
+const size_t MAX_QUEUED_REQUESTS = 64;
+// A connection with nothing left to answer is closed after this long
+const long long IDLE_TIMEOUT_MS = 10 * 60 * 1000;
+const long SEND_TIMEOUT_SECONDS = 10;
+
+bool fillAddress(const std::string& path, sockaddr_un& address) {
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.data(), path.size());
+    return true;
+}
+
+void setCloseOnExec(int fd) {
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+int connectTo(const sockaddr_un& address) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    setCloseOnExec(fd);
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Takes the next complete line out of `buffer`, reading from `fd` as needed. False on EOF or error.
+bool readLine(int fd, std::string& buffer, std::string& line) {
+    char chunk[4096];
+    size_t newline;
+    while ((newline = buffer.find('\n')) == std::string::npos) {
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buffer.append(chunk, static_cast<size_t>(n));
+    }
+    line.assign(buffer, 0, newline);
+    buffer.erase(0, newline + 1);
+    return true;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+std::shared_ptr<const IndexSnapshot> makeSnapshot(std::unique_ptr<const IndexReader> index,
+                                                  const RelevanceScorer& scorer, bool collapseDuplicates,
+                                                  uint64_t generation) {
+    auto snapshot = std::make_shared<IndexSnapshot>();
+    snapshot->index = std::move(index);
+    snapshot->scorer = scorer;
+    snapshot->scorer.setNearDuplicates(nullptr);
+    snapshot->generation = generation;
+    if (collapseDuplicates) {
+        snapshot->duplicates.build(*snapshot->index);
+        snapshot->scorer.setNearDuplicates(&snapshot->duplicates);
+    }
+    return snapshot;
+}
+
+LatencyStats summarizeLatencies(std::vector<double>& samples) {
+    LatencyStats stats;
+    stats.count = samples.size();
+    if (samples.empty()) return stats;
+    std::sort(samples.begin(), samples.end());
+    // Nearest rank: the smallest sample at or above the given fraction of all samples
+    auto percentile = [&](double fraction) {
+        size_t rank = static_cast<size_t>(fraction * samples.size() + 0.999999);
+        return samples[std::min(std::max<size_t>(rank, 1), samples.size()) - 1];
+    };
+    stats.p50Ms = percentile(0.50);
+    stats.p99Ms = percentile(0.99);
+    stats.maxMs = samples.back();
+    return stats;
+}
+
+// --- QueryServer ---
+
+QueryServer::QueryServer(const ServerOptions& options) : options_(options) {
+    if (options_.threads == 0) {
+        options_.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+QueryServer::~QueryServer() {
+    requestStop();
+    wait();
+}
+
+bool QueryServer::start() {
+    sockaddr_un address;
+    if (!fillAddress(options_.socketPath, address)) {
+        std::cerr << "[Server Error] Invalid socket path: " << options_.socketPath << std::endl;
+        return false;
+    }
+
+    // A socket file left behind by a server that did not shut down cleanly is
+    // replaced; one that still answers belongs to a running server.
+    struct stat st;
+    if (::lstat(options_.socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = connectTo(address);
+        if (probe >= 0) {
+            ::close(probe);
+            std::cerr << "[Server Error] A server is already listening on " << options_.socketPath << std::endl;
+            return false;
+        }
+        ::unlink(options_.socketPath.c_str());
+    }
+
+    listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd_ < 0 || ::pipe(stopPipe_) != 0 || ::pipe(wakePipe_) != 0) {
+        std::cerr << "[Server Error] Could not create socket: " << std::strerror(errno) << std::endl;
+        if (listenFd_ >= 0) ::close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    setCloseOnExec(listenFd_);
+    setCloseOnExec(stopPipe_[0]);
+    setCloseOnExec(stopPipe_[1]);
+    for (int fd : wakePipe_) {
+        setCloseOnExec(fd);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    if (::bind(listenFd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd_, SOMAXCONN) != 0) {
+        std::cerr << "[Server Error] Could not listen on " << options_.socketPath << ": " << std::strerror(errno)
+                  << std::endl;
+        ::close(listenFd_);
+        listenFd_ = -1; // Not ours to unlink
+        return false;
+    }
+
+    // A client hanging up mid-response must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+    stopping_ = false;
+    handlers_.reserve(options_.threads);
+    for (unsigned i = 0; i < options_.threads; ++i) handlers_.emplace_back(&QueryServer::handlerLoop, this);
+    poller_ = std::thread(&QueryServer::pollLoop, this);
+    return true;
+}
+
+void QueryServer::requestStop() {
+    stopping_ = true;
+    if (stopPipe_[1] >= 0) {
+        char byte = 1;
+        ssize_t written = ::write(stopPipe_[1], &byte, 1);
+        (void)written;
+    }
+}
+
+void QueryServer::wait() {
+    if (poller_.joinable()) poller_.join();
+    for (auto& handler : handlers_) {
+        if (handler.joinable()) handler.join();
+    }
+    handlers_.clear();
+    for (const auto& connection : connections_) ::close(connection->fd);
+    connections_.clear();
+    ready_.clear();
+    if (listenFd_ >= 0) {
+        ::close(listenFd_);
+        ::unlink(options_.socketPath.c_str());
+        listenFd_ = -1;
+    }
+    for (int* pipeFds : {stopPipe_, wakePipe_}) {
+        for (int i = 0; i < 2; ++i) {
+            if (pipeFds[i] >= 0) ::close(pipeFds[i]);
+            pipeFds[i] = -1;
+        }
+    }
+}
+
+void QueryServer::publish(std::shared_ptr<const IndexSnapshot> snapshot) {
+    std::atomic_store(&snapshot_, std::move(snapshot));
+}
+
+std::shared_ptr<const IndexSnapshot> QueryServer::snapshot() const {
+    return std::atomic_load(&snapshot_);
+}
+
+void QueryServer::pollLoop() {
+    std::vector<pollfd> fds;
+    std::vector<std::shared_ptr<Connection>> polled; // Connection of fds[FIXED_FDS + i]
+    const size_t FIXED_FDS = 3;
+    while (true) {
+        // 1. Close connections that are done or idle for too long; poll those that can take more lines
+        const auto now = std::chrono::steady_clock::now();
+        int timeoutMs = -1;
+        fds.assign({{listenFd_, POLLIN, 0}, {stopPipe_[0], POLLIN, 0}, {wakePipe_[0], POLLIN, 0}});
+        polled.clear();
+        {
+            std::lock_guard<std::mutex> lock(queueMtx_);
+            for (size_t i = 0; i < connections_.size();) {
+                Connection& connection = *connections_[i];
+                const bool idle = !connection.busy && connection.requests.empty();
+                const auto idleMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    now - connection.lastActive).count();
+                if (idle && (connection.closing || idleMs >= IDLE_TIMEOUT_MS)) {
+                    if (!connection.farewell.empty()) {
+                        ::send(connection.fd, connection.farewell.data(), connection.farewell.size(), MSG_DONTWAIT);
+                    }
+                    ::close(connection.fd);
+                    connections_[i] = std::move(connections_.back());
+                    connections_.pop_back();
+                    continue;
+                }
+                if (idle) {
+                    const int remaining = static_cast<int>(IDLE_TIMEOUT_MS - idleMs);
+                    timeoutMs = timeoutMs < 0 ? remaining : std::min(timeoutMs, remaining);
+                }
+                if (!connection.closing && connection.requests.size() < MAX_QUEUED_REQUESTS) {
+                    fds.push_back({connection.fd, POLLIN, 0});
+                    polled.push_back(connections_[i]);
+                }
+                ++i;
+            }
+        }
+
+        if (::poll(fds.data(), fds.size(), timeoutMs) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents != 0) break;
+        if (fds[2].revents != 0) {
+            char drain[256];
+            while (::read(wakePipe_[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int client = ::accept(listenFd_, nullptr, nullptr);
+            if (client >= 0) {
+                setCloseOnExec(client);
+                // A client that stops reading its answers must not hold a handler for long
+                timeval sendTimeout{SEND_TIMEOUT_SECONDS, 0};
+                ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+                auto connection = std::make_shared<Connection>();
+                connection->fd = client;
+                connection->lastActive = std::chrono::steady_clock::now();
+                connections_.push_back(std::move(connection));
+            }
+        }
+        for (size_t i = 0; i < polled.size(); ++i) {
+            if (fds[FIXED_FDS + i].revents != 0) readFrom(polled[i]);
+        }
+    }
+
+    // Stopping: wake every idle handler
+    {
+        std::lock_guard<std::mutex> lock(queueMtx_);
+        stopping_ = true;
+    }
+    queueCv_.notify_all();
+}
+
+void QueryServer::readFrom(const std::shared_ptr<Connection>& connection) {
+    char chunk[4096];
+    ssize_t n = ::recv(connection->fd, chunk, sizeof(chunk), 0);
+    if (n < 0 && errno == EINTR) return;
+    const auto now = std::chrono::steady_clock::now();
+
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(queueMtx_);
+        connection->lastActive = now;
+        if (n <= 0) {
+            connection->closing = true; // Hung up; lines already queued are still answered
+            return;
+        }
+        std::string& buffer = connection->buffer;
+        buffer.append(chunk, static_cast<size_t>(n));
+        size_t begin = 0, newline;
+        while ((newline = buffer.find('\n', begin)) != std::string::npos) {
+            std::string line = buffer.substr(begin, newline - begin);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            connection->requests.push_back(Request{std::move(line), now});
+            begin = newline + 1;
+        }
+        buffer.erase(0, begin);
+        if (buffer.size() > MAX_REQUEST_BYTES) {
+            connection->closing = true;
+            connection->farewell = "{\"error\":\"request too long\"}\n";
+        }
+        if (!connection->busy && !connection->requests.empty()) {
+            connection->busy = true;
+            ready_.push_back(connection);
+            queued = true;
+        }
+    }
+    if (queued) queueCv_.notify_one();
+}
+
+void QueryServer::wake() {
+    char byte = 1;
+    ssize_t written = ::write(wakePipe_[1], &byte, 1); // A full pipe already means a pending wake-up
+    (void)written;
+}
+
+void QueryServer::handlerLoop() {
+    while (true) {
+        std::shared_ptr<Connection> connection;
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(queueMtx_);
+            queueCv_.wait(lock, [&]() { return stopping_.load() || !ready_.empty(); });
+            if (stopping_) return;
+            connection = std::move(ready_.front());
+            ready_.pop_front();
+            request = std::move(connection->requests.front());
+            connection->requests.pop_front();
+        }
+
+        const bool command = !request.line.empty() && request.line[0] == '!';
+        const bool sent = sendAll(connection->fd, answer(request.line));
+        if (sent && !command) recordLatency(millisecondsSince(request.received));
+
+        bool requeued = false;
+        {
+            std::lock_guard<std::mutex> lock(queueMtx_);
+            connection->lastActive = std::chrono::steady_clock::now();
+            if (!sent) {
+                connection->closing = true;
+                connection->requests.clear();
+            }
+            if (connection->requests.empty()) {
+                connection->busy = false;
+            } else {
+                // Behind the other connections, so a client sending many lines cannot starve them
+                ready_.push_back(std::move(connection));
+                requeued = true;
+            }
+        }
+        if (requeued) queueCv_.notify_one();
+        wake();
+    }
+}
+
+std::string QueryServer::answer(const std::string& line) {
+    std::ostringstream out;
+    std::shared_ptr<const IndexSnapshot> current = snapshot();
+
+    if (!line.empty() && line[0] == '!') {
+        if (line != "!stats") return "{\"error\":\"unknown command\"}\n";
+        LatencyStats stats = latency();
+        size_t requests;
+        {
+            std::lock_guard<std::mutex> lock(latencyMtx_);
+            requests = requests_;
+        }
+        char numbers[160];
+        std::snprintf(numbers, sizeof(numbers), "\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f", stats.p50Ms,
+                      stats.p99Ms, stats.maxMs);
+        out << "{\"requests\":" << requests << ",\"window\":" << stats.count << ',' << numbers
+            << ",\"threads\":" << threadCount() << ",\"documents\":" << (current ? current->index->documentCount() : 0)
+            << ",\"generation\":" << (current ? current->generation : 0) << "}\n";
+        return out.str();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BatchQueryResult> results(1);
+    results[0].query = line;
+    if (current) results[0].results = current->scorer.topDocuments(*current->index, line, options_.topK);
+    results[0].milliseconds = millisecondsSince(start);
+    writeJsonLines(out, results);
+    return out.str();
+}
+
+void QueryServer::recordLatency(double ms) {
+    std::lock_guard<std::mutex> lock(latencyMtx_);
+    if (latencies_.size() < LATENCY_WINDOW) {
+        latencies_.push_back(ms);
+    } else {
+        latencies_[latencyNext_] = ms;
+    }
+    latencyNext_ = (latencyNext_ + 1) % LATENCY_WINDOW;
+    requests_++;
+}
+
+LatencyStats QueryServer::latency() const {
+    std::vector<double> samples;
+    {
+        std::lock_guard<std::mutex> lock(latencyMtx_);
+        samples = latencies_;
+    }
+    return summarizeLatencies(samples);
+}
+
+// --- Load test client ---
+
+LoadTestReport runLoadTest(const std::string& socketPath, const std::vector<std::string>& queries,
+                           unsigned clients, size_t requests) {
+    LoadTestReport report;
+    sockaddr_un address;
+    if (queries.empty() || clients == 0 || !fillAddress(socketPath, address)) return report;
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::vector<double>> latencies(clients);
+    std::atomic<size_t> nextRequest{0};
+    std::atomic<size_t> errors{0};
+    auto client = [&](unsigned id) {
+        int fd = connectTo(address);
+        if (fd < 0) {
+            errors++;
+            return;
+        }
+        std::string buffer, response;
+        for (size_t i = nextRequest++; i < requests; i = nextRequest++) {
+            auto start = std::chrono::steady_clock::now();
+            if (!sendAll(fd, queries[i % queries.size()] + "\n") || !readLine(fd, buffer, response)) {
+                errors++;
+                break;
+            }
+            latencies[id].push_back(millisecondsSince(start));
+        }
+        ::close(fd);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(clients);
+    for (unsigned i = 0; i < clients; ++i) threads.emplace_back(client, i);
+    for (auto& thread : threads) thread.join();
+    report.seconds = millisecondsSince(start) / 1000.0;
+
+    std::vector<double> samples;
+    for (const auto& own : latencies) samples.insert(samples.end(), own.begin(), own.end());
+    report.latency = summarizeLatencies(samples);
+    report.errors = errors.load();
+    report.requestsPerSecond = report.seconds > 0.0 ? report.latency.count / report.seconds : 0.0;
+    return report;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#include "index_reader.h"
+#include "relevance_scorer.h"
+#include "near_duplicates.h"
+
+/**
+ * @brief One immutable version of the corpus: the index, its near-duplicate
+ * clusters and a scorer bound to them. Requests hold the snapshot they
+ * started with, so a refresh never changes an index under a running query.
+ */
+struct IndexSnapshot {
+    std::unique_ptr<const IndexReader> index;
+    NearDuplicates duplicates;
+    RelevanceScorer scorer;
+    uint64_t generation = 0;
+};
+
+// Wraps `index` into a snapshot scored like `scorer`, clustering duplicates if asked to.
+std::shared_ptr<const IndexSnapshot> makeSnapshot(std::unique_ptr<const IndexReader> index,
+                                                  const RelevanceScorer& scorer, bool collapseDuplicates,
+                                                  uint64_t generation);
+
+struct LatencyStats {
+    size_t count = 0;
+    double p50Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+};
+
+// Percentiles of `samples` (milliseconds, reordered in place).
+LatencyStats summarizeLatencies(std::vector<double>& samples);
+
+struct ServerOptions {
+    std::string socketPath;
+    unsigned threads = 0;          // Request handlers (0 = one per hardware thread)
+    size_t topK = 5;               // Results per query
+};
+
+/**
+ * @brief Answers queries against a warm index over a Unix domain socket.
+ *
+ * The protocol is line based: each line a client sends is a topic, answered
+ * with one JSON line in the format of writeJsonLines. Lines starting with '!'
+ * are commands; "!stats" returns request latency percentiles. One thread
+ * polls the socket and every connection and queues each complete line; a pool
+ * of handler threads answers them, all reading the current snapshot. A
+ * connection's lines are answered one at a time, in order, so an idle client
+ * only costs a descriptor, and one left idle for long is closed. publish()
+ * swaps in a new snapshot atomically: requests already running finish on the
+ * old one, which is freed when the last of them lets go.
+ */
+class QueryServer {
+public:
+    explicit QueryServer(const ServerOptions& options);
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Binds the socket and starts the poller and handler threads. False (with a message) on failure.
+    bool start();
+    // Asks the server to shut down. Async-signal-safe.
+    void requestStop();
+    // Blocks until the server has shut down after requestStop().
+    void wait();
+    bool running() const { return !stopping_.load(); }
+
+    void publish(std::shared_ptr<const IndexSnapshot> snapshot);
+    std::shared_ptr<const IndexSnapshot> snapshot() const;
+
+    // Latency of the most recent requests, measured from request line to response.
+    LatencyStats latency() const;
+    unsigned threadCount() const { return static_cast<unsigned>(handlers_.size()); }
+
+private:
+    struct Request {
+        std::string line;
+        std::chrono::steady_clock::time_point received;
+    };
+    // One client. `buffer` belongs to the poller; the rest is guarded by queueMtx_.
+    struct Connection {
+        int fd = -1;
+        std::string buffer;              // Bytes after the last complete line
+        std::deque<Request> requests;    // Lines not answered yet, in arrival order
+        bool busy = false;               // In ready_ or held by a handler
+        bool closing = false;            // Close once `requests` is answered
+        std::string farewell;            // Sent just before closing
+        std::chrono::steady_clock::time_point lastActive;
+    };
+
+    void pollLoop();
+    void handlerLoop();
+    // Reads what the client sent and queues its complete lines.
+    void readFrom(const std::shared_ptr<Connection>& connection);
+    // Makes the poller look at the connections again.
+    void wake();
+    std::string answer(const std::string& line);
+    void recordLatency(double ms);
+
+    ServerOptions options_;
+    int listenFd_ = -1;
+    int stopPipe_[2] = {-1, -1};   // Readable once a stop was requested
+    int wakePipe_[2] = {-1, -1};   // Readable when a handler changed a connection's state
+    std::atomic<bool> stopping_{false};
+
+    std::shared_ptr<const IndexSnapshot> snapshot_; // Only through atomic_load/atomic_store
+
+    std::thread poller_;
+    std::vector<std::thread> handlers_;
+    std::mutex queueMtx_;
+    std::condition_variable queueCv_;
+    std::vector<std::shared_ptr<Connection>> connections_; // Open connections (the poller's list)
+    std::deque<std::shared_ptr<Connection>> ready_;        // Connections with a request for a handler
+
+    mutable std::mutex latencyMtx_;
+    std::vector<double> latencies_; // Ring of the last LATENCY_WINDOW requests
+    size_t latencyNext_ = 0;
+    size_t requests_ = 0;
+};
+
+struct LoadTestReport {
+    LatencyStats latency;
+    size_t errors = 0;
+    double seconds = 0.0;
+    double requestsPerSecond = 0.0;
+};
+
+/**
+ * @brief Sends `requests` queries to the server at `socketPath` from `clients`
+ * concurrent connections, cycling through `queries`, and measures the round
+ * trip of each one.
+ */
+LoadTestReport runLoadTest(const std::string& socketPath, const std::vector<std::string>& queries,
+                           unsigned clients, size_t requests);
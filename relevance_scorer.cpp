@@ -1,121 +1,353 @@
 #include "relevance_scorer.h"
-#include <sstream>
+#include "tokenizer.h"
+#include "profiler.h"
+
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <set>
+#include <limits>
 
-// Helper to lower case a string strictly for the phrase matching check
-std::string toLowerRaw(const std::string& input) {
-    std::string out = input;
-    std::transform(out.begin(), out.end(), out.begin(), ::tolower);
-    return out;
-}
+namespace {
 
-std::vector<std::string> RelevanceScorer::tokenizeAndPreprocess(const std::string& text) const {
-    std::vector<std::string> tokens;
-    std::stringstream ss(text);
-    std::string token;
-
-    while (ss >> token) {
-        // Lowercase
-        std::transform(token.begin(), token.end(), token.begin(), ::tolower);
-        // Remove punctuation
-        token.erase(std::remove_if(token.begin(), token.end(), 
-                    [](char c){ return !std::isalnum(c); }), token.end());
-        
-        // Only add if not empty and not a stop word
-        if (!token.empty() && STOP_WORDS.find(token) == STOP_WORDS.end()) {
-            tokens.push_back(token);
+// A query term and its token position within the query (stop words included)
+struct PhraseTerm {
+    std::string term;
+    uint32_t offset;
+};
+
+// True if the terms occur in `docId` at the same relative positions as in the query.
+bool containsPhrase(const IndexReader& index, uint32_t docId, const std::vector<PhraseTerm>& phrase) {
+    std::vector<PositionList> lists;
+    lists.reserve(phrase.size());
+    size_t anchor = 0;
+    for (const PhraseTerm& term : phrase) {
+        lists.push_back(index.positions(term.term, docId));
+        if (lists.back().empty()) return false;
+        if (lists.back().size() < lists[anchor].size()) anchor = lists.size() - 1;
+    }
+
+    // Walk the rarest term and probe every other term at its expected position
+    for (uint32_t position : lists[anchor]) {
+        const int64_t start = (int64_t)position - phrase[anchor].offset;
+        bool matched = true;
+        for (size_t k = 0; k < phrase.size() && matched; ++k) {
+            if (k == anchor) continue;
+            const int64_t expected = start + phrase[k].offset;
+            matched = expected >= 0 && std::binary_search(lists[k].begin(), lists[k].end(), (uint32_t)expected);
         }
+        if (matched) return true;
     }
+    return false;
+}
+
+// Splits the query into its terms, keeping each one's position for the phrase check.
+void tokenizeQuery(const std::string& query, std::vector<std::string>& queryTokens, std::vector<PhraseTerm>& phrase) {
+    Tokenizer::forEachPositionedToken(query, [&](std::string_view token, uint32_t position) {
+        queryTokens.emplace_back(token);
+        phrase.push_back(PhraseTerm{std::string(token), position});
+    });
+}
+
+// Result order: descending score, ties by path
+bool ranksBefore(const DocumentScore& a, const DocumentScore& b) {
+    if (a.score != b.score) return a.score > b.score;
+    return a.filePath < b.filePath;
+}
+
+// Fills in the paths of the duplicates `docId` represents.
+void addDuplicates(DocumentScore& ds, const IndexReader& index, const NearDuplicates* duplicates, uint32_t docId) {
+    if (!duplicates) return;
+    for (uint32_t duplicate : duplicates->duplicatesOf(docId)) {
+        ds.duplicates.emplace_back(index.documentPath(duplicate));
+    }
+}
+
+// One distinct query term while walking postings in doc id order
+struct TermCursor {
+    PostingList postings;
+    const Posting* current;
+    double weight;     // The model's term weight
+    double upperBound; // Largest contribution to any final score
+    std::unique_ptr<ScoringModel::PostingScorer> scorer; // Scores the current posting
+
+    static constexpr uint32_t END = UINT32_MAX;
+    uint32_t docId() const { return current == postings.end() ? END : current->docId; }
+};
+
+} // namespace
+
+std::vector<std::string> RelevanceScorer::tokenizeAndPreprocess(const std::string& text) const {
+    ProfileScope scope("tokenize");
+    std::vector<std::string> tokens = Tokenizer::tokenize(text);
+    scope.addBytes(text.size());
+    scope.addTokens(tokens.size());
     return tokens;
 }
 
-double RelevanceScorer::calculateIdf(const std::string& term, const TokenizedCorpus& tokenizedDocs) const {
-    int N = tokenizedDocs.size();
-    int docCount = 0;
+void RelevanceScorer::indexDocument(InvertedIndex& index, const std::string& path, std::string_view text,
+                                    const DocumentStamp& stamp) const {
+    index.beginDocument();
+    indexText(index, text, 0);
+    index.endDocument(path, stamp);
+}
 
-    for (const auto& pair : tokenizedDocs) {
-        if (std::find(pair.second.begin(), pair.second.end(), term) != pair.second.end()) {
-            docCount++;
-        }
+uint32_t RelevanceScorer::indexText(InvertedIndex& index, std::string_view text, uint32_t firstPosition,
+                                    TextField field) const {
+    // Tokens go straight into the index, so this stage includes posting them
+    ProfileScope scope("tokenize+index");
+    uint64_t tokens = 0;
+    uint32_t next = Tokenizer::forEachPositionedToken(text, [&](std::string_view token, uint32_t position) {
+        index.addToken(token, position, field);
+        tokens++;
+    }, firstPosition);
+    scope.addBytes(text.size());
+    scope.addTokens(tokens);
+    return next;
+}
+
+InvertedIndex RelevanceScorer::buildIndex(const CorpusMap& corpus) const {
+    InvertedIndex index;
+    for (const auto& pair : corpus) {
+        indexDocument(index, pair.first, pair.second);
     }
-    // Standard IDF formula
-    return std::log((double)N / (1.0 + docCount));
+    return index;
 }
 
 std::vector<DocumentScore> RelevanceScorer::scoreDocuments(
-    const CorpusMap& documentTexts,
+    const IndexReader& index,
     const std::string& query
-) {
+) const {
     std::vector<DocumentScore> results;
-    if (documentTexts.empty()) return results;
+    if (index.documentCount() == 0) return results;
+    ProfileScope scope("score");
 
-    // 1. Tokenize all documents
-    TokenizedCorpus tokenizedDocs;
-    for (const auto& pair : documentTexts) {
-        tokenizedDocs[pair.first] = tokenizeAndPreprocess(pair.second);
-    }
+    // 1. Tokenize query, keeping each term's position for the phrase check
+    std::vector<std::string> queryTokens;
+    std::vector<PhraseTerm> phrase;
+    tokenizeQuery(query, queryTokens, phrase);
 
-    // 2. Tokenize query
-    std::vector<std::string> queryTokens = tokenizeAndPreprocess(query);
+    const NearDuplicates* duplicates = duplicates_ && duplicates_->builtFrom(index) ? duplicates_ : nullptr;
 
-    // 3. Pre-calculate IDF for query terms
-    std::map<std::string, double> idfScores;
+    // 2. Accumulate the model's posting scores over the postings of the query terms
+    //    only, into a dense per-doc array. Repeated query terms count once per occurrence, as before.
+    std::vector<double> relevanceSums(index.documentCount(), 0.0);
+    std::vector<uint32_t> termsMatched(index.documentCount(), 0); // Distinct query terms per doc
+    std::vector<uint32_t> candidates;
+    std::set<std::string> seenTerms;
     for (const std::string& term : queryTokens) {
-        if (idfScores.find(term) == idfScores.end()) {
-            idfScores[term] = calculateIdf(term, tokenizedDocs);
+        PostingList postings = index.postings(term);
+        if (postings.empty()) continue;
+        model_->accumulate(index, postings, model_->termWeight(index, postings), relevanceSums.data());
+        if (!seenTerms.insert(term).second) continue;
+        for (const Posting& posting : postings) {
+            if (termsMatched[posting.docId]++ > 0) continue;
+            // A duplicate is left to its representative, which is scored for the whole cluster
+            if (duplicates && !duplicates->isRepresentative(posting.docId)) continue;
+            candidates.push_back(posting.docId);
         }
     }
+    std::set<std::string> distinctTerms(queryTokens.begin(), queryTokens.end());
 
-    // 4. Calculate Scores
-    for (const auto& docPair : documentTexts) {
+    // 3. Finish scoring the candidate documents
+    results.reserve(candidates.size());
+    for (uint32_t docId : candidates) {
         DocumentScore ds;
-        ds.filePath = docPair.first;
-        const auto& docTokens = tokenizedDocs[ds.filePath];
+        ds.filePath = std::string(index.documentPath(docId));
 
-        // --- A. Term Frequency Saturation (THE FIX) ---
-        std::map<std::string,int> termFrequency;
-        for (const auto& token : docTokens) termFrequency[token]++;
+        // Exact phrase bonus, resolved from token positions and only for
+        // documents holding every query term
+        bool phraseMatched = query.length() > 5 && termsMatched[docId] == distinctTerms.size() &&
+                             containsPhrase(index, docId, phrase);
+        ds.score = model_->finalScore(index, docId, relevanceSums[docId], phraseMatched);
+        addDuplicates(ds, index, duplicates, docId);
+        results.push_back(ds);
+    }
 
-        double relevanceSum = 0.0;
-        for (const auto& term : queryTokens) {
-            int tfRaw = termFrequency.count(term) ? termFrequency.at(term) : 0;
-            
-            if (tfRaw > 0) {
-                // SATURATION LOGIC:
-                // Instead of just 'tfRaw', we use '1 + log(tfRaw)'
-                // If count is 10, score is ~3.3. If count is 1000, score is ~7.9 (not 1000!)
-                double tfSaturated = 1.0 + std::log((double)tfRaw);
-                
-                double idf = idfScores.count(term) ? idfScores.at(term) : 0.0;
-                relevanceSum += tfSaturated * idf;
+    // 4. Sort descending; ties keep corpus (path) order
+    std::sort(results.begin(), results.end(), ranksBefore);
+    scope.addItems(results.size());
+
+    return results;
+}
+
+double RelevanceScorer::scoreCeiling(const IndexReader& index, const std::string& query) const {
+    std::vector<std::string> queryTokens;
+    std::vector<PhraseTerm> phrase;
+    tokenizeQuery(query, queryTokens, phrase);
+
+    double ceiling = 0.0;
+    for (const std::string& term : queryTokens) {
+        ceiling += model_->termCeiling(model_->termWeight(index, index.postings(term)));
+    }
+    return ceiling;
+}
+
+std::vector<DocumentScore> RelevanceScorer::topDocuments(
+    const IndexReader& index,
+    const std::string& query,
+    size_t k
+) const {
+    std::vector<DocumentScore> heap; // Worst of the current top k at the front
+    if (index.documentCount() == 0 || k == 0) return heap;
+    ProfileScope scope("score top-k");
+    ProfileScope weights("term weights");
+
+    std::vector<std::string> queryTokens;
+    std::vector<PhraseTerm> phrase;
+    tokenizeQuery(query, queryTokens, phrase);
+    const NearDuplicates* duplicates = duplicates_ && duplicates_->builtFrom(index) ? duplicates_ : nullptr;
+
+    // 1. One cursor per distinct term. Repeated query terms count once per
+    //    occurrence, so their bound is multiplied accordingly.
+    std::vector<TermCursor> cursors;
+    std::vector<int> cursorOfToken(queryTokens.size(), -1);
+    std::vector<std::string> distinctTerms;
+    std::vector<int> cursorOfTerm; // Per distinct term, -1 if it has no postings
+    bool allTermsPresent = true;
+    for (size_t i = 0; i < queryTokens.size(); ++i) {
+        auto seen = std::find(distinctTerms.begin(), distinctTerms.end(), queryTokens[i]);
+        if (seen != distinctTerms.end()) {
+            cursorOfToken[i] = cursorOfTerm[seen - distinctTerms.begin()];
+            if (cursorOfToken[i] >= 0) {
+                TermCursor& cursor = cursors[cursorOfToken[i]];
+                cursor.upperBound += model_->upperBound(index, cursor.postings, cursor.weight);
             }
+            continue;
+        }
+        distinctTerms.push_back(queryTokens[i]);
+        PostingList postings = index.postings(queryTokens[i]);
+        if (postings.empty()) {
+            cursorOfTerm.push_back(-1);
+            allTermsPresent = false;
+            continue;
         }
+        double weight = model_->termWeight(index, postings);
+        cursorOfToken[i] = static_cast<int>(cursors.size());
+        cursorOfTerm.push_back(cursorOfToken[i]);
+        cursors.push_back(TermCursor{postings, postings.begin(), weight,
+                                     model_->upperBound(index, postings, weight),
+                                     model_->postingScorer(index, postings, weight)});
+    }
 
-        // --- B. EXACT PHRASE BONUS ---
-        std::string docLower = toLowerRaw(docPair.second);
-        std::string queryLower = toLowerRaw(query);
-        
-        // Boosted from 50.0 to 100.0 to fight the large textbooks harder
-        if (query.length() > 5 && docLower.find(queryLower) != std::string::npos) {
-            relevanceSum += 100.0; 
+    // The phrase bonus needs every term, so any term's bound on it holds: take the tightest
+    double phraseBound = 0.0;
+    if (query.length() > 5 && allTermsPresent && !cursors.empty()) {
+        phraseBound = model_->phraseBound(index, cursors[0].postings);
+        for (const TermCursor& cursor : cursors) {
+            phraseBound = std::min(phraseBound, model_->phraseBound(index, cursor.postings));
         }
+    }
+    weights.finish();
 
-        // --- C. LENGTH NORMALIZATION ---
-        double docLength = (double)docTokens.size();
-        if (docLength < 1.0) docLength = 1.0;
-        
-        // Normalize
-        ds.score = relevanceSum / std::sqrt(docLength);
+    // A document has to reach the current k-th score to matter (ties are broken by
+    // path, so equal is not enough to skip). The slack covers rounding differences
+    // between the bounds and the exact scores.
+    auto threshold = [&]() {
+        if (heap.size() < k) return -std::numeric_limits<double>::infinity();
+        double score = heap.front().score;
+        return score - 1e-9 * std::max(1.0, std::fabs(score));
+    };
+    auto offer = [&](uint32_t docId, double score) {
+        if (heap.size() == k && score < heap.front().score) return;
+        DocumentScore candidate{std::string(index.documentPath(docId)), score, {}};
+        if (heap.size() == k) {
+            if (!ranksBefore(candidate, heap.front())) return;
+            addDuplicates(candidate, index, duplicates, docId);
+            std::pop_heap(heap.begin(), heap.end(), ranksBefore);
+            heap.back() = std::move(candidate);
+        } else {
+            addDuplicates(candidate, index, duplicates, docId);
+            heap.push_back(std::move(candidate));
+        }
+        std::push_heap(heap.begin(), heap.end(), ranksBefore);
+    };
 
-        results.push_back(ds);
+    // 2. WAND: walk the cursors in doc id order, fully scoring only documents
+    //    whose summed term bounds can still reach the top k
+    std::vector<TermCursor*> order;
+    for (TermCursor& cursor : cursors) order.push_back(&cursor);
+    auto byDoc = [](const TermCursor* a, const TermCursor* b) { return a->docId() < b->docId(); };
+    while (true) {
+        std::sort(order.begin(), order.end(), byDoc);
+
+        // Pivot: the first cursor at which the bounds so far reach the threshold
+        const double minScore = threshold();
+        double bound = 0.0;
+        size_t pivot = order.size();
+        for (size_t i = 0; i < order.size() && order[i]->docId() != TermCursor::END; ++i) {
+            bound += order[i]->upperBound;
+            double withPhrase = bound + (i + 1 == cursors.size() ? phraseBound : 0.0);
+            if (withPhrase >= minScore) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == order.size()) break;
+        const uint32_t pivotDoc = order[pivot]->docId();
+
+        if (order[0]->docId() != pivotDoc) {
+            // Documents before the pivot hold too few terms to qualify: skip them
+            for (size_t i = 0; i < pivot; ++i) {
+                TermCursor& cursor = *order[i];
+                cursor.current = std::lower_bound(cursor.current, cursor.postings.end(), pivotDoc,
+                    [](const Posting& posting, uint32_t docId) { return posting.docId < docId; });
+            }
+            continue;
+        }
+
+        if (duplicates && !duplicates->isRepresentative(pivotDoc)) {
+            for (TermCursor& cursor : cursors) {
+                if (cursor.docId() == pivotDoc) ++cursor.current;
+            }
+            continue;
+        }
+
+        // Score the pivot exactly as scoreDocuments does, in query token order
+        double relevanceSum = 0.0;
+        for (size_t i = 0; i < queryTokens.size(); ++i) {
+            if (cursorOfToken[i] < 0) continue;
+            const TermCursor& cursor = cursors[cursorOfToken[i]];
+            if (cursor.docId() != pivotDoc) continue;
+            relevanceSum += cursor.scorer->score(cursor.current - cursor.postings.begin());
+        }
+        size_t termsMatched = 0;
+        for (TermCursor& cursor : cursors) {
+            if (cursor.docId() == pivotDoc) termsMatched++;
+        }
+
+        double score = model_->finalScore(index, pivotDoc, relevanceSum, false);
+        if (phraseBound > 0.0 && termsMatched == distinctTerms.size()) {
+            double withBonus = model_->finalScore(index, pivotDoc, relevanceSum, true);
+            if (withBonus >= threshold() && containsPhrase(index, pivotDoc, phrase)) score = withBonus;
+        }
+        offer(pivotDoc, score);
+        scope.addItems(1);
+
+        for (TermCursor& cursor : cursors) {
+            if (cursor.docId() == pivotDoc) ++cursor.current;
+        }
     }
 
-    // 5. Sort descending
-    std::sort(results.begin(), results.end(), [](const DocumentScore& a, const DocumentScore& b){
+    std::sort(heap.begin(), heap.end(), ranksBefore);
+    return heap;
+}
+
+std::vector<DocumentScore> RelevanceScorer::scoreDocuments(
+    const CorpusMap& documentTexts,
+    const std::string& query
+) {
+    InvertedIndex index = buildIndex(documentTexts);
+    std::vector<DocumentScore> results = scoreDocuments(index, query);
+
+    // Documents without any query term still get a (zero) score here
+    std::set<std::string> scored;
+    for (const auto& ds : results) scored.insert(ds.filePath);
+    for (const auto& pair : documentTexts) {
+        if (!scored.count(pair.first)) results.push_back(DocumentScore{pair.first, 0.0, {}});
+    }
+    std::stable_sort(results.begin(), results.end(), [](const DocumentScore& a, const DocumentScore& b){
         return a.score > b.score;
     });
-
     return results;
-}
\ No newline at end of file
+}
@@ -1,31 +1,96 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
-#include <set>
+#include <memory>
+
+#include "index_reader.h"
+#include "inverted_index.h"
+#include "scoring_model.h"
+#include "near_duplicates.h"
 
 struct DocumentScore {
     std::string filePath;
     double score;
+    std::vector<std::string> duplicates; // Near-duplicates collapsed into this result
 };
 
-// TokenizedCorpus = map<FilePath, tokens>
-using TokenizedCorpus = std::map<std::string, std::vector<std::string>>;
 using CorpusMap = std::map<std::string, std::string>;
 
 class RelevanceScorer {
 public:
+    // Ranks with `model`; the default is the original TF-IDF ranking.
+    explicit RelevanceScorer(std::shared_ptr<const ScoringModel> model = std::make_shared<TfIdfModel>())
+        : model_(std::move(model)) {}
+
+    const ScoringModel& model() const { return *model_; }
+
+    /**
+     * @brief Collapses near-duplicates in the results of the index `duplicates`
+     * was built from: only cluster representatives are scored and returned,
+     * each listing its duplicates. Null (the default) or clusters of another
+     * index leave every document on its own. Not owned.
+     */
+    void setNearDuplicates(const NearDuplicates* duplicates) { duplicates_ = duplicates; }
+
+
+    // Tokenizes every document once and indexes it (doc ids follow corpus order).
+    InvertedIndex buildIndex(const CorpusMap& corpus) const;
+
+    /**
+     * @brief Scores only the documents that contain at least one query term.
+     * @param index In-memory or memory-mapped index. The exact-phrase bonus is
+     *        resolved from its token positions, so no raw text is needed.
+     * @return Matching documents sorted by descending score.
+     */
+    std::vector<DocumentScore> scoreDocuments(
+        const IndexReader& index,
+        const std::string& topic
+    ) const;
+
+    /**
+     * @brief The best `k` documents, exactly as the first `k` of scoreDocuments.
+     *
+     * Uses WAND dynamic pruning: documents are visited in doc id order and only
+     * fully scored when the per-term score bounds stored in the index say they
+     * can still enter the current top k, which is kept in a bounded heap.
+     */
+    std::vector<DocumentScore> topDocuments(
+        const IndexReader& index,
+        const std::string& topic,
+        size_t k
+    ) const;
+
+    /**
+     * @brief The most any document could score for `topic` before the phrase
+     * bonus: the sum of the model's termCeiling over the query terms (HUGE_VAL
+     * for models whose scores are unbounded, like tf-idf). A term the index
+     * lacks counts with its weight at a document frequency of zero, so it
+     * still raises the bar. Scores divided by this are comparable across
+     * queries of different length and term rarity.
+     */
+    double scoreCeiling(const IndexReader& index, const std::string& topic) const;
+
+    // Convenience wrapper: indexes `corpus` and returns a score for every document.
     std::vector<DocumentScore> scoreDocuments(
         const CorpusMap& corpus,
         const std::string& topic
     );
 
-private:
+    // Tokenizes `text` straight into `index` as the document at `path` (no token copies).
+    void indexDocument(InvertedIndex& index, const std::string& path, std::string_view text,
+                       const DocumentStamp& stamp = DocumentStamp()) const;
+
+    // Tokenizes one piece of a document streamed into `index` between its
+    // beginDocument and endDocument calls; returns the position after the piece.
+    uint32_t indexText(InvertedIndex& index, std::string_view text, uint32_t firstPosition,
+                       TextField field = FIELD_BODY) const;
+
+    // Lowercased, punctuation-free, stop-word-free tokens (see Tokenizer).
     std::vector<std::string> tokenizeAndPreprocess(const std::string& text) const;
-    double calculateIdf(const std::string& term, const TokenizedCorpus& tokenizedDocs) const;
 
-    // Minimal stop words list
-    const std::set<std::string> STOP_WORDS = {
-        "the","and","a","an","in","on","of","for","with","to","is","are","was","were"
-    };
+private:
+    std::shared_ptr<const ScoringModel> model_;
+    const NearDuplicates* duplicates_ = nullptr;
 };
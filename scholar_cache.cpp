@@ -0,0 +1,205 @@
+#include "scholar_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <atomic>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char ENTRY_MAGIC[4] = {'P', 'S', 'R', 'C'};
+const uint32_t ENTRY_VERSION = 1;
+
+uint64_t fnv1a(const std::string& data) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (char c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Entries are a sequence of length-prefixed fields after the magic and version
+void writeString(std::ostream& out, const std::string& value) {
+    uint32_t length = static_cast<uint32_t>(value.size());
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(value.data(), length);
+}
+
+bool readString(std::istream& in, std::string& value) {
+    uint32_t length = 0;
+    if (!in.read(reinterpret_cast<char*>(&length), sizeof(length))) return false;
+    // Guard against garbage lengths in a damaged entry
+    if (length > (64u << 20)) return false;
+    value.resize(length);
+    return length == 0 || static_cast<bool>(in.read(&value[0], length));
+}
+
+// Re-encodes one query component so equivalent spellings compare equal:
+// '+' becomes %20, escapes of unreserved characters are decoded, others use upper-case hex.
+std::string normalizeComponent(const std::string& component) {
+    std::string out;
+    for (size_t i = 0; i < component.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(component[i]);
+        if (c == '+') {
+            out += "%20";
+        } else if (c == '%' && i + 2 < component.size() && std::isxdigit(static_cast<unsigned char>(component[i + 1])) &&
+                   std::isxdigit(static_cast<unsigned char>(component[i + 2]))) {
+            unsigned char decoded = static_cast<unsigned char>(std::stoi(component.substr(i + 1, 2), nullptr, 16));
+            if (std::isalnum(decoded) || decoded == '-' || decoded == '.' || decoded == '_' || decoded == '~') {
+                out += static_cast<char>(decoded);
+            } else {
+                out += '%';
+                out += static_cast<char>(std::toupper(static_cast<unsigned char>(component[i + 1])));
+                out += static_cast<char>(std::toupper(static_cast<unsigned char>(component[i + 2])));
+            }
+            i += 2;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+ScholarCache::ScholarCache(const std::string& directory, int64_t ttlSeconds)
+    : directory_(directory), ttlSeconds_(ttlSeconds) {}
+
+std::string ScholarCache::normalizeUrl(const std::string& url) {
+    std::string base = url;
+    std::string query;
+    size_t fragment = base.find('#');
+    if (fragment != std::string::npos) base.erase(fragment);
+    size_t question = base.find('?');
+    if (question != std::string::npos) {
+        query = base.substr(question + 1);
+        base.erase(question);
+    }
+
+    // Scheme and host are case-insensitive; the path is not
+    size_t schemeEnd = base.find("://");
+    size_t hostEnd = schemeEnd == std::string::npos ? 0 : base.find('/', schemeEnd + 3);
+    if (hostEnd == std::string::npos) hostEnd = base.size();
+    std::transform(base.begin(), base.begin() + hostEnd, base.begin(), ::tolower);
+
+    std::vector<std::string> params;
+    std::stringstream ss(query);
+    std::string param;
+    while (std::getline(ss, param, '&')) {
+        if (!param.empty()) params.push_back(normalizeComponent(param));
+    }
+    std::sort(params.begin(), params.end());
+
+    std::string normalized = base;
+    for (size_t i = 0; i < params.size(); ++i) {
+        normalized += (i == 0 ? '?' : '&');
+        normalized += params[i];
+    }
+    return normalized;
+}
+
+std::string ScholarCache::entryPath(const std::string& normalizedUrl) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << fnv1a(normalizedUrl);
+    return (fs::path(directory_) / (name.str() + ".srch")).string();
+}
+
+int64_t ScholarCache::now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool ScholarCache::isFresh(const CachedScholarPage& page) const {
+    return now() - page.fetchedAt < ttlSeconds_;
+}
+
+void ScholarCache::touch(const std::string& url, CachedScholarPage& page) const {
+    page.fetchedAt = now();
+    store(url, page);
+}
+
+bool ScholarCache::lookup(const std::string& url, CachedScholarPage& page) const {
+    const std::string normalized = normalizeUrl(url);
+    std::ifstream in(entryPath(normalized), std::ios::binary);
+    if (!in) return false;
+
+    char magic[4];
+    uint32_t version = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, ENTRY_MAGIC, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != ENTRY_VERSION) {
+        return false;
+    }
+    std::string storedUrl;
+    uint32_t count = 0;
+    CachedScholarPage loaded;
+    if (!readString(in, storedUrl) || storedUrl != normalized || // A different URL with the same hash
+        !in.read(reinterpret_cast<char*>(&loaded.fetchedAt), sizeof(loaded.fetchedAt)) ||
+        !readString(in, loaded.etag) || !readString(in, loaded.lastModified) ||
+        !in.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        ScholarResult result;
+        if (!readString(in, result.title) || !readString(in, result.url) || !readString(in, result.snippet)) {
+            return false;
+        }
+        loaded.results.push_back(std::move(result));
+    }
+    page = std::move(loaded);
+    return true;
+}
+
+void ScholarCache::store(const std::string& url, const CachedScholarPage& page) const {
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (ec) {
+        std::cerr << "[Cache Error] Could not create " << directory_ << ": " << ec.message() << std::endl;
+        return;
+    }
+
+    const std::string normalized = normalizeUrl(url);
+    const std::string entryFile = entryPath(normalized);
+    // Unique per process and per call, so writers never share a temp file
+    static std::atomic<uint64_t> tmpCounter{0};
+    const std::string tmpFile =
+        entryFile + ".tmp." + std::to_string(getpid()) + "." + std::to_string(tmpCounter.fetch_add(1));
+    {
+        std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+        out.write(ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+        out.write(reinterpret_cast<const char*>(&ENTRY_VERSION), sizeof(ENTRY_VERSION));
+        writeString(out, normalized);
+        out.write(reinterpret_cast<const char*>(&page.fetchedAt), sizeof(page.fetchedAt));
+        writeString(out, page.etag);
+        writeString(out, page.lastModified);
+        uint32_t count = static_cast<uint32_t>(page.results.size());
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& result : page.results) {
+            writeString(out, result.title);
+            writeString(out, result.url);
+            writeString(out, result.snippet);
+        }
+        if (!out) {
+            std::cerr << "[Cache Error] Could not write " << tmpFile << std::endl;
+            out.close();
+            fs::remove(tmpFile, ec);
+            return;
+        }
+    }
+    fs::rename(tmpFile, entryFile, ec);
+    if (ec) {
+        std::cerr << "[Cache Error] Could not replace " << entryFile << ": " << ec.message() << std::endl;
+        fs::remove(tmpFile, ec);
+    }
+}
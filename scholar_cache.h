@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "scholar_search.h"
+#include "profiler.h"
+
+// A result page as last seen from the server.
+struct CachedScholarPage {
+    std::vector<ScholarResult> results; // Already parsed
+    std::string etag;                   // Validators for revalidation, empty if the server sent none
+    std::string lastModified;
+    int64_t fetchedAt = 0;              // Unix seconds of the last fetch or revalidation
+};
+
+/**
+ * @brief Persistent on-disk cache of parsed Scholar result pages.
+ *
+ * Entries are keyed by the normalized page URL and hold the parsed records,
+ * so a hit needs neither the network nor the HTML parser. Entries younger
+ * than the TTL are used as is; older ones are revalidated with
+ * If-None-Match / If-Modified-Since when the server sent validators, and a
+ * 304 answer just refreshes their timestamp.
+ */
+class ScholarCache {
+public:
+    ScholarCache(const std::string& directory, int64_t ttlSeconds);
+
+    // Lowercases scheme and host, sorts query parameters and unifies percent-escapes.
+    static std::string normalizeUrl(const std::string& url);
+
+    // Fills `page` from the entry for `url`. False if there is none (or it is unreadable).
+    bool lookup(const std::string& url, CachedScholarPage& page) const;
+
+    bool isFresh(const CachedScholarPage& page) const;
+
+    // Current time in the unit of CachedScholarPage::fetchedAt.
+    static int64_t now();
+
+    // Writes (or replaces) the entry for `url`. Failures are logged, never fatal.
+    void store(const std::string& url, const CachedScholarPage& page) const;
+
+    // Refreshes `page.fetchedAt` after a 304 answer and rewrites the entry.
+    void touch(const std::string& url, CachedScholarPage& page) const;
+
+    // Counters for the pages served fresh, revalidated with a 304, or fetched in full
+    void recordHit() const {
+        hits_++;
+        profileCacheLookup("scholar cache", true);
+    }
+    void recordRevalidation() const {
+        revalidations_++;
+        profileCount("scholar cache revalidations");
+    }
+    void recordMiss() const {
+        misses_++;
+        profileCacheLookup("scholar cache", false);
+    }
+    size_t hits() const { return hits_.load(); }
+    size_t revalidations() const { return revalidations_.load(); }
+    size_t misses() const { return misses_.load(); }
+
+    int64_t ttlSeconds() const { return ttlSeconds_; }
+
+private:
+    std::string entryPath(const std::string& normalizedUrl) const;
+
+    std::string directory_;
+    int64_t ttlSeconds_;
+    mutable std::atomic<size_t> hits_{0};
+    mutable std::atomic<size_t> revalidations_{0};
+    mutable std::atomic<size_t> misses_{0};
+};
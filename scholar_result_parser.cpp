@@ -0,0 +1,154 @@
+#include "scholar_result_parser.h"
+#include "scholar_search.h"
+
+#include <algorithm>
+#include <cstring>
+#include <libxml/HTMLparser.h>
+
+namespace {
+
+const size_t SNIPPET_LIMIT = 200;
+
+const char* attribute(const xmlChar** atts, const char* name) {
+    if (!atts) return nullptr;
+    for (size_t i = 0; atts[i]; i += 2) {
+        if (std::strcmp(reinterpret_cast<const char*>(atts[i]), name) == 0) {
+            return atts[i + 1] ? reinterpret_cast<const char*>(atts[i + 1]) : "";
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+struct ScholarResultParser::State {
+    struct Frame {
+        std::string name;
+        int result = -1;       // Result block opened by this element (div with "gs_r" in its class)
+        int titleOf = -1;      // Result whose h3.gs_rt this is
+    };
+
+    struct Slot {
+        ScholarResult result;
+        bool hasTitle = false;
+        bool hasSnippet = false;
+    };
+
+    // Text below a title link or snippet div goes to that field
+    struct Capture {
+        size_t slot;
+        bool snippet;
+        size_t depth; // Frame count while the capturing element is open
+    };
+
+    std::vector<Frame> frames;
+    std::vector<Slot> slots;
+    std::vector<Capture> captures;
+
+    void start(const char* name, const xmlChar** atts) {
+        Frame frame;
+        frame.name = name;
+        const char* cls = attribute(atts, "class");
+        int parentResult = frames.empty() ? -1 : frames.back().result;
+        int parentTitle = frames.empty() ? -1 : frames.back().titleOf;
+
+        if (frame.name == "div" && cls && std::strstr(cls, "gs_r")) {
+            frame.result = static_cast<int>(slots.size());
+            slots.emplace_back();
+        }
+        if (parentResult >= 0 && frame.name == "h3" && cls && std::strcmp(cls, "gs_rt") == 0) {
+            frame.titleOf = parentResult;
+        }
+        frames.push_back(std::move(frame));
+
+        if (parentTitle >= 0 && frames.back().name == "a" && !slots[parentTitle].hasTitle) {
+            Slot& slot = slots[parentTitle];
+            slot.hasTitle = true;
+            const char* href = attribute(atts, "href");
+            slot.result.url = href ? href : "";
+            captures.push_back(Capture{static_cast<size_t>(parentTitle), false, frames.size()});
+        } else if (parentResult >= 0 && frames.back().name == "div" && cls && std::strcmp(cls, "gs_rs") == 0 &&
+                   !slots[parentResult].hasSnippet) {
+            slots[parentResult].hasSnippet = true;
+            captures.push_back(Capture{static_cast<size_t>(parentResult), true, frames.size()});
+        }
+    }
+
+    void end() {
+        if (frames.empty()) return;
+        while (!captures.empty() && captures.back().depth == frames.size()) captures.pop_back();
+        frames.pop_back();
+    }
+
+    void append(const char* data, int length) {
+        for (const auto& capture : captures) {
+            ScholarResult& result = slots[capture.slot].result;
+            (capture.snippet ? result.snippet : result.title).append(data, length);
+        }
+    }
+
+    // Libxml2 SAX callbacks; the user data is the State
+    static void onStart(void* ctx, const xmlChar* name, const xmlChar** atts) {
+        static_cast<State*>(ctx)->start(reinterpret_cast<const char*>(name), atts);
+    }
+    static void onEnd(void* ctx, const xmlChar*) {
+        static_cast<State*>(ctx)->end();
+    }
+    // Text and script/style bodies both count towards an element's text content
+    static void onText(void* ctx, const xmlChar* data, int length) {
+        static_cast<State*>(ctx)->append(reinterpret_cast<const char*>(data), length);
+    }
+};
+
+ScholarResultParser::ScholarResultParser() : state_(new State()) {
+    xmlSAXHandler sax;
+    std::memset(&sax, 0, sizeof(sax));
+    sax.startElement = State::onStart;
+    sax.endElement = State::onEnd;
+    sax.characters = State::onText;
+    sax.cdataBlock = State::onText;
+    // ignorableWhitespace stays unset: the tree builder drops those runs as well
+
+    htmlParserCtxtPtr context = htmlCreatePushParserCtxt(&sax, state_.get(), nullptr, 0, nullptr, XML_CHAR_ENCODING_UTF8);
+    if (context) htmlCtxtUseOptions(context, HTML_PARSE_NOWARNING | HTML_PARSE_NOERROR);
+    context_ = context;
+}
+
+ScholarResultParser::~ScholarResultParser() {
+    if (context_) htmlFreeParserCtxt(static_cast<htmlParserCtxtPtr>(context_));
+}
+
+void ScholarResultParser::feed(const char* data, size_t size) {
+    if (!context_) return;
+    bytesFed_ += size;
+    // htmlParseChunk takes an int size
+    const size_t maxChunk = 1 << 30;
+    while (size > 0) {
+        size_t part = std::min(size, maxChunk);
+        htmlParseChunk(static_cast<htmlParserCtxtPtr>(context_), data, static_cast<int>(part), 0);
+        data += part;
+        size -= part;
+    }
+}
+
+std::vector<ScholarResult> ScholarResultParser::finish() {
+    std::vector<ScholarResult> results;
+    if (!context_) return results;
+    htmlParseChunk(static_cast<htmlParserCtxtPtr>(context_), nullptr, 0, 1);
+
+    for (auto& slot : state_->slots) {
+        ScholarResult& res = slot.result;
+        // Simple cleanup of the snippet text
+        if (res.snippet.length() > SNIPPET_LIMIT) res.snippet = res.snippet.substr(0, SNIPPET_LIMIT) + "...";
+        // Only keep the result if we successfully got a title and URL
+        if (!res.title.empty() && !res.url.empty()) results.push_back(std::move(res));
+    }
+    state_->slots.clear();
+    return results;
+}
+
+std::vector<ScholarResult> ScholarResultParser::parse(const std::string& html) {
+    ScholarResultParser parser;
+    parser.feed(html.data(), html.size());
+    return parser.finish();
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+struct ScholarResult;
+
+/**
+ * @brief Extracts Scholar results from an HTML page in one streaming pass.
+ *
+ * Feeds the page through libxml2's HTML push parser with SAX callbacks, so
+ * no document tree is built and chunks can be passed in straight from the
+ * download as they arrive. The selection is the same as the former XPath
+ * queries: every div whose class contains "gs_r" is a result block, its
+ * title and URL come from the first a child of an h3.gs_rt child, and its
+ * snippet is the text of the first div.gs_rs child (cut to 200 bytes).
+ */
+class ScholarResultParser {
+public:
+    ScholarResultParser();
+    ~ScholarResultParser();
+    ScholarResultParser(const ScholarResultParser&) = delete;
+    ScholarResultParser& operator=(const ScholarResultParser&) = delete;
+
+    // Parses the next chunk of the page.
+    void feed(const char* data, size_t size);
+
+    // Ends the page and returns its results (those with a title and URL), in page order.
+    std::vector<ScholarResult> finish();
+
+    size_t bytesFed() const { return bytesFed_; }
+
+    // One-shot convenience for a complete page.
+    static std::vector<ScholarResult> parse(const std::string& html);
+
+    struct State;
+
+private:
+    std::unique_ptr<State> state_;
+    void* context_ = nullptr; // htmlParserCtxtPtr
+    size_t bytesFed_ = 0;
+};
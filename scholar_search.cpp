@@ -1,179 +1,231 @@
 #include "scholar_search.h"
+#include "scholar_cache.h"
+#include "scholar_result_parser.h"
+#include "profiler.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
-#include <curl/curl.h>
-#include <libxml/HTMLparser.h>
-#include <libxml/xpath.h>
-
-// --- Helper Implementation 1: cURL Write Callback ---
-size_t ScholarSearch::WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    ((std::string*)userp)->append((char*)contents, size * nmemb);
-    return size * nmemb;
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace {
+
+// Use a high-quality User-Agent to mimic a real browser
+const char* BROWSER_USER_AGENT = "Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36";
+
+// Trims the query and collapses runs of whitespace, so "a  b " and "a b" share a cache entry
+std::string normalizeQuery(const std::string& query) {
+    std::stringstream ss(query);
+    std::string word;
+    std::string normalized;
+    while (ss >> word) {
+        if (!normalized.empty()) normalized += ' ';
+        normalized += word;
+    }
+    return normalized;
 }
 
-// --- Helper Implementation 2: cURL HTML Fetcher ---
-std::string ScholarSearch::fetchHtml(const std::string& url) const {
-    CURL* curl_handle;
-    std::string html_content;
-    
-    // Initialize cURL
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl_handle = curl_easy_init();
-
-    if (curl_handle) {
-        // Set URL
-        curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
-        
-        // Use a high-quality User-Agent to mimic a real browser
-        curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36"); 
-        
-        // Set write function to append data to the string
-        curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &html_content);
-        
-        // Follow redirects
-        curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1L);
-
-        // Set standard HTTP headers
-        struct curl_slist *headers = NULL;
-        headers = curl_slist_append(headers, "Accept-Language: en-US,en;q=0.9");
-        curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
-
-        // Perform the request
-        CURLcode res = curl_easy_perform(curl_handle);
-
-        if (res != CURLE_OK) {
-            std::cerr << "[cURL Error] Failed to fetch URL " << url << ": " 
-                      << curl_easy_strerror(res) << std::endl;
-            html_content.clear(); // Clear content on error
-        }
-
-        // Clean up headers list (FIX for memory leak)
-        if (headers) {
-            curl_slist_free_all(headers);
-        }
-
-        // Clean up cURL handle
-        curl_easy_cleanup(curl_handle);
-    }
-    curl_global_cleanup();
-    
-    return html_content;
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
-// --- Helper Implementation 3: libxml2 HTML Parser ---
-std::vector<ScholarResult> ScholarSearch::parseResults(const std::string& htmlContent) const {
-    std::vector<ScholarResult> results;
-    htmlDocPtr doc = NULL;
-    xmlXPathContextPtr xpathCtx = NULL;
-    xmlXPathObjectPtr xpathObj = NULL;
-
-    // 1. Parse the HTML content
-    doc = htmlReadMemory(htmlContent.c_str(), htmlContent.size(), NULL, "UTF-8", HTML_PARSE_NOWARNING | HTML_PARSE_NOERROR);
-    if (doc == NULL) {
-        std::cerr << "[libxml2 Error] Could not parse HTML document." << std::endl;
-        return results;
-    }
+} // namespace
 
-    // 2. Create XPath context
-    xpathCtx = xmlXPathNewContext(doc);
-    if (xpathCtx == NULL) {
-        std::cerr << "[libxml2 Error] Could not create XPath context." << std::endl;
-        xmlFreeDoc(doc);
-        return results;
-    }
+ScholarSearch::ScholarSearch(const std::string& baseUrl, size_t maxConcurrent)
+    : baseUrl_(baseUrl), fetcher_(maxConcurrent) {
+    fetcher_.setUserAgent(BROWSER_USER_AGENT);
+    // Set standard HTTP headers
+    fetcher_.addHeader("Accept-Language: en-US,en;q=0.9");
+}
 
-    // 3. Define the main result block XPath
-    // FIX: Simplified XPath to use 'contains' and only the stable 'gs_r' class.
-    const xmlChar* xpathExpr = (const xmlChar*)"//div[contains(@class, 'gs_r')]";
-    xpathObj = xmlXPathEvalExpression(xpathExpr, xpathCtx);
-
-    if (xpathObj && xpathObj->nodesetval) {
-        xmlNodeSetPtr nodes = xpathObj->nodesetval;
-        
-        for (int i = 0; i < nodes->nodeNr; ++i) {
-            xmlNodePtr resultNode = nodes->nodeTab[i];
-            ScholarResult res;
-            
-            // Temporary XPath context for the current result block
-            xmlXPathContextPtr itemCtx = xmlXPathNewContext(doc);
-            itemCtx->node = resultNode;
-
-            // --- Extract Title and URL ---
-            // Using './h3' ensures the search is relative to the current resultNode (fixes duplication bug)
-            xmlXPathObjectPtr titleObj = xmlXPathEvalExpression((const xmlChar*)"./h3[@class='gs_rt']/a", itemCtx); 
-            if (titleObj && titleObj->nodesetval && titleObj->nodesetval->nodeNr > 0) {
-                xmlNodePtr titleNode = titleObj->nodesetval->nodeTab[0];
-                res.title = (char*)xmlNodeGetContent(titleNode);
-                res.url = (char*)xmlGetProp(titleNode, (const xmlChar*)"href");
-                
-                xmlXPathFreeObject(titleObj);
-            }
-            
-            // --- Extract Snippet ---
-           xmlXPathObjectPtr snippetObj = xmlXPathEvalExpression((const xmlChar*)"./div[@class='gs_rs']", itemCtx);
-            if (snippetObj && snippetObj->nodesetval && snippetObj->nodesetval->nodeNr > 0) {
-                xmlNodePtr snippetNode = snippetObj->nodesetval->nodeTab[0];
-                res.snippet = (char*)xmlNodeGetContent(snippetNode);
-                
-                // Simple cleanup of the snippet text
-                if (!res.snippet.empty() && res.snippet.length() > 200) {
-                    res.snippet = res.snippet.substr(0, 200) + "...";
-                }
-
-                xmlXPathFreeObject(snippetObj);
-            }
+// --- Helper Implementation 1: Result Page URLs ---
+std::string ScholarSearch::pageUrl(const std::string& query, int page) const {
+    std::string url = baseUrl_ + "?q=" + HttpFetcher::escape(normalizeQuery(query));
+    if (page > 1) url += "&start=" + std::to_string(10 * (page - 1));
+    return url;
+}
 
-            // Only add the result if we successfully got a title and URL
-            if (!res.title.empty() && !res.url.empty()) {
-                results.push_back(res);
-            }
-            xmlXPathFreeContext(itemCtx);
-        }
+HttpRequest ScholarSearch::pageRequest(const std::string& url, const CachedScholarPage* cached) const {
+    HttpRequest request{url, {}, nullptr};
+    if (cached) {
+        if (!cached->etag.empty()) request.headers.push_back("If-None-Match: " + cached->etag);
+        if (!cached->lastModified.empty()) request.headers.push_back("If-Modified-Since: " + cached->lastModified);
     }
-
-    // 4. Clean up libxml2 resources
-    if (xpathObj) xmlXPathFreeObject(xpathObj);
-    if (xpathCtx) xmlXPathFreeContext(xpathCtx);
-    if (doc) xmlFreeDoc(doc);
-    
-    xmlCleanupParser();
-    xmlMemoryDump();
-
-    return results;
+    return request;
 }
 
 // --- Core Search Function (DEBUG ENABLED) ---
-std::vector<ScholarResult> ScholarSearch::search(const std::string& query) const {
-    // URL-encode the query
-    std::string encodedQuery;
-    char* escaped = curl_easy_escape(NULL, query.c_str(), query.length());
-    if (escaped) {
-        encodedQuery = escaped;
-        curl_free(escaped);
-    }
-
+std::vector<ScholarResult> ScholarSearch::search(const std::string& query) {
     // Construct the Google Scholar URL
-    std::string scholarUrl = "https://scholar.google.com/scholar?q=" + encodedQuery;
+    std::string scholarUrl = pageUrl(query, 1);
+    auto start = std::chrono::steady_clock::now();
+
+    CachedScholarPage cached;
+    bool haveCached = cache_ && cache_->lookup(scholarUrl, cached);
+    if (haveCached && cache_->isFresh(cached)) {
+        cache_->recordHit();
+        std::cout << "\n[Cache] Served " << scholarUrl << " from the response cache in " << std::fixed
+                  << std::setprecision(2) << millisecondsSince(start) << " ms" << std::endl;
+        return cached.results;
+    }
     
     std::cout << "\n[Status] Fetching results from Google Scholar: " << scholarUrl << std::endl;
 
-    // 1. Fetch HTML
-    std::string html = fetchHtml(scholarUrl);
-    
-    if (html.empty()) {
+    // 1. Fetch HTML, parsing it as it arrives; only the start is kept for the debug print
+    ScholarResultParser parser;
+    std::string head;
+    HttpRequest request = pageRequest(scholarUrl, haveCached ? &cached : nullptr);
+    request.onBody = [&](const char* data, size_t size) {
+        if (head.size() < 500) head.append(data, std::min(size, 500 - head.size()));
+        parser.feed(data, size);
+    };
+    ProfileScope fetchScope("scholar fetch");
+    HttpResponse response = fetcher_.fetchAll(std::vector<HttpRequest>{request})[0];
+    fetchScope.addBytes(parser.bytesFed());
+    fetchScope.addItems(1);
+    fetchScope.finish();
+    if (!response.error.empty()) {
+        std::cerr << "[cURL Error] Failed to fetch URL " << scholarUrl << ": " << response.error << std::endl;
+    }
+    if (haveCached && response.status == 304) {
+        cache_->recordRevalidation();
+        cache_->touch(scholarUrl, cached);
+        std::cout << "[Cache] Revalidated cached results (304 Not Modified) in " << std::fixed << std::setprecision(2)
+                  << millisecondsSince(start) << " ms" << std::endl;
+        return cached.results;
+    }
+    if (parser.bytesFed() == 0) {
         std::cerr << "[Error] Failed to get content from Google Scholar. Check network or User-Agent." << std::endl;
+        if (haveCached) {
+            std::cout << "[Cache] Using the stale cached results instead." << std::endl;
+            return cached.results;
+        }
         return {};
     }
 
     // DEBUG: Print the start of the received HTML to diagnose blocking/CAPTCHA
     std::cout << "\n[DEBUG] HTML Snippet Received (First 500 chars):\n";
     std::cout << "---------------------------------------------------\n";
-    std::cout << (html.length() > 500 ? html.substr(0, 500) : html) << "\n";
+    std::cout << head << "\n";
     std::cout << "---------------------------------------------------\n" << std::endl;
 
     // 2. Parse Results
     std::cout << "[Status] Parsing HTML to extract search results..." << std::endl;
-    return parseResults(html);
-}
\ No newline at end of file
+    std::vector<ScholarResult> results = parser.finish();
+    if (results.empty()) {
+        // Likely a CAPTCHA or "unusual traffic" page: never cache it, and prefer what we had
+        if (haveCached) {
+            std::cout << "[Cache] No results parsed; using the stale cached results instead." << std::endl;
+            return cached.results;
+        }
+        return results;
+    }
+    if (cache_ && response.ok()) {
+        cache_->recordMiss();
+        cache_->store(scholarUrl, CachedScholarPage{results, response.etag, response.lastModified, ScholarCache::now()});
+        std::cout << "[Cache] Fetched and cached results in " << std::fixed << std::setprecision(2)
+                  << millisecondsSince(start) << " ms" << std::endl;
+    }
+    return results;
+}
+
+std::vector<ScholarResult> ScholarSearch::search(const std::string& query, int pageCount) {
+    return searchAll(std::vector<std::string>{query}, pageCount)[0];
+}
+
+std::vector<std::vector<ScholarResult>> ScholarSearch::searchAll(const std::vector<std::string>& queries, int pageCount) {
+    pageCount = std::max(1, pageCount);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> urls;
+    urls.reserve(queries.size() * pageCount);
+    for (const auto& query : queries) {
+        for (int page = 1; page <= pageCount; ++page) urls.push_back(pageUrl(query, page));
+    }
+
+    // Fresh cache entries are used as they are; everything else goes to the network,
+    // conditionally if a stale entry has validators
+    std::vector<std::vector<ScholarResult>> pages(urls.size());
+    std::vector<CachedScholarPage> stale;
+    std::vector<size_t> staleOf(urls.size(), SIZE_MAX);
+    std::vector<HttpRequest> requests;
+    std::vector<size_t> pageOf;
+    std::vector<std::unique_ptr<ScholarResultParser>> parsers;
+    size_t fresh = 0;
+    for (size_t i = 0; i < urls.size(); ++i) {
+        CachedScholarPage cached;
+        bool haveCached = cache_ && cache_->lookup(urls[i], cached);
+        if (haveCached && cache_->isFresh(cached)) {
+            cache_->recordHit();
+            pages[i] = std::move(cached.results);
+            fresh++;
+            continue;
+        }
+        if (haveCached) {
+            staleOf[i] = stale.size();
+            stale.push_back(std::move(cached));
+        }
+        // Each page is parsed while it downloads, interleaved with the other transfers
+        ScholarResultParser* parser = new ScholarResultParser();
+        parsers.emplace_back(parser);
+        requests.push_back(pageRequest(urls[i], haveCached ? &stale.back() : nullptr));
+        requests.back().onBody = [parser](const char* data, size_t size) { parser->feed(data, size); };
+        pageOf.push_back(i);
+    }
+
+    size_t revalidated = 0;
+    size_t fetched = 0;
+    if (!requests.empty()) {
+        std::cout << "\n[Status] Fetching " << requests.size() << " Google Scholar page(s), " << fetcher_.maxConcurrent()
+                  << " at a time..." << std::endl;
+        ProfileScope fetchScope("scholar fetch");
+        std::vector<HttpResponse> responses = fetcher_.fetchAll(requests);
+        for (const auto& parser : parsers) fetchScope.addBytes(parser->bytesFed());
+        fetchScope.addItems(requests.size());
+        fetchScope.finish();
+
+        for (size_t r = 0; r < responses.size(); ++r) {
+            const size_t i = pageOf[r];
+            const HttpResponse& response = responses[r];
+            if (response.status == 304 && staleOf[i] != SIZE_MAX) {
+                CachedScholarPage& cached = stale[staleOf[i]];
+                cache_->recordRevalidation();
+                cache_->touch(urls[i], cached);
+                pages[i] = cached.results;
+                revalidated++;
+                continue;
+            }
+            if (!response.error.empty() || parsers[r]->bytesFed() == 0) {
+                std::cerr << "[cURL Error] Failed to fetch URL " << urls[i] << ": "
+                          << (response.error.empty() ? "empty response" : response.error) << std::endl;
+                if (staleOf[i] != SIZE_MAX) pages[i] = stale[staleOf[i]].results;
+                continue;
+            }
+            pages[i] = parsers[r]->finish();
+            if (pages[i].empty()) {
+                // Likely a CAPTCHA or "unusual traffic" page: never cache it, and prefer what we had
+                if (staleOf[i] != SIZE_MAX) pages[i] = stale[staleOf[i]].results;
+                continue;
+            }
+            if (cache_ && response.ok()) {
+                cache_->recordMiss();
+                cache_->store(urls[i], CachedScholarPage{pages[i], response.etag, response.lastModified, ScholarCache::now()});
+            }
+            fetched++;
+        }
+    }
+    if (cache_) {
+        std::cout << "[Cache] " << fresh << " page(s) fresh from cache, " << revalidated << " revalidated, " << fetched
+                  << " fetched in " << std::fixed << std::setprecision(2) << millisecondsSince(start) << " ms"
+                  << std::endl;
+    }
+
+    // Pages are concatenated in order, so each query's results keep the ranking
+    std::vector<std::vector<ScholarResult>> results(queries.size());
+    for (size_t i = 0; i < urls.size(); ++i) {
+        std::vector<ScholarResult>& queryResults = results[i / pageCount];
+        queryResults.insert(queryResults.end(), pages[i].begin(), pages[i].end());
+    }
+    return results;
+}
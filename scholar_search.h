@@ -1,6 +1,12 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <cstddef>
+
+#include "http_fetcher.h"
+
+class ScholarCache;
+struct CachedScholarPage;
 
 // Structure to hold a single online search result
 struct ScholarResult {
@@ -11,20 +17,38 @@ struct ScholarResult {
 
 class ScholarSearch {
 private:
-    // cURL write callback function (C-style function signature required by cURL)
-    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
+    // Builds the URL of result page `page` (1-based, 10 results per page)
+    std::string pageUrl(const std::string& query, int page) const;
 
-    // Helper function to fetch the raw HTML content from a URL using cURL
-    std::string fetchHtml(const std::string& url) const;
+    // Request for `url`, conditional on the validators of `cached` if there is one.
+    HttpRequest pageRequest(const std::string& url, const CachedScholarPage* cached) const;
 
-    // Helper function to parse the HTML content using libxml2
-    std::vector<ScholarResult> parseResults(const std::string& htmlContent) const;
+    std::string baseUrl_;
+    HttpFetcher fetcher_; // Keeps connections and TLS sessions alive between searches
+    const ScholarCache* cache_ = nullptr;
 
 public:
+    static constexpr const char* DEFAULT_BASE_URL = "https://scholar.google.com/scholar";
+
+    /**
+     * @param baseUrl Search endpoint; point it at a local stand-in server to test offline.
+     * @param maxConcurrent Pages fetched at once.
+     */
+    explicit ScholarSearch(const std::string& baseUrl = DEFAULT_BASE_URL, size_t maxConcurrent = 4);
+
+    // Serves repeated searches from `cache` (not owned; nullptr disables caching).
+    void setCache(const ScholarCache* cache) { cache_ = cache; }
+
     /**
      * @brief Performs a search on Google Scholar and returns a list of results.
      * @param query The search topic.
      * @return A vector of ScholarResult objects.
      */
-    std::vector<ScholarResult> search(const std::string& query) const;
-};
\ No newline at end of file
+    std::vector<ScholarResult> search(const std::string& query);
+
+    // Results of pages 1..pageCount, fetched concurrently, in page order.
+    std::vector<ScholarResult> search(const std::string& query, int pageCount);
+
+    // Several searches at once; results[i] holds pages 1..pageCount of queries[i].
+    std::vector<std::vector<ScholarResult>> searchAll(const std::vector<std::string>& queries, int pageCount = 1);
+};
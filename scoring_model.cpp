@@ -0,0 +1,255 @@
+#include "scoring_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// BM25's idf, never negative even for terms in most documents
+double bm25Idf(const IndexReader& index, const PostingList& postings) {
+    const double N = (double)index.documentCount();
+    const double df = (double)postings.size();
+    return std::log(1.0 + (N - df + 0.5) / (df + 0.5));
+}
+
+// Length normalization 1 - b + b * length / averageLength, as offset + slope * length.
+struct LengthNorm {
+    double offset;
+    double slope;
+
+    LengthNorm(double b, uint64_t totalLength, uint64_t documents)
+        : offset(1.0 - b), slope(totalLength > 0 ? b * (double)documents / (double)totalLength : 0.0) {}
+
+    double at(uint32_t length) const { return offset + slope * length; }
+};
+
+// --- BM25 ---
+
+// The per-query constants of BM25: tf / (tf + k1 * norm(length)), scaled by (k1 + 1)
+struct Bm25Terms {
+    double scale;   // weight * (k1 + 1)
+    double offset;  // k1 * (1 - b)
+    double slope;   // k1 * b / averageLength
+
+    Bm25Terms(const IndexReader& index, const Bm25Params& params, double weight) {
+        const CorpusStats corpus = index.corpusStats();
+        LengthNorm norm(params.b, corpus.length, corpus.documents);
+        scale = weight * (params.k1 + 1.0);
+        offset = params.k1 * norm.offset;
+        slope = params.k1 * norm.slope;
+    }
+
+    double score(uint32_t tf, uint32_t length) const {
+        const double t = (double)tf;
+        return scale * t / (t + offset + slope * length);
+    }
+};
+
+// --- BM25F ---
+
+struct Bm25fTerms {
+    double scale;   // weight * (k1 + 1)
+    double k1;
+    double titleWeight, firstPageWeight, bodyWeight;
+    LengthNorm title, firstPage, body;
+
+    Bm25fTerms(const IndexReader& index, const Bm25fParams& params, double weight)
+        : Bm25fTerms(index.corpusStats(), params, weight) {}
+
+    Bm25fTerms(const CorpusStats& corpus, const Bm25fParams& params, double weight)
+        : scale(weight * (params.k1 + 1.0)), k1(params.k1),
+          titleWeight(params.title.weight), firstPageWeight(params.firstPage.weight), bodyWeight(params.body.weight),
+          title(params.title.b, corpus.titleLength, corpus.documents),
+          firstPage(params.firstPage.b, corpus.firstPageLength, corpus.documents),
+          body(params.body.b, bodyLength(corpus), corpus.documents) {}
+
+    static uint64_t bodyLength(const CorpusStats& corpus) {
+        return corpus.length - corpus.titleLength - corpus.firstPageLength;
+    }
+
+    double score(const Posting& posting, const FieldTf& fields, const DocumentStats& doc) const {
+        const uint32_t bodyTf = posting.tf - fields.title - fields.firstPage;
+        const uint32_t bodyLen = doc.length - doc.titleLength - doc.firstPageLength;
+        const double t = titleWeight * fields.title / title.at(doc.titleLength) +
+                         firstPageWeight * fields.firstPage / firstPage.at(doc.firstPageLength) +
+                         bodyWeight * bodyTf / body.at(bodyLen);
+        return scale * t / (t + k1);
+    }
+};
+
+class TfIdfPostingScorer : public ScoringModel::PostingScorer {
+public:
+    TfIdfPostingScorer(const PostingList& postings, double weight) : postings_(postings), weight_(weight) {}
+
+    double score(size_t i) const override { return (1.0 + std::log((double)postings_.data[i].tf)) * weight_; }
+
+private:
+    PostingList postings_;
+    double weight_;
+};
+
+class Bm25PostingScorer : public ScoringModel::PostingScorer {
+public:
+    Bm25PostingScorer(const IndexReader& index, const Bm25Params& params, const PostingList& postings, double weight)
+        : terms_(index, params, weight), docs_(index.documentStats()), postings_(postings) {}
+
+    double score(size_t i) const override {
+        const Posting& posting = postings_.data[i];
+        return terms_.score(posting.tf, docs_[posting.docId].length);
+    }
+
+private:
+    Bm25Terms terms_;
+    const DocumentStats* docs_;
+    PostingList postings_;
+};
+
+class Bm25fPostingScorer : public ScoringModel::PostingScorer {
+public:
+    Bm25fPostingScorer(const IndexReader& index, const Bm25fParams& params, const PostingList& postings, double weight)
+        : terms_(index, params, weight), docs_(index.documentStats()), postings_(postings) {}
+
+    double score(size_t i) const override {
+        const Posting& posting = postings_.data[i];
+        return terms_.score(posting, postings_.fields[i], docs_[posting.docId]);
+    }
+
+private:
+    Bm25fTerms terms_;
+    const DocumentStats* docs_;
+    PostingList postings_;
+};
+
+} // namespace
+
+// --- TfIdfModel ---
+
+double TfIdfModel::termWeight(const IndexReader& index, const PostingList& postings) const {
+    // Standard IDF formula; the postings length is the document frequency
+    const double N = (double)index.documentCount();
+    return std::log(N / (1.0 + postings.size()));
+}
+
+void TfIdfModel::accumulate(const IndexReader&, const PostingList& postings, double weight, double* sums) const {
+    for (const Posting& posting : postings) {
+        // '1 + log(tf)': a count of 10 scores ~3.3, a count of 1000 ~7.9 (not 1000!)
+        double tfSaturated = 1.0 + std::log((double)posting.tf);
+        sums[posting.docId] += tfSaturated * weight;
+    }
+}
+
+std::unique_ptr<ScoringModel::PostingScorer> TfIdfModel::postingScorer(const IndexReader&, const PostingList& postings,
+                                                                       double weight) const {
+    return std::make_unique<TfIdfPostingScorer>(postings, weight);
+}
+
+double TfIdfModel::upperBound(const IndexReader&, const PostingList& postings, double weight) const {
+    return std::max(weight, 0.0) * postings.bounds.maxTfWeight;
+}
+
+double TfIdfModel::phraseBound(const IndexReader&, const PostingList& postings) const {
+    return 100.0 * postings.bounds.maxNorm;
+}
+
+double TfIdfModel::termCeiling(double) const {
+    // 1 + log tf grows without bound
+    return HUGE_VAL;
+}
+
+double TfIdfModel::finalScore(const IndexReader& index, uint32_t docId, double sum, bool phraseMatched) const {
+    // Boosted from 50.0 to 100.0 to fight the large textbooks harder
+    if (phraseMatched) sum += 100.0;
+    double docLength = (double)index.documentLength(docId);
+    if (docLength < 1.0) docLength = 1.0;
+    return sum / std::sqrt(docLength);
+}
+
+// --- Bm25Model ---
+
+double Bm25Model::termWeight(const IndexReader& index, const PostingList& postings) const {
+    return bm25Idf(index, postings);
+}
+
+void Bm25Model::accumulate(const IndexReader& index, const PostingList& postings, double weight,
+                           double* sums) const {
+    const Bm25Terms terms(index, params_, weight);
+    const DocumentStats* docs = index.documentStats();
+    for (const Posting& posting : postings) {
+        sums[posting.docId] += terms.score(posting.tf, docs[posting.docId].length);
+    }
+}
+
+std::unique_ptr<ScoringModel::PostingScorer> Bm25Model::postingScorer(const IndexReader& index, const PostingList& postings,
+                                                                      double weight) const {
+    return std::make_unique<Bm25PostingScorer>(index, params_, postings, weight);
+}
+
+double Bm25Model::upperBound(const IndexReader& index, const PostingList& postings, double weight) const {
+    // tf / (tf + K) grows with tf and shrinks with length: take the largest tf at length 0
+    return Bm25Terms(index, params_, weight).score(postings.bounds.maxTf, 0);
+}
+
+double Bm25Model::phraseBound(const IndexReader&, const PostingList&) const {
+    return params_.phraseBonus;
+}
+
+double Bm25Model::termCeiling(double weight) const {
+    // tf / (tf + K) tends to 1
+    return std::max(weight, 0.0) * (params_.k1 + 1.0);
+}
+
+double Bm25Model::finalScore(const IndexReader&, uint32_t, double sum, bool phraseMatched) const {
+    return phraseMatched ? sum + params_.phraseBonus : sum;
+}
+
+// --- Bm25fModel ---
+
+double Bm25fModel::termWeight(const IndexReader& index, const PostingList& postings) const {
+    return bm25Idf(index, postings);
+}
+
+void Bm25fModel::accumulate(const IndexReader& index, const PostingList& postings, double weight,
+                            double* sums) const {
+    const Bm25fTerms terms(index, params_, weight);
+    const DocumentStats* docs = index.documentStats();
+    for (size_t i = 0; i < postings.size(); ++i) {
+        const Posting& posting = postings.data[i];
+        sums[posting.docId] += terms.score(posting, postings.fields[i], docs[posting.docId]);
+    }
+}
+
+std::unique_ptr<ScoringModel::PostingScorer> Bm25fModel::postingScorer(const IndexReader& index,
+                                                                       const PostingList& postings,
+                                                                       double weight) const {
+    return std::make_unique<Bm25fPostingScorer>(index, params_, postings, weight);
+}
+
+double Bm25fModel::upperBound(const IndexReader&, const PostingList& postings, double weight) const {
+    // Every field norm is at least 1 - b. The first page and the body share
+    // the non-title tf, so only the better of their two rates counts.
+    const double titleRate = params_.title.weight / (1.0 - params_.title.b);
+    const double textRate = std::max(params_.firstPage.weight / (1.0 - params_.firstPage.b),
+                                     params_.body.weight / (1.0 - params_.body.b));
+    const double t = titleRate * postings.bounds.maxTitleTf + textRate * postings.bounds.maxTf;
+    return weight * (params_.k1 + 1.0) * t / (t + params_.k1);
+}
+
+double Bm25fModel::phraseBound(const IndexReader&, const PostingList&) const {
+    return params_.phraseBonus;
+}
+
+double Bm25fModel::termCeiling(double weight) const {
+    // t / (t + k1) tends to 1
+    return std::max(weight, 0.0) * (params_.k1 + 1.0);
+}
+
+double Bm25fModel::finalScore(const IndexReader&, uint32_t, double sum, bool phraseMatched) const {
+    return phraseMatched ? sum + params_.phraseBonus : sum;
+}
+
+std::shared_ptr<const ScoringModel> makeScoringModel(const std::string& name) {
+    if (name == "tfidf") return std::make_shared<TfIdfModel>();
+    if (name == "bm25") return std::make_shared<Bm25Model>();
+    if (name == "bm25f") return std::make_shared<Bm25fModel>();
+    return nullptr;
+}
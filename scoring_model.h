@@ -0,0 +1,150 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "index_reader.h"
+
+/**
+ * @brief How RelevanceScorer turns postings into document scores.
+ *
+ * A document's score is finalScore() of the sum of its postings' scores over
+ * the query terms. Every call works on a whole postings list or one candidate
+ * document, so virtual dispatch happens once per query term, never per posting.
+ * Models read the index's precomputed document and corpus statistics; nothing
+ * is recomputed per call beyond a few per-query constants.
+ */
+class ScoringModel {
+public:
+    // Scores single postings of one query term. Built once per term, so it holds
+    // every per-term constant and each posting only pays for its tf saturation.
+    class PostingScorer {
+    public:
+        virtual ~PostingScorer() = default;
+        // Score of the i-th posting alone, exactly as accumulate() adds it.
+        virtual double score(size_t i) const = 0;
+    };
+
+    virtual ~ScoringModel() = default;
+
+    virtual const char* name() const = 0;
+
+    // Weight of a query term (its IDF) given its postings.
+    virtual double termWeight(const IndexReader& index, const PostingList& postings) const = 0;
+
+    // Adds the score of every posting in `postings` to sums[docId].
+    virtual void accumulate(const IndexReader& index, const PostingList& postings, double weight,
+                            double* sums) const = 0;
+
+    // Scorer for single postings of `postings` at `weight`; the index must outlive it.
+    virtual std::unique_ptr<PostingScorer> postingScorer(const IndexReader& index, const PostingList& postings,
+                                                         double weight) const = 0;
+
+    // Upper bound on what one posting of the list adds to a final score (for WAND).
+    virtual double upperBound(const IndexReader& index, const PostingList& postings, double weight) const = 0;
+
+    // Upper bound on what the phrase bonus adds to the final score of a document in `postings`.
+    virtual double phraseBound(const IndexReader& index, const PostingList& postings) const = 0;
+
+    // What one query term of `weight` adds to a final score at most, over every
+    // possible tf and document; HUGE_VAL if that is unbounded.
+    virtual double termCeiling(double weight) const = 0;
+
+    // Final score of a document from its summed posting scores. Must not
+    // decrease as `sum` grows, and the bonus must never lower it.
+    virtual double finalScore(const IndexReader& index, uint32_t docId, double sum, bool phraseMatched) const = 0;
+};
+
+/**
+ * @brief The original ranking: (1 + log tf) * log(N / (1 + df)) per term, plus a
+ * bonus of 100 for the exact phrase, all divided by sqrt(document length).
+ * PDF metadata (FIELD_TITLE) is indexed as text like the pages, so documents
+ * that have Title, Subject or Keywords info score differently than they did
+ * before metadata was indexed.
+ */
+class TfIdfModel : public ScoringModel {
+public:
+    const char* name() const override { return "tfidf"; }
+    double termWeight(const IndexReader& index, const PostingList& postings) const override;
+    void accumulate(const IndexReader& index, const PostingList& postings, double weight,
+                    double* sums) const override;
+    std::unique_ptr<PostingScorer> postingScorer(const IndexReader& index, const PostingList& postings,
+                                                 double weight) const override;
+    double upperBound(const IndexReader& index, const PostingList& postings, double weight) const override;
+    double phraseBound(const IndexReader& index, const PostingList& postings) const override;
+    double termCeiling(double weight) const override;
+    double finalScore(const IndexReader& index, uint32_t docId, double sum, bool phraseMatched) const override;
+};
+
+struct Bm25Params {
+    double k1 = 1.2;
+    double b = 0.75;
+    double phraseBonus = 2.0;  // Added once for the exact phrase
+};
+
+/**
+ * @brief Okapi BM25 over the whole document text:
+ * idf * tf * (k1 + 1) / (tf + k1 * (1 - b + b * length / averageLength)),
+ * with idf = log(1 + (N - df + 0.5) / (df + 0.5)).
+ */
+class Bm25Model : public ScoringModel {
+public:
+    explicit Bm25Model(const Bm25Params& params = Bm25Params()) : params_(params) {}
+
+    const char* name() const override { return "bm25"; }
+    double termWeight(const IndexReader& index, const PostingList& postings) const override;
+    void accumulate(const IndexReader& index, const PostingList& postings, double weight,
+                    double* sums) const override;
+    std::unique_ptr<PostingScorer> postingScorer(const IndexReader& index, const PostingList& postings,
+                                                 double weight) const override;
+    double upperBound(const IndexReader& index, const PostingList& postings, double weight) const override;
+    double phraseBound(const IndexReader& index, const PostingList& postings) const override;
+    double termCeiling(double weight) const override;
+    double finalScore(const IndexReader& index, uint32_t docId, double sum, bool phraseMatched) const override;
+
+private:
+    Bm25Params params_;
+};
+
+// Weight and length normalization of one field in BM25F. b must be below 1.
+struct FieldParams {
+    double weight;
+    double b;
+};
+
+struct Bm25fParams {
+    double k1 = 1.2;
+    FieldParams title{3.0, 0.5};
+    FieldParams firstPage{1.5, 0.75};
+    FieldParams body{1.0, 0.75};
+    double phraseBonus = 2.0;
+};
+
+/**
+ * @brief BM25F: each field's tf is normalized by that field's length and
+ * weighted, and the weighted sum saturates once, like BM25's tf:
+ * t = sum over fields of weight * tf / (1 - b + b * length / averageLength),
+ * score = idf * t * (k1 + 1) / (t + k1).
+ */
+class Bm25fModel : public ScoringModel {
+public:
+    explicit Bm25fModel(const Bm25fParams& params = Bm25fParams()) : params_(params) {}
+
+    const char* name() const override { return "bm25f"; }
+    double termWeight(const IndexReader& index, const PostingList& postings) const override;
+    void accumulate(const IndexReader& index, const PostingList& postings, double weight,
+                    double* sums) const override;
+    std::unique_ptr<PostingScorer> postingScorer(const IndexReader& index, const PostingList& postings,
+                                                 double weight) const override;
+    double upperBound(const IndexReader& index, const PostingList& postings, double weight) const override;
+    double phraseBound(const IndexReader& index, const PostingList& postings) const override;
+    double termCeiling(double weight) const override;
+    double finalScore(const IndexReader& index, uint32_t docId, double sum, bool phraseMatched) const override;
+
+private:
+    Bm25fParams params_;
+};
+
+// "tfidf", "bm25" or "bm25f" with default parameters; null for any other name.
+std::shared_ptr<const ScoringModel> makeScoringModel(const std::string& name);
@@ -0,0 +1,63 @@
+#include "term_dictionary.h"
+
+#include <cstring>
+
+uint32_t TermDictionary::hashOf(std::string_view term) {
+    // FNV-1a: terms are short, so this beats anything fancier
+    uint32_t hash = 2166136261u;
+    for (char c : term) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+size_t TermDictionary::probe(std::string_view term, uint32_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        uint32_t id = slots_[slot];
+        if (id == NOT_FOUND) return slot;
+        const Entry& entry = entries_[id];
+        if (entry.hash == hash && entry.length == term.size() &&
+            std::memcmp(pool_.data() + entry.offset, term.data(), term.size()) == 0) {
+            return slot;
+        }
+    }
+}
+
+uint32_t TermDictionary::find(std::string_view term) const {
+    if (entries_.empty()) return NOT_FOUND;
+    return slots_[probe(term, hashOf(term))];
+}
+
+uint32_t TermDictionary::intern(std::string_view term) {
+    // Keep the load factor at or below 1/2
+    if ((entries_.size() + 1) * 2 > slots_.size()) grow();
+
+    const uint32_t hash = hashOf(term);
+    const size_t slot = probe(term, hash);
+    if (slots_[slot] != NOT_FOUND) return slots_[slot];
+
+    const uint32_t id = static_cast<uint32_t>(entries_.size());
+    entries_.push_back(Entry{pool_.size(), static_cast<uint32_t>(term.size()), hash});
+    pool_.insert(pool_.end(), term.begin(), term.end());
+    slots_[slot] = id;
+    return id;
+}
+
+void TermDictionary::grow() {
+    std::vector<uint32_t> slots(slots_.empty() ? 1024 : slots_.size() * 2, NOT_FOUND);
+    const size_t mask = slots.size() - 1;
+    for (uint32_t id = 0; id < entries_.size(); ++id) {
+        size_t slot = entries_[id].hash & mask;
+        while (slots[slot] != NOT_FOUND) slot = (slot + 1) & mask;
+        slots[slot] = id;
+    }
+    slots_.swap(slots);
+}
+
+void TermDictionary::clear() {
+    pool_.clear();
+    entries_.clear();
+    slots_.clear();
+}
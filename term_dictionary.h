@@ -0,0 +1,49 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Interns terms into dense 32-bit ids (0, 1, 2, ... in first-seen order).
+ *
+ * Term bytes live back to back in one growing pool and the lookup table is an
+ * open-addressing array of ids, so interning a known term never allocates and
+ * looking one up takes a string_view without building a std::string.
+ * Ids are never reused or invalidated.
+ */
+class TermDictionary {
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    // Id of `term`, adding it if it is new.
+    uint32_t intern(std::string_view term);
+
+    // Id of `term`, or NOT_FOUND.
+    uint32_t find(std::string_view term) const;
+
+    // Bytes of term `id`. The view is invalidated by the next intern().
+    std::string_view term(uint32_t id) const {
+        const Entry& entry = entries_[id];
+        return std::string_view(pool_.data() + entry.offset, entry.length);
+    }
+
+    size_t size() const { return entries_.size(); }
+    void clear();
+
+private:
+    struct Entry {
+        uint64_t offset;
+        uint32_t length;
+        uint32_t hash;
+    };
+
+    static uint32_t hashOf(std::string_view term);
+    // Slot holding `term`, or the empty slot where it would go.
+    size_t probe(std::string_view term, uint32_t hash) const;
+    void grow();
+
+    std::vector<char> pool_;
+    std::vector<Entry> entries_;  // Indexed by id
+    std::vector<uint32_t> slots_; // Ids, NOT_FOUND when empty; size is a power of two
+};
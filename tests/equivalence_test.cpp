@@ -0,0 +1,380 @@
+// Checks that the optimized paths return exactly what their straightforward
+// counterparts do, on corpora from bench/synthetic_corpus:
+//
+//   pdf_organizer_equivalence_test topk       WAND topDocuments vs. the first k of scoreDocuments
+//   pdf_organizer_equivalence_test index      an index under random churn vs. one built from scratch
+//   pdf_organizer_equivalence_test tokenizer  the active tokenizer kernel vs. the stringstream tokenizer
+//
+// CTest runs the tokenizer check once per kernel through PDF_ORGANIZER_TOKENIZER;
+// a kernel this CPU lacks is reported as skipped (exit code 77).
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "synthetic_corpus.h"
+#include "relevance_scorer.h"
+#include "scoring_model.h"
+#include "inverted_index.h"
+#include "index_file.h"
+#include "near_duplicates.h"
+#include "tokenizer.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const int EXIT_SKIPPED = 77;
+const size_t MAX_REPORTED_FAILURES = 20;
+
+size_t failures = 0;
+
+void fail(const std::string& what) {
+    if (failures++ < MAX_REPORTED_FAILURES) std::cerr << "[FAIL] " << what << std::endl;
+}
+
+fs::path scratchDirectory() {
+    fs::path path = fs::temp_directory_path() / ("pdf_organizer_test_" + std::to_string(getpid()));
+    fs::create_directories(path);
+    return path;
+}
+
+// Indexes document `index` of `corpus` the way the incremental indexer does: title, first page, body.
+void indexDocument(const RelevanceScorer& scorer, InvertedIndex& index, const std::string& path,
+                   const SyntheticCorpus& corpus, size_t document) {
+    std::vector<std::string> pages = corpus.pages(document);
+    index.beginDocument();
+    uint32_t position = scorer.indexText(index, corpus.title(document) + "\n\n", 0, FIELD_TITLE);
+    for (size_t page = 0; page < pages.size(); ++page) {
+        position = scorer.indexText(index, pages[page], position, page == 0 ? FIELD_FIRST_PAGE : FIELD_BODY);
+    }
+    index.endDocument(path, DocumentStamp{document, static_cast<int64_t>(document)});
+}
+
+// --- topk: WAND against the exhaustive ranking ---
+
+bool sameResults(const std::vector<DocumentScore>& actual, const std::vector<DocumentScore>& expected) {
+    if (actual.size() != expected.size()) return false;
+    for (size_t i = 0; i < actual.size(); ++i) {
+        if (actual[i].filePath != expected[i].filePath || actual[i].score != expected[i].score ||
+            actual[i].duplicates != expected[i].duplicates) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int checkTopK() {
+    SyntheticCorpusOptions options;
+    options.documents = 400;
+    options.wordsPerDocument = 800;
+    options.wordsPerPage = 200;
+    options.vocabularySize = 3000;
+    SyntheticCorpus corpus(options);
+
+    RelevanceScorer indexer;
+    InvertedIndex index;
+    for (size_t i = 0; i < corpus.options().documents; ++i) {
+        indexDocument(indexer, index, "doc" + std::to_string(i) + ".pdf", corpus, i);
+    }
+    // Exact copies, so collapsing near-duplicates has clusters to work on
+    for (size_t i = 0; i < 10; ++i) {
+        indexDocument(indexer, index, "copy" + std::to_string(i) + ".pdf", corpus, i * 7);
+    }
+    const fs::path indexFile = scratchDirectory() / "topk.idx";
+    MappedIndex mapped;
+    if (!writeIndexFile(index, indexFile.string()) || !mapped.open(indexFile.string())) {
+        fail("could not save and map the index");
+        return 1;
+    }
+
+    std::vector<std::string> topics = corpus.topics(40, 3);
+    for (const std::string& topic : corpus.topics(20, 1)) topics.push_back(topic);
+    for (const std::string& topic : corpus.topics(10, 2)) topics.push_back(topic);
+    for (size_t i = 0; i < 10; ++i) topics.push_back(corpus.title(i * 13)); // Phrase matches
+    topics.push_back("unknownterm " + corpus.vocabulary()[5]);
+    topics.push_back("the of and");
+    topics.push_back("");
+
+    const std::vector<size_t> ks = {1, 3, 10, 100, 1000};
+    size_t comparisons = 0;
+    for (const char* modelName : {"tfidf", "bm25", "bm25f"}) {
+        RelevanceScorer scorer(makeScoringModel(modelName));
+        for (const IndexReader* reader : {static_cast<const IndexReader*>(&index),
+                                          static_cast<const IndexReader*>(&mapped)}) {
+            NearDuplicates duplicates;
+            duplicates.build(*reader);
+            for (bool collapse : {false, true}) {
+                scorer.setNearDuplicates(collapse ? &duplicates : nullptr);
+                for (const std::string& topic : topics) {
+                    std::vector<DocumentScore> full = scorer.scoreDocuments(*reader, topic);
+                    for (size_t k : ks) {
+                        std::vector<DocumentScore> expected(full.begin(), full.begin() + std::min(k, full.size()));
+                        if (!sameResults(scorer.topDocuments(*reader, topic, k), expected)) {
+                            fail(std::string(modelName) + (reader == &index ? " in memory" : " mapped") +
+                                 (collapse ? ", collapsed" : "") + ", k=" + std::to_string(k) + ": \"" + topic + "\"");
+                        }
+                        comparisons++;
+                    }
+                }
+            }
+        }
+    }
+    mapped.close();
+    fs::remove_all(indexFile.parent_path());
+    std::cout << comparisons << " top-k rankings compared, " << failures << " mismatches." << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+// --- index: in-place updates against a fresh build ---
+
+// Everything a reader can see of one index, keyed by path so doc ids do not matter
+struct IndexContents {
+    std::map<std::string, std::vector<std::string>> postings; // term -> "path tf title firstPage: positions"
+    std::map<std::string, std::string> documents;             // path -> stats, stamp, signature
+    std::map<std::string, DocumentStamp> skipped;
+    CorpusStats totals;
+    size_t termCount = 0;
+};
+
+IndexContents contentsOf(const InvertedIndex& index) {
+    IndexContents contents;
+    index.forEachTerm([&](std::string_view term, PostingList list) {
+        std::vector<std::string>& entries = contents.postings[std::string(term)];
+        for (size_t i = 0; i < list.size(); ++i) {
+            const uint32_t docId = list.data[i].docId;
+            if (i > 0 && list.data[i - 1].docId >= docId) fail("postings of \"" + std::string(term) + "\" unsorted");
+            std::ostringstream entry;
+            entry << index.documentPath(docId) << ' ' << list.data[i].tf << ' ' << list.fields[i].title << ' '
+                  << list.fields[i].firstPage << ':';
+            for (uint32_t position : index.positions(term, docId)) entry << ' ' << position;
+            entries.push_back(entry.str());
+        }
+        std::sort(entries.begin(), entries.end());
+    });
+    for (uint32_t docId = 0; docId < index.documentCount(); ++docId) {
+        const DocumentStats& stats = index.documentStats()[docId];
+        const DocumentStamp& stamp = index.documentStamp(docId);
+        std::ostringstream document;
+        document << stats.length << ' ' << stats.titleLength << ' ' << stats.firstPageLength << ' ' << stamp.size
+                 << ' ' << stamp.mtime << ':';
+        for (uint32_t value : index.documentSignatures()[docId].values) document << ' ' << value;
+        contents.documents[std::string(index.documentPath(docId))] = document.str();
+    }
+    contents.skipped = index.skippedFiles();
+    contents.totals = index.corpusStats();
+    contents.termCount = index.termCount();
+    return contents;
+}
+
+void compareIndexes(const InvertedIndex& updated, const InvertedIndex& fresh, const std::string& when) {
+    IndexContents actual = contentsOf(updated);
+    IndexContents expected = contentsOf(fresh);
+    if (actual.postings != expected.postings) fail(when + ": postings differ");
+    if (actual.documents != expected.documents) fail(when + ": documents differ");
+    if (actual.skipped != expected.skipped) fail(when + ": skipped files differ");
+    if (actual.termCount != expected.termCount) fail(when + ": term counts differ");
+    if (actual.totals.documents != expected.totals.documents || actual.totals.length != expected.totals.length ||
+        actual.totals.titleLength != expected.totals.titleLength ||
+        actual.totals.firstPageLength != expected.totals.firstPageLength) {
+        fail(when + ": corpus totals differ");
+    }
+    // Bounds may stay loose after removals, but never drop below the true maxima
+    fresh.forEachTerm([&](std::string_view term, PostingList list) {
+        const TermBounds bounds = updated.postings(term).bounds;
+        if (bounds.maxTfWeight < list.bounds.maxTfWeight || bounds.maxNorm < list.bounds.maxNorm ||
+            bounds.maxTf < list.bounds.maxTf || bounds.maxTitleTf < list.bounds.maxTitleTf) {
+            fail(when + ": bounds of \"" + std::string(term) + "\" below the true maxima");
+        }
+    });
+}
+
+int checkIndexChurn() {
+    SyntheticCorpusOptions options;
+    options.documents = 200;
+    options.wordsPerDocument = 300;
+    options.wordsPerPage = 100;
+    options.vocabularySize = 2000;
+    SyntheticCorpus corpus(options);
+    RelevanceScorer scorer;
+
+    const size_t PATHS = 120;
+    const size_t STEPS = 3000;
+    const size_t CHECK_EVERY = 500;
+    const fs::path indexFile = scratchDirectory() / "churn.idx";
+
+    std::mt19937_64 rng(9);
+    InvertedIndex index;
+    std::map<std::string, size_t> live;            // path -> corpus document
+    std::map<std::string, DocumentStamp> skipped;
+    size_t copies = 0, reloads = 0;
+    for (size_t step = 1; step <= STEPS; ++step) {
+        const std::string path = "doc" + std::to_string(rng() % PATHS) + ".pdf";
+        const unsigned op = rng() % 100;
+        if (op < 55) {
+            // Add, or replace what the path held
+            const size_t document = rng() % corpus.options().documents;
+            indexDocument(scorer, index, path, corpus, document);
+            live[path] = document;
+            skipped.erase(path);
+        } else if (op < 85) {
+            index.removeFile(path);
+            live.erase(path);
+            skipped.erase(path);
+        } else if (op < 90) {
+            const DocumentStamp stamp{step, 0};
+            index.addSkippedFile(path, stamp);
+            live.erase(path);
+            skipped[path] = stamp;
+        } else if (op < 95) {
+            InvertedIndex copy(index);
+            index = copy;
+            copies++;
+        } else {
+            InvertedIndex loaded;
+            if (!writeIndexFile(index, indexFile.string()) || !readIndexFile(indexFile.string(), loaded)) {
+                fail("step " + std::to_string(step) + ": could not save and reload the index");
+                break;
+            }
+            index = std::move(loaded);
+            reloads++;
+        }
+
+        if (step % CHECK_EVERY == 0) {
+            InvertedIndex fresh;
+            for (const auto& entry : live) indexDocument(scorer, fresh, entry.first, corpus, entry.second);
+            for (const auto& entry : skipped) fresh.addSkippedFile(entry.first, entry.second);
+            compareIndexes(index, fresh, "step " + std::to_string(step));
+        }
+    }
+    fs::remove_all(indexFile.parent_path());
+    std::cout << STEPS << " updates (" << copies << " copies, " << reloads << " reloads), "
+              << failures << " mismatches." << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+// --- tokenizer: every kernel against the original stringstream tokenizer ---
+
+using Tokens = std::vector<std::pair<std::string, uint32_t>>;
+
+// The tokenizer before the kernels: split on whitespace, keep letters and digits folded to lower case
+Tokens referenceTokens(const std::string& text) {
+    static const std::set<std::string> STOP_WORDS = {"the", "and", "a",  "an", "in",  "on",  "of",
+                                                     "for", "with", "to", "is", "are", "was", "were"};
+    Tokens tokens;
+    std::istringstream words(text);
+    std::string word;
+    uint32_t position = 0;
+    while (words >> word) {
+        std::string token;
+        for (char c : word) {
+            if (std::isalnum(static_cast<unsigned char>(c))) {
+                token += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+        }
+        if (token.empty()) continue;
+        if (!STOP_WORDS.count(token)) tokens.emplace_back(token, position);
+        position++;
+    }
+    return tokens;
+}
+
+Tokens kernelTokens(std::string_view text) {
+    Tokens tokens;
+    Tokenizer::forEachPositionedToken(text, [&](std::string_view token, uint32_t position) {
+        tokens.emplace_back(std::string(token), position);
+    });
+    return tokens;
+}
+
+// Text dense in everything the kernels branch on: whitespace of every kind,
+// case, digits, punctuation, bytes >= 0x80 and NULs, in runs of any length
+std::string randomText(std::mt19937_64& rng, size_t length) {
+    static const std::string ALPHABET =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 \t\n\v\f\r.,;:-()[]'\"@/";
+    std::string text;
+    text.reserve(length);
+    while (text.size() < length) {
+        const unsigned kind = rng() % 10;
+        size_t run = 1 + rng() % (rng() % 8 == 0 ? 80 : 12);
+        for (size_t i = 0; i < run && text.size() < length; ++i) {
+            if (kind == 0) {
+                text += static_cast<char>(0x80 + rng() % 0x80);
+            } else if (kind == 1) {
+                text += static_cast<char>(rng() % 0x20);
+            } else if (kind < 4) {
+                text += ALPHABET[52 + rng() % (ALPHABET.size() - 52)];
+            } else {
+                text += ALPHABET[rng() % 62];
+            }
+        }
+    }
+    return text;
+}
+
+void compareTokens(std::string_view text, const std::string& what) {
+    if (kernelTokens(text) != referenceTokens(std::string(text))) fail(what);
+}
+
+int checkTokenizer() {
+    const char* forced = std::getenv("PDF_ORGANIZER_TOKENIZER");
+    if (forced && *forced && std::strcmp(forced, Tokenizer::kernelName()) != 0) {
+        std::cout << "The " << forced << " kernel is not available on this CPU; skipped." << std::endl;
+        return EXIT_SKIPPED;
+    }
+
+    SyntheticCorpusOptions options;
+    options.documents = 100;
+    options.wordsPerDocument = 1000;
+    SyntheticCorpus corpus(options);
+    size_t texts = 0;
+    for (size_t i = 0; i < corpus.options().documents; ++i) {
+        compareTokens(corpus.text(i), "synthetic document " + std::to_string(i));
+        texts++;
+    }
+
+    std::mt19937_64 rng(5);
+    for (size_t i = 0; i < 3000; ++i) {
+        const std::string text = randomText(rng, rng() % (i % 10 == 0 ? 4000 : 300));
+        compareTokens(text, "random text " + std::to_string(i));
+        // Every alignment of the kernels' loads
+        const size_t offset = 1 + rng() % 31;
+        if (offset < text.size()) {
+            compareTokens(std::string_view(text).substr(offset), "random text " + std::to_string(i) + " at +" +
+                                                                     std::to_string(offset));
+        }
+        texts += 2;
+    }
+
+    // Runs longer than the scratch buffer keeps, then ordinary text on the same thread
+    std::string longRun(100000, 'Q');
+    longRun += " tail of the text";
+    compareTokens(longRun, "100000-byte token");
+    compareTokens("after the long token", "text after a long token");
+    texts += 2;
+
+    std::cout << texts << " texts tokenized with the " << Tokenizer::kernelName() << " kernel, " << failures
+              << " mismatches." << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string check = argc > 1 ? argv[1] : "";
+    if (check == "topk") return checkTopK();
+    if (check == "index") return checkIndexChurn();
+    if (check == "tokenizer") return checkTokenizer();
+    std::cerr << "Usage: " << argv[0] << " topk|index|tokenizer" << std::endl;
+    return 2;
+}
@@ -0,0 +1,122 @@
+// Checks ScholarResultParser against the results a saved page is known to hold:
+//
+//   pdf_organizer_scholar_parser_test PAGE.html PAGE.expected
+//
+// The expected files were written by the DOM + XPath parser the streaming one
+// replaced, one "title:", "url:" and "snippet:" line per result (backslash,
+// newline, tab and carriage return escaped), each result followed by a blank
+// line. The page is parsed whole, a byte at a time and in random chunk sizes,
+// since downloads hand the parser whatever the network delivered.
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "scholar_result_parser.h"
+#include "scholar_search.h"
+
+namespace {
+
+const size_t RANDOM_SPLITS = 50;
+const size_t MAX_CHUNK = 512;
+
+bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+std::string escaped(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        switch (c) {
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        case '\r': out += "\\r"; break;
+        default: out += c;
+        }
+    }
+    return out;
+}
+
+std::string formatted(const std::vector<ScholarResult>& results) {
+    std::string out;
+    for (const ScholarResult& result : results) {
+        out += "title: " + escaped(result.title) + "\n";
+        out += "url: " + escaped(result.url) + "\n";
+        out += "snippet: " + escaped(result.snippet) + "\n\n";
+    }
+    return out;
+}
+
+// Feeds `html` in chunks of the sizes `nextChunk` returns.
+template <typename NextChunk>
+std::string parseInChunks(const std::string& html, NextChunk nextChunk) {
+    ScholarResultParser parser;
+    for (size_t offset = 0; offset < html.size();) {
+        const size_t size = std::min(nextChunk(), html.size() - offset);
+        parser.feed(html.data() + offset, size);
+        offset += size;
+    }
+    return formatted(parser.finish());
+}
+
+// The first line where `actual` and `expected` part, for the failure message.
+std::string firstDifference(const std::string& actual, const std::string& expected) {
+    std::istringstream a(actual), e(expected);
+    std::string actualLine, expectedLine;
+    for (size_t line = 1;; ++line) {
+        const bool moreActual = static_cast<bool>(std::getline(a, actualLine));
+        const bool moreExpected = static_cast<bool>(std::getline(e, expectedLine));
+        if (!moreActual && !moreExpected) return "none";
+        if (!moreActual) actualLine = "<end>";
+        if (!moreExpected) expectedLine = "<end>";
+        if (actualLine != expectedLine) {
+            return "line " + std::to_string(line) + "\n  expected: " + expectedLine + "\n  actual:   " + actualLine;
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " PAGE.html PAGE.expected" << std::endl;
+        return 2;
+    }
+    std::string html, expected;
+    if (!readFile(argv[1], html) || !readFile(argv[2], expected)) {
+        std::cerr << "[FAIL] cannot read " << argv[1] << " or " << argv[2] << std::endl;
+        return 1;
+    }
+
+    size_t failures = 0;
+    auto check = [&](const std::string& actual, const std::string& how) {
+        if (actual == expected) return;
+        if (failures++ == 0) {
+            std::cerr << "[FAIL] " << how << ", first difference at " << firstDifference(actual, expected)
+                      << std::endl;
+        }
+    };
+
+    check(formatted(ScholarResultParser::parse(html)), "parsed whole");
+    check(parseInChunks(html, [] { return size_t(1); }), "fed a byte at a time");
+    std::mt19937_64 rng(3);
+    for (size_t split = 0; split < RANDOM_SPLITS; ++split) {
+        check(parseInChunks(html, [&] { return 1 + static_cast<size_t>(rng() % MAX_CHUNK); }),
+              "fed in random chunks (split " + std::to_string(split) + ")");
+    }
+
+    const size_t results = static_cast<size_t>(std::count(expected.begin(), expected.end(), '\n')) / 4;
+    std::cout << argv[1] << ": " << results << " results, " << RANDOM_SPLITS + 2 << " parses, " << failures
+              << " mismatches." << std::endl;
+    return failures == 0 ? 0 : 1;
+}
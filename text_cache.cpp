@@ -0,0 +1,435 @@
+#include "text_cache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <zlib.h>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char ENTRY_MAGIC[4] = {'P', 'T', 'X', 'C'};
+const uint32_t ENTRY_VERSION = 2;
+const uint32_t FLAG_COMPRESSED = 1u << 0;
+const uint32_t FLAG_HASHED = 1u << 1;
+
+// Sanity limits for lengths read back from disk
+const uint32_t MAX_PATH_LENGTH = 1 << 16;
+const uint64_t MAX_RAW_LENGTH = 1ULL << 32;
+// deflate never compresses better than about 1032:1
+const uint64_t MAX_COMPRESSION_RATIO = 1032;
+
+// Temp files older than this were left by a writer that died; younger ones may still be written
+const auto ORPHAN_TEMP_AGE = std::chrono::hours(1);
+
+// Fixed-size entry header; the path and payload follow it.
+struct EntryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t pathLength;
+    uint64_t fileSize;
+    int64_t fileMtime;
+    uint64_t contentHash;
+    uint64_t rawLength;
+    uint64_t payloadLength;
+    uint64_t titleLength;     // CachedLayout of the raw text
+    uint64_t firstPageLength;
+};
+
+const uint64_t FNV_OFFSET = 1469598103934665603ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t fnv1a(const char* data, size_t length, uint64_t hash = FNV_OFFSET) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+bool hashFile(const std::string& path, uint64_t& hash) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::vector<char> buffer(1 << 20);
+    hash = FNV_OFFSET;
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        hash = fnv1a(buffer.data(), static_cast<size_t>(in.gcount()), hash);
+    }
+    // Keep 0 reserved for "not hashed"
+    if (hash == 0) hash = 1;
+    return true;
+}
+
+// Checks every length in the header against the entry's size on disk before
+// anything is allocated from them, so a truncated or corrupt entry reads as bad
+// instead of throwing.
+bool plausibleHeader(const EntryHeader& header, uint64_t entrySize) {
+    if (std::memcmp(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) != 0 || header.version != ENTRY_VERSION) {
+        return false;
+    }
+    if (header.pathLength > MAX_PATH_LENGTH || header.rawLength > MAX_RAW_LENGTH) return false;
+    if (header.payloadLength != entrySize - sizeof(header) - header.pathLength) return false;
+    if (header.flags & FLAG_COMPRESSED) return header.rawLength <= header.payloadLength * MAX_COMPRESSION_RATIO;
+    return header.rawLength == header.payloadLength;
+}
+
+enum class EntryStatus { MISSING, BAD, OK };
+
+EntryStatus readHeader(std::ifstream& in, const std::string& entryFile, EntryHeader& header, std::string& path) {
+    std::error_code ec;
+    uint64_t entrySize = fs::file_size(entryFile, ec);
+    in.open(entryFile, std::ios::binary);
+    if (ec || !in) return EntryStatus::MISSING;
+    if (entrySize < sizeof(header) || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        entrySize - sizeof(header) < header.pathLength || !plausibleHeader(header, entrySize)) {
+        return EntryStatus::BAD;
+    }
+    path.resize(header.pathLength);
+    return in.read(&path[0], header.pathLength) ? EntryStatus::OK : EntryStatus::BAD;
+}
+
+EntryStatus readEntry(const std::string& entryFile, EntryHeader& header, std::string& path, std::string& payload) {
+    std::ifstream in;
+    EntryStatus status = readHeader(in, entryFile, header, path);
+    if (status != EntryStatus::OK) return status;
+    payload.resize(header.payloadLength);
+    if (header.payloadLength > 0 && !in.read(&payload[0], header.payloadLength)) return EntryStatus::BAD;
+    return EntryStatus::OK;
+}
+
+// Unique per process and per call, so writers never share a temp file
+std::string tempPathFor(const std::string& entryFile) {
+    static std::atomic<uint64_t> counter{0};
+    return entryFile + ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter.fetch_add(1));
+}
+
+} // namespace
+
+TextCache::TextCache(const std::string& directory, bool hashContents)
+    : directory_(directory), hashContents_(hashContents) {}
+
+std::string TextCache::entryPath(const std::string& pdfPath) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << fnv1a(pdfPath.data(), pdfPath.size());
+    return (fs::path(directory_) / (name.str() + ".txtc")).string();
+}
+
+bool TextCache::ensureDirectory() const {
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (ec) {
+        std::cerr << "[Cache Error] Could not create " << directory_ << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool TextCache::identify(const std::string& pdfPath, FileIdentity& identity) const {
+    std::error_code ec;
+    identity.path = pdfPath;
+    identity.size = fs::file_size(pdfPath, ec);
+    if (ec) return false;
+    auto mtime = fs::last_write_time(pdfPath, ec);
+    if (ec) return false;
+    identity.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    identity.contentHash = 0;
+    if (hashContents_ && !hashFile(pdfPath, identity.contentHash)) return false;
+    return true;
+}
+
+bool TextCache::lookup(const FileIdentity& identity, std::string& text, CachedLayout* layout) const {
+    const std::string entryFile = entryPath(identity.path);
+    EntryHeader header;
+    std::string storedPath;
+    std::string payload;
+
+    EntryStatus status = readEntry(entryFile, header, storedPath, payload);
+    if (status != EntryStatus::OK) {
+        if (status == EntryStatus::BAD) {
+            std::cerr << "[Cache Error] Corrupt entry " << entryFile << ", discarding." << std::endl;
+            std::error_code ec;
+            fs::remove(entryFile, ec);
+            evictions_++;
+        }
+        misses_++;
+        return false;
+    }
+    // A different path with the same name hash: leave the other entry alone
+    if (storedPath != identity.path) {
+        misses_++;
+        return false;
+    }
+
+    bool fresh = header.fileSize == identity.size && header.fileMtime == identity.mtime;
+    if (fresh && hashContents_) {
+        fresh = (header.flags & FLAG_HASHED) && header.contentHash == identity.contentHash;
+    }
+    if (!fresh) {
+        std::error_code ec;
+        fs::remove(entryFile, ec);
+        evictions_++;
+        misses_++;
+        return false;
+    }
+
+    if (header.flags & FLAG_COMPRESSED) {
+        std::string raw(header.rawLength, '\0');
+        uLongf rawLength = static_cast<uLongf>(header.rawLength);
+        int rc = uncompress(reinterpret_cast<Bytef*>(&raw[0]), &rawLength,
+                            reinterpret_cast<const Bytef*>(payload.data()), static_cast<uLong>(payload.size()));
+        if (rc != Z_OK || rawLength != header.rawLength) {
+            std::cerr << "[Cache Error] Corrupt entry for " << identity.path << ", discarding." << std::endl;
+            std::error_code ec;
+            fs::remove(entryFile, ec);
+            evictions_++;
+            misses_++;
+            return false;
+        }
+        text = std::move(raw);
+    } else {
+        text = std::move(payload);
+    }
+    if (layout) {
+        *layout = CachedLayout();
+        if (header.titleLength <= text.size() && header.firstPageLength <= text.size() - header.titleLength) {
+            layout->titleBytes = header.titleLength;
+            layout->firstPageBytes = header.firstPageLength;
+        }
+    }
+
+    hits_++;
+    return true;
+}
+
+void TextCache::store(const FileIdentity& identity, const std::string& text) const {
+    if (!ensureDirectory()) return;
+
+    EntryHeader header;
+    std::memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+    header.version = ENTRY_VERSION;
+    header.flags = 0;
+    header.pathLength = static_cast<uint32_t>(identity.path.size());
+    header.fileSize = identity.size;
+    header.fileMtime = identity.mtime;
+    header.contentHash = identity.contentHash;
+    header.rawLength = text.size();
+    header.titleLength = 0;
+    header.firstPageLength = 0;
+    if (hashContents_) header.flags |= FLAG_HASHED;
+
+    // Compress with the fastest level; keep the raw text if that does not help
+    std::string compressed(compressBound(static_cast<uLong>(text.size())), '\0');
+    uLongf compressedLength = static_cast<uLongf>(compressed.size());
+    int rc = compress2(reinterpret_cast<Bytef*>(&compressed[0]), &compressedLength,
+                       reinterpret_cast<const Bytef*>(text.data()), static_cast<uLong>(text.size()), Z_BEST_SPEED);
+    const std::string* payload = &text;
+    if (rc == Z_OK && compressedLength < text.size()) {
+        compressed.resize(compressedLength);
+        payload = &compressed;
+        header.flags |= FLAG_COMPRESSED;
+    }
+    header.payloadLength = payload->size();
+
+    // Write to a private temp file and rename, so concurrent readers never see a partial entry
+    const std::string entryFile = entryPath(identity.path);
+    const std::string tmpFile = tempPathFor(entryFile);
+    {
+        std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(identity.path.data(), identity.path.size());
+        out.write(payload->data(), payload->size());
+        if (!out) {
+            std::cerr << "[Cache Error] Could not write entry for " << identity.path << std::endl;
+            out.close();
+            std::error_code ec;
+            fs::remove(tmpFile, ec);
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmpFile, entryFile, ec);
+    if (ec) {
+        std::cerr << "[Cache Error] Could not commit entry for " << identity.path << ": " << ec.message() << std::endl;
+        fs::remove(tmpFile, ec);
+    }
+}
+
+// --- Streamed entries ---
+
+struct TextCache::EntryWriter::State {
+    std::string entryFile;
+    std::string tmpFile;
+    std::string path;
+    EntryHeader header;
+    std::ofstream out;
+    z_stream stream;
+    std::vector<char> buffer;
+    bool failed = false;
+
+    // Runs deflate over the pending input, writing every full output buffer
+    void deflateInput(int flush) {
+        int rc = Z_OK;
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+            stream.avail_out = static_cast<uInt>(buffer.size());
+            rc = deflate(&stream, flush);
+            if (rc == Z_STREAM_ERROR) {
+                failed = true;
+                return;
+            }
+            size_t produced = buffer.size() - stream.avail_out;
+            out.write(buffer.data(), produced);
+            header.payloadLength += produced;
+        } while (stream.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+        if (!out) failed = true;
+    }
+};
+
+TextCache::EntryWriter::EntryWriter(std::unique_ptr<State> state) : state_(std::move(state)) {}
+
+TextCache::EntryWriter::~EntryWriter() {
+    if (!state_) return;
+    deflateEnd(&state_->stream);
+    if (state_->out.is_open()) {
+        state_->out.close();
+        std::error_code ec;
+        fs::remove(state_->tmpFile, ec);
+    }
+}
+
+void TextCache::EntryWriter::append(const char* data, size_t size, TextField field) {
+    State& state = *state_;
+    if (state.failed) return;
+    state.header.rawLength += size;
+    if (field == FIELD_TITLE) {
+        state.header.titleLength += size;
+    } else if (field == FIELD_FIRST_PAGE) {
+        state.header.firstPageLength += size;
+    }
+    // avail_in is 32 bits wide
+    while (size > 0 && !state.failed) {
+        uInt part = static_cast<uInt>(std::min<size_t>(size, 1u << 30));
+        state.stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        state.stream.avail_in = part;
+        state.deflateInput(Z_NO_FLUSH);
+        data += part;
+        size -= part;
+    }
+}
+
+void TextCache::EntryWriter::commit() {
+    State& state = *state_;
+    if (!state.failed) state.deflateInput(Z_FINISH);
+    if (!state.failed) {
+        // The lengths are only known now: rewrite the header in place
+        state.out.seekp(0);
+        state.out.write(reinterpret_cast<const char*>(&state.header), sizeof(state.header));
+    }
+    state.out.close();
+    std::error_code ec;
+    if (state.failed || state.out.fail()) {
+        std::cerr << "[Cache Error] Could not write entry for " << state.path << std::endl;
+        fs::remove(state.tmpFile, ec);
+        return;
+    }
+    fs::rename(state.tmpFile, state.entryFile, ec);
+    if (ec) {
+        std::cerr << "[Cache Error] Could not commit entry for " << state.path << ": " << ec.message() << std::endl;
+        fs::remove(state.tmpFile, ec);
+    }
+}
+
+std::unique_ptr<TextCache::EntryWriter> TextCache::beginStore(const FileIdentity& identity) const {
+    if (!ensureDirectory()) return nullptr;
+
+    std::unique_ptr<EntryWriter::State> state(new EntryWriter::State());
+    state->path = identity.path;
+    state->entryFile = entryPath(identity.path);
+    state->tmpFile = tempPathFor(state->entryFile);
+
+    EntryHeader& header = state->header;
+    std::memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+    header.version = ENTRY_VERSION;
+    header.flags = FLAG_COMPRESSED | (hashContents_ ? FLAG_HASHED : 0);
+    header.pathLength = static_cast<uint32_t>(identity.path.size());
+    header.fileSize = identity.size;
+    header.fileMtime = identity.mtime;
+    header.contentHash = identity.contentHash;
+    header.rawLength = 0;
+    header.payloadLength = 0;
+    header.titleLength = 0;
+    header.firstPageLength = 0;
+
+    std::memset(&state->stream, 0, sizeof(state->stream));
+    if (deflateInit(&state->stream, Z_BEST_SPEED) != Z_OK) return nullptr;
+    state->buffer.resize(64 * 1024);
+
+    state->out.open(state->tmpFile, std::ios::binary | std::ios::trunc);
+    // Placeholder header, rewritten by commit()
+    state->out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    state->out.write(identity.path.data(), identity.path.size());
+    if (!state->out) {
+        std::cerr << "[Cache Error] Could not write entry for " << identity.path << std::endl;
+        deflateEnd(&state->stream);
+        state->out.close();
+        std::error_code ec;
+        fs::remove(state->tmpFile, ec);
+        return nullptr;
+    }
+    return std::unique_ptr<EntryWriter>(new EntryWriter(std::move(state)));
+}
+
+size_t TextCache::prune() const {
+    size_t removed = 0;
+    std::error_code ec;
+    if (!fs::is_directory(directory_, ec)) return 0;
+
+    const auto now = fs::file_time_type::clock::now();
+    for (const auto& entry : fs::directory_iterator(directory_, ec)) {
+        if (entry.path().filename().string().find(".txtc.tmp.") != std::string::npos) {
+            std::error_code tmpEc;
+            auto written = fs::last_write_time(entry.path(), tmpEc);
+            if (!tmpEc && now - written > ORPHAN_TEMP_AGE && fs::remove(entry.path(), tmpEc)) removed++;
+            continue;
+        }
+        if (entry.path().extension() != ".txtc") continue;
+
+        EntryHeader header;
+        std::string sourcePath;
+        std::ifstream in;
+        bool stale = readHeader(in, entry.path().string(), header, sourcePath) != EntryStatus::OK;
+        in.close();
+        if (!stale) {
+            // Size and mtime are enough here; content hashes are checked on lookup
+            std::error_code statEc;
+            uint64_t size = fs::file_size(sourcePath, statEc);
+            if (statEc) {
+                stale = true;
+            } else {
+                auto mtime = fs::last_write_time(sourcePath, statEc);
+                stale = statEc || header.fileSize != size ||
+                        header.fileMtime != static_cast<int64_t>(mtime.time_since_epoch().count());
+            }
+        }
+        if (stale) {
+            std::error_code rmEc;
+            if (fs::remove(entry.path(), rmEc)) {
+                removed++;
+                evictions_++;
+            }
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+
+#include "index_reader.h"
+
+// Identity of a source file at the time it was extracted.
+struct FileIdentity {
+    std::string path;
+    uint64_t size = 0;
+    int64_t mtime = 0;        // Raw file_time_type tick count
+    uint64_t contentHash = 0; // FNV-1a of the file bytes, 0 when hashing is off
+};
+
+// Where the fields of a cached text end (see PdfTextExtractor::ChunkConsumer).
+struct CachedLayout {
+    uint64_t titleBytes = 0;      // Metadata at the start of the text
+    uint64_t firstPageBytes = 0;  // The first page right after it; the rest is body
+};
+
+/**
+ * @brief Persistent on-disk cache of extracted PDF text.
+ *
+ * Each source file maps to one entry file named after a hash of its path.
+ * An entry records the file identity (path, size, mtime and optionally a
+ * content hash) next to the zlib-compressed UTF-8 text. A lookup whose
+ * identity no longer matches is treated as stale: the entry is deleted and
+ * the caller falls back to a real extraction. All methods are safe to call
+ * from several extraction threads at once.
+ */
+class TextCache {
+public:
+    /**
+     * @param directory Cache directory, created on first use.
+     * @param hashContents Also key entries by a hash of the file contents. Catches
+     *        edits that preserve size and mtime, at the cost of reading each file.
+     */
+    explicit TextCache(const std::string& directory, bool hashContents = false);
+
+    // Stats the file (and hashes it if enabled). Returns false if it cannot be read.
+    bool identify(const std::string& pdfPath, FileIdentity& identity) const;
+
+    // Returns true and fills `text` (and `layout`, if given) on a fresh hit. Stale entries are evicted.
+    bool lookup(const FileIdentity& identity, std::string& text, CachedLayout* layout = nullptr) const;
+
+    // Writes (or replaces) the entry for `identity`, all of it body text. Failures are logged, never fatal.
+    void store(const FileIdentity& identity, const std::string& text) const;
+
+    /**
+     * @brief Writes one entry as its text arrives, compressing on the fly.
+     * Readers see nothing until commit(); a writer destroyed without a
+     * commit removes its temp file.
+     */
+    class EntryWriter {
+    public:
+        ~EntryWriter();
+        // Fields must arrive in order: metadata, first page, body.
+        void append(const char* data, size_t size, TextField field = FIELD_BODY);
+        // Replaces the entry with what was appended. Failures are logged, never fatal.
+        void commit();
+
+    private:
+        friend class TextCache;
+        struct State;
+        explicit EntryWriter(std::unique_ptr<State> state);
+        std::unique_ptr<State> state_;
+    };
+
+    // Starts a streamed entry for `identity`; null if it cannot be written.
+    std::unique_ptr<EntryWriter> beginStore(const FileIdentity& identity) const;
+
+    // Removes entries whose source file is gone or changed, and temp files abandoned by
+    // writers that died mid-store. Returns the number of files removed.
+    size_t prune() const;
+
+    size_t hits() const { return hits_.load(); }
+    size_t misses() const { return misses_.load(); }
+    size_t evictions() const { return evictions_.load(); }
+
+private:
+    std::string entryPath(const std::string& pdfPath) const;
+    bool ensureDirectory() const;
+
+    std::string directory_;
+    bool hashContents_;
+
+    mutable std::atomic<size_t> hits_{0};
+    mutable std::atomic<size_t> misses_{0};
+    mutable std::atomic<size_t> evictions_{0};
+};
@@ -0,0 +1,327 @@
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define TOKENIZER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// --- Character classes (ASCII, "C" locale) ---
+
+enum CharClass : uint8_t { OTHER = 0, SPACE = 1, ALNUM = 2 };
+
+struct ClassTable {
+    uint8_t cls[256];
+    constexpr ClassTable() : cls() {
+        for (int c = 0; c < 256; ++c) {
+            bool space = c == ' ' || (c >= '\t' && c <= '\r');
+            bool alnum = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+            cls[c] = space ? SPACE : (alnum ? ALNUM : OTHER);
+        }
+    }
+};
+
+constexpr ClassTable CLASS_TABLE;
+
+// For letters and digits, OR-ing in 0x20 is exactly ::tolower
+constexpr char CASE_BIT = 0x20;
+
+// --- Token assembly shared by all kernels ---
+
+// The token being assembled lives in a per-thread scratch buffer, so
+// steady-state tokenization allocates nothing. Kernels reserve room a bounded
+// block at a time, which keeps the buffer proportional to the longest token
+// rather than to the text; one that still grew past SCRATCH_KEEP (a huge run
+// without whitespace) is dropped after the call. The buffer keeps SCRATCH_PAD
+// spare bytes in front of the token so the SIMD kernels can copy a whole block
+// to a negative offset and land the wanted bytes at position 0.
+constexpr size_t SCRATCH_PAD = 64;
+constexpr size_t SCRATCH_INITIAL = 1024;
+constexpr size_t SCRATCH_KEEP = 64 * 1024;
+// Bytes the scalar kernel reserves for at a time
+constexpr size_t SCALAR_BLOCK = 256;
+
+struct TokenState {
+    std::string& scratch;
+    size_t length = 0;
+    void (*sink)(void*, std::string_view);
+    void* context;
+
+    // Makes room for `extra` more bytes of the current token; returns the token start.
+    char* reserve(size_t extra) {
+        if (SCRATCH_PAD + length + extra > scratch.size()) {
+            scratch.resize((SCRATCH_PAD + length + extra) * 2);
+        }
+        return &scratch[SCRATCH_PAD];
+    }
+
+    void flush() {
+        if (length == 0) return;
+        std::string_view token(scratch.data() + SCRATCH_PAD, length);
+        length = 0;
+        sink(context, token);
+    }
+};
+
+// Appends the scalar tail (or the whole text when no SIMD kernel is used).
+void scanScalar(const char* data, size_t size, TokenState& state) {
+    for (size_t start = 0; start < size; start += SCALAR_BLOCK) {
+        const size_t end = std::min(size, start + SCALAR_BLOCK);
+        char* out = state.reserve(end - start);
+        for (size_t i = start; i < end; ++i) {
+            unsigned char c = static_cast<unsigned char>(data[i]);
+            uint8_t cls = CLASS_TABLE.cls[c];
+            if (cls == ALNUM) {
+                out[state.length++] = static_cast<char>(c | CASE_BIT);
+            } else if (cls == SPACE) {
+                state.flush();
+            }
+        }
+    }
+}
+
+#ifdef TOKENIZER_X86
+
+inline unsigned countTrailingZeros(uint64_t mask) {
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+}
+
+// Appends the bytes of `lowered` selected by `keep` to the current token.
+inline void appendSelected(const char* lowered, uint64_t keep, TokenState& state, char* out) {
+    if (keep == 0) return;
+    unsigned first = countTrailingZeros(keep);
+    uint64_t run = keep >> first;
+    if ((run & (run + 1)) == 0) {
+        // One contiguous run of letters/digits: the usual case inside a word
+        unsigned count = static_cast<unsigned>(__builtin_popcountll(run));
+        std::memcpy(out + state.length, lowered + first, count);
+        state.length += count;
+        return;
+    }
+    while (keep) {
+        out[state.length++] = lowered[countTrailingZeros(keep)];
+        keep &= keep - 1;
+    }
+}
+
+// Walks one block of Width bytes given its whitespace and letter/digit bitmasks.
+template <unsigned Width>
+inline void processBlock(const char* lowered, uint64_t spaceMask, uint64_t alnumMask, TokenState& state) {
+    const uint64_t all = Width == 64 ? ~uint64_t(0) : (uint64_t(1) << Width) - 1;
+    char* out = state.reserve(Width);
+
+    if ((spaceMask | alnumMask) == all) {
+        // Only letters, digits and whitespace (the common case): each word is one
+        // fixed-size block copy placed so that its first byte lands at the token end.
+        // Either pos == 0 or the token was just flushed, so the copy never clobbers
+        // bytes of the token that are still needed.
+        unsigned pos = 0;
+        while (spaceMask) {
+            unsigned at = countTrailingZeros(spaceMask);
+            if (at > pos) {
+                std::memcpy(out + state.length - pos, lowered, Width);
+                state.length += at - pos;
+            }
+            state.flush();
+            pos = at + 1;
+            spaceMask &= spaceMask - 1;
+        }
+        if (pos < Width) {
+            std::memcpy(out + state.length - pos, lowered, Width);
+            state.length += Width - pos;
+        }
+        return;
+    }
+
+    // Punctuation or non-ASCII bytes present: copy only the selected bytes
+    uint64_t pending = alnumMask;
+    while (spaceMask) {
+        unsigned at = countTrailingZeros(spaceMask);
+        uint64_t before = (uint64_t(1) << at) - 1;
+        appendSelected(lowered, pending & before, state, out);
+        pending &= ~before;
+        state.flush();
+        spaceMask &= spaceMask - 1;
+    }
+    appendSelected(lowered, pending, state, out);
+}
+
+// --- SSE2 kernel (baseline on x86-64) ---
+
+void scanSse2(const char* data, size_t size, TokenState& state) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i caseBit = _mm_set1_epi8(CASE_BIT);
+    const __m128i lowerA = _mm_set1_epi8('a');
+    const __m128i twentyFive = _mm_set1_epi8(25);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    alignas(16) char lowered[16];
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        // Unsigned range checks: x in [lo, lo+n]  <=>  min_epu8(x - lo, n) == x - lo
+        __m128i fromTab = _mm_sub_epi8(v, tab);
+        __m128i isSpace = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                       _mm_cmpeq_epi8(_mm_min_epu8(fromTab, four), fromTab));
+        __m128i low = _mm_or_si128(v, caseBit);
+        __m128i fromA = _mm_sub_epi8(low, lowerA);
+        __m128i fromZero = _mm_sub_epi8(v, zero);
+        __m128i isAlnum = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(fromA, twentyFive), fromA),
+                                       _mm_cmpeq_epi8(_mm_min_epu8(fromZero, nine), fromZero));
+
+        uint64_t spaceMask = static_cast<uint32_t>(_mm_movemask_epi8(isSpace));
+        uint64_t alnumMask = static_cast<uint32_t>(_mm_movemask_epi8(isAlnum));
+        if (spaceMask == 0 && alnumMask == 0xFFFF) {
+            char* out = state.reserve(16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + state.length), low);
+            state.length += 16;
+            continue;
+        }
+        _mm_store_si128(reinterpret_cast<__m128i*>(lowered), low);
+        processBlock<16>(lowered, spaceMask, alnumMask, state);
+    }
+    scanScalar(data + i, size - i, state);
+}
+
+// --- AVX2 kernel (picked at runtime) ---
+
+#if defined(__GNUC__)
+#define TOKENIZER_HAS_AVX2 1
+
+__attribute__((target("avx2")))
+void scanAvx2(const char* data, size_t size, TokenState& state) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i caseBit = _mm256_set1_epi8(CASE_BIT);
+    const __m256i lowerA = _mm256_set1_epi8('a');
+    const __m256i twentyFive = _mm256_set1_epi8(25);
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i nine = _mm256_set1_epi8(9);
+    alignas(32) char lowered[32];
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i fromTab = _mm256_sub_epi8(v, tab);
+        __m256i isSpace = _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                          _mm256_cmpeq_epi8(_mm256_min_epu8(fromTab, four), fromTab));
+        __m256i low = _mm256_or_si256(v, caseBit);
+        __m256i fromA = _mm256_sub_epi8(low, lowerA);
+        __m256i fromZero = _mm256_sub_epi8(v, zero);
+        __m256i isAlnum = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(fromA, twentyFive), fromA),
+                                          _mm256_cmpeq_epi8(_mm256_min_epu8(fromZero, nine), fromZero));
+
+        uint64_t spaceMask = static_cast<uint32_t>(_mm256_movemask_epi8(isSpace));
+        uint64_t alnumMask = static_cast<uint32_t>(_mm256_movemask_epi8(isAlnum));
+        if (spaceMask == 0 && alnumMask == 0xFFFFFFFFu) {
+            char* out = state.reserve(32);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + state.length), low);
+            state.length += 32;
+            continue;
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lowered), low);
+        processBlock<32>(lowered, spaceMask, alnumMask, state);
+    }
+    scanScalar(data + i, size - i, state);
+}
+#endif
+
+#endif // TOKENIZER_X86
+
+using ScanKernel = void (*)(const char*, size_t, TokenState&);
+
+struct Kernel {
+    ScanKernel scan;
+    const char* name;
+};
+
+Kernel bestKernel() {
+#ifdef TOKENIZER_X86
+#ifdef TOKENIZER_HAS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Kernel{scanAvx2, "avx2"};
+#endif
+    return Kernel{scanSse2, "sse2"};
+#else
+    return Kernel{scanScalar, "scalar"};
+#endif
+}
+
+// PDF_ORGANIZER_TOKENIZER=avx2|sse2|scalar forces a kernel this CPU supports,
+// so the tests can check every one of them on one machine.
+Kernel pickKernel() {
+    const Kernel best = bestKernel();
+    const char* forced = std::getenv("PDF_ORGANIZER_TOKENIZER");
+    if (!forced || !*forced || std::strcmp(forced, best.name) == 0) return best;
+    if (std::strcmp(forced, "scalar") == 0) return Kernel{scanScalar, "scalar"};
+#ifdef TOKENIZER_X86
+    if (std::strcmp(forced, "sse2") == 0) return Kernel{scanSse2, "sse2"};
+#endif
+    std::cerr << "[Tokenizer] The " << forced << " kernel is not available; using " << best.name << "." << std::endl;
+    return best;
+}
+
+const Kernel& activeKernel() {
+    static const Kernel kernel = pickKernel();
+    return kernel;
+}
+
+} // namespace
+
+bool Tokenizer::isStopWord(std::string_view token) {
+    // Minimal stop words list, dispatched on length and first letter:
+    // the, and, a, an, in, on, of, for, with, to, is, are, was, were
+    switch (token.size()) {
+    case 1:
+        return token[0] == 'a';
+    case 2:
+        switch (token[0]) {
+        case 'a': return token[1] == 'n';
+        case 'i': return token[1] == 'n' || token[1] == 's';
+        case 'o': return token[1] == 'n' || token[1] == 'f';
+        case 't': return token[1] == 'o';
+        default: return false;
+        }
+    case 3:
+        switch (token[0]) {
+        case 't': return token == "the";
+        case 'a': return token == "and" || token == "are";
+        case 'f': return token == "for";
+        case 'w': return token == "was";
+        default: return false;
+        }
+    case 4:
+        return token[0] == 'w' && (token == "with" || token == "were");
+    default:
+        return false;
+    }
+}
+
+const char* Tokenizer::kernelName() {
+    return activeKernel().name;
+}
+
+void Tokenizer::tokenize(std::string_view text, Sink sink, void* context) {
+    thread_local std::string scratch(SCRATCH_INITIAL, '\0');
+    TokenState state{scratch, 0, sink, context};
+    activeKernel().scan(text.data(), text.size(), state);
+    state.flush();
+    if (scratch.size() > SCRATCH_KEEP) std::string(SCRATCH_INITIAL, '\0').swap(scratch);
+}
+
+std::vector<std::string> Tokenizer::tokenize(std::string_view text) {
+    std::vector<std::string> tokens;
+    forEachToken(text, [&](std::string_view token) { tokens.emplace_back(token); });
+    return tokens;
+}
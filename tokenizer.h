@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <type_traits>
+#include <cstdint>
+
+/**
+ * @brief Splits text into normalized terms without per-token allocations.
+ *
+ * Produces exactly what the original stringstream tokenizer did: text is split
+ * on ASCII whitespace, each chunk keeps only its ASCII letters and digits
+ * (letters folded to lower case), and empty chunks and stop words are dropped.
+ * Bytes >= 0x80 are never letters or digits, matching ::isalnum in the "C" locale.
+ *
+ * Character classes are computed 32 (AVX2) or 16 (SSE2) bytes at a time when
+ * the CPU supports it, with a table-driven scalar fallback elsewhere. Tokens are
+ * folded into a per-thread scratch buffer and handed out as string_views, which
+ * are only valid for the duration of the callback.
+ */
+class Tokenizer {
+public:
+    // Calls emit(std::string_view token) for every token, in text order.
+    template <typename Emit>
+    static void forEachToken(std::string_view text, Emit&& emit) {
+        using EmitType = typename std::remove_reference<Emit>::type;
+        tokenize(text, [](void* context, std::string_view token) {
+            if (!isStopWord(token)) (*static_cast<EmitType*>(context))(token);
+        }, &emit);
+    }
+
+    /**
+     * @brief Like forEachToken, but also passes each token's position:
+     * emit(std::string_view token, uint32_t position). Positions count every
+     * non-empty chunk, stop words included, so "theory of relativity" keeps
+     * its gap of two between the remaining terms.
+     *
+     * Positions start at `firstPosition`; the return value is the position
+     * after the last chunk, so text split on whitespace can be fed piece by piece.
+     */
+    template <typename Emit>
+    static uint32_t forEachPositionedToken(std::string_view text, Emit&& emit, uint32_t firstPosition = 0) {
+        using EmitType = typename std::remove_reference<Emit>::type;
+        struct Context {
+            EmitType& emit;
+            uint32_t position;
+        } context{emit, firstPosition};
+        tokenize(text, [](void* opaque, std::string_view token) {
+            Context& ctx = *static_cast<Context*>(opaque);
+            if (!isStopWord(token)) ctx.emit(token, ctx.position);
+            ctx.position++;
+        }, &context);
+        return context.position;
+    }
+
+    // Convenience wrapper returning owned strings.
+    static std::vector<std::string> tokenize(std::string_view text);
+
+    static bool isStopWord(std::string_view token);
+
+    // Name of the character-class kernel picked for this CPU ("avx2", "sse2" or "scalar"),
+    // or the one PDF_ORGANIZER_TOKENIZER names if the CPU supports it.
+    static const char* kernelName();
+
+private:
+    // Receives every non-empty token, stop words included.
+    using Sink = void (*)(void* context, std::string_view token);
+    static void tokenize(std::string_view text, Sink sink, void* context);
+};